@@ -0,0 +1,335 @@
+#include "approximation.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+  using mathlab::execution_plan;
+  using mathlab::plan_operation;
+  using mathlab::plan_step;
+  using mathlab::value_range;
+
+  const auto infinity = std::numeric_limits<double>::infinity();
+  const double pi = 3.14159265358979323846;
+  // Degrees tried for every piece, the lowest one within tolerance is kept
+  constexpr unsigned degrees[] = { 1, 3, 7, 11, mathlab::piecewise_approximation::max_degree };
+  // Pieces are not split below this fraction of the domain, they are evaluated exactly instead
+  const double min_piece_fraction = std::ldexp(1., -32);
+  // Halvings of the domain while searching for breakpoints, after which the rest is evaluated exactly
+  constexpr size_t max_kink_splits = mathlab::piecewise_approximation::max_pieces;
+  // Rounds of refitting pieces that fail verification on the domain sample before they are evaluated exactly
+  constexpr int refit_rounds = 4;
+
+  // Piece of domain [start, end) with Chebyshev coefficients, evaluated exactly if there are none
+  struct fitted_piece {
+    double start;
+    double end;
+    std::vector<double> coefficients;
+  };
+
+  // Center and scale that map [start, end] to [-1, 1]
+  std::pair<double, double> transform_of(double start, double end) {
+    return { start + (end - start) / 2, 2 / (end - start) };
+  }
+
+  // Clenshaw recurrence
+  double eval_chebyshev(const double* coefficients, unsigned degree, double center, double scale, double input) {
+    const auto t = (input - center) * scale;
+    double next = 0.;
+    double after_next = 0.;
+    for (auto k = degree; k > 0; --k) {
+      const auto current = 2 * t * next - after_next + coefficients[k];
+      after_next = next;
+      next = current;
+    }
+    return t * next - after_next + coefficients[0];
+  }
+
+  // Error of approximate result, infinite where exact result is not finite unless both are the same
+  double error_between(double approximate, double exact, bool relative) {
+    if (!std::isfinite(exact))
+      return approximate == exact || (std::isnan(approximate) && std::isnan(exact)) ? 0. : infinity;
+    const auto error = std::fabs(approximate - exact);
+    if (!relative || error == 0.)
+      return error;
+    return exact == 0. ? infinity : error / std::fabs(exact);
+  }
+
+  // Where the output of a step is not smooth, in terms of its input; clamps at infinity change nothing
+  std::vector<double> breakpoints_of(const plan_step& step) {
+    switch (step.operation) {
+    case plan_operation::limit: return { step.constants[0], step.constants[1] };
+    case plan_operation::condition: return { step.constants[0] };
+    case plan_operation::power: {
+      // Natural powers are polynomials, other powers have a kink, a pole or NaN below zero
+      const auto exponent = step.constants[0];
+      if (exponent >= 0. && exponent == std::floor(exponent))
+        return {};
+      return { 0. };
+    }
+    default: return {};
+    }
+  }
+
+  // Whether the input of a step may reach one of its breakpoints for an input of steps in [start, end]
+  bool may_reach_breakpoint(const std::vector<plan_step>& steps, double start, double end) {
+    value_range range = { start, end, false };
+    for (const auto& step : steps) {
+      for (auto breakpoint : breakpoints_of(step)) {
+        if (std::isfinite(breakpoint) && range.lower <= breakpoint && breakpoint <= range.upper)
+          return true;
+      }
+      range = mathlab::output_range(step, range);
+    }
+    return false;
+  }
+
+  // Halves [start, end] until the range of the input of every step in a half stays off its breakpoints, halves
+  // narrower than min_width where one may still be reached are appended to kinks, joined with an adjacent one
+  void find_kinks(const std::vector<plan_step>& steps, double start, double end, double min_width, size_t& splits,
+    std::vector<std::pair<double, double>>& kinks) {
+    if (!may_reach_breakpoint(steps, start, end))
+      return;
+    const auto middle = start + (end - start) / 2;
+    if (splits == 0 || end - start < min_width || middle <= start || middle >= end) {
+      if (!kinks.empty() && kinks.back().second >= start)
+        kinks.back().second = end;
+      else
+        kinks.emplace_back(start, end);
+      return;
+    }
+    --splits;
+    find_kinks(steps, start, middle, min_width, splits, kinks);
+    find_kinks(steps, middle, end, min_width, splits, kinks);
+  }
+
+  std::vector<double> uniform_samples(double start, double end, size_t count) {
+    std::vector<double> samples(count);
+    for (size_t i = 0; i < count; ++i)
+      samples[i] = start + (end - start) * (static_cast<double>(i) / static_cast<double>(count));
+    return samples;
+  }
+
+  class piece_fitter {
+    const execution_plan& exact_;
+    mathlab::error_tolerance tolerance_;
+    double min_width_;
+    // Pieces that may still be split off, the rest of the domain is evaluated exactly once they are used up
+    size_t budget_ = mathlab::piecewise_approximation::max_pieces;
+  public:
+    double max_error = 0.;
+
+    piece_fitter(const execution_plan& exact, mathlab::error_tolerance tolerance, double min_width)
+      : exact_(exact), tolerance_(tolerance), min_width_(min_width) {}
+
+    // Fits [start, end) with pieces appended to pieces, splits in halves until every piece is within tolerance
+    // Pieces without a finite exact result, e.g. below zero of a square root, are evaluated exactly without splitting
+    void fit(double start, double end, std::vector<fitted_piece>& pieces) {
+      bool finite = false;
+      auto coefficients = fit_one(start, end, finite);
+      const auto middle = start + (end - start) / 2;
+      if (!coefficients.empty() || !finite || budget_ == 0 || end - start < min_width_ || middle <= start || middle >= end) {
+        pieces.push_back({ start, end, std::move(coefficients) });
+        return;
+      }
+      --budget_;
+      fit(start, middle, pieces);
+      fit(middle, end, pieces);
+    }
+
+    bool within_tolerance(double error) const { return error <= tolerance_.value; }
+    double error_of(double approximate, double exact) const { return error_between(approximate, exact, tolerance_.relative); }
+  private:
+    // Coefficients of the lowest degree within tolerance on samples of [start, end), empty if there are none
+    // finite tells whether any sample has a finite exact result
+    std::vector<double> fit_one(double start, double end, bool& finite) {
+      auto samples = uniform_samples(start, end, mathlab::piecewise_approximation::piece_samples);
+      samples.push_back(std::nextafter(end, start));
+      std::vector<double> expected(samples.size());
+      exact_.eval_batch(samples.data(), expected.data(), samples.size());
+      finite = std::any_of(expected.begin(), expected.end(), [](double value) { return std::isfinite(value); });
+      if (!finite)
+        return {};
+      const auto transform = transform_of(start, end);
+      for (auto degree : degrees) {
+        const auto coefficients = interpolate(start, end, degree);
+        if (coefficients.empty())
+          return {};
+        double error = 0.;
+        for (size_t i = 0; i < samples.size() && within_tolerance(error); ++i)
+          error = std::max(error, error_of(eval_chebyshev(coefficients.data(), degree, transform.first, transform.second, samples[i]), expected[i]));
+        if (within_tolerance(error)) {
+          max_error = std::max(max_error, error);
+          return coefficients;
+        }
+      }
+      return {};
+    }
+
+    // Chebyshev interpolation at the nodes of the first kind, empty if exact result is not finite at a node
+    std::vector<double> interpolate(double start, double end, unsigned degree) {
+      const auto count = degree + 1;
+      const auto transform = transform_of(start, end);
+      std::vector<double> nodes(count);
+      for (unsigned j = 0; j < count; ++j)
+        nodes[j] = transform.first + std::cos(pi * (j + .5) / count) / transform.second;
+      std::vector<double> values(count);
+      exact_.eval_batch(nodes.data(), values.data(), count);
+      if (!std::all_of(values.begin(), values.end(), [](double value) { return std::isfinite(value); }))
+        return {};
+      std::vector<double> coefficients(count);
+      for (unsigned k = 0; k < count; ++k) {
+        double sum = 0.;
+        for (unsigned j = 0; j < count; ++j)
+          sum += values[j] * std::cos(pi * k * (j + .5) / count);
+        coefficients[k] = sum * 2 / count;
+      }
+      coefficients[0] /= 2;
+      return coefficients;
+    }
+  };
+}
+
+namespace mathlab {
+
+  piecewise_approximation::piecewise_approximation(const std::vector<block_description>& blocks, optimization_level level,
+    const approximation_settings& settings) : exact_(blocks, level), lower_(settings.lower), end_(std::nextafter(settings.upper, infinity)) {
+    if (!std::isfinite(settings.lower) || !std::isfinite(settings.upper) || settings.lower > settings.upper)
+      throw std::invalid_argument("Invalid approximation domain");
+    if (!(settings.tolerance.value > 0.) || !std::isfinite(settings.tolerance.value))
+      throw std::invalid_argument("Invalid approximation tolerance");
+
+    // Inputs around every breakpoint that a step may reach are evaluated exactly, pieces between them are smooth
+    // Ranges of step inputs bound them on the whole piece, so narrow crossings between samples are not missed
+    const auto min_width = (end_ - lower_) * min_piece_fraction;
+    std::vector<std::pair<double, double>> crossings;
+    auto splits = max_kink_splits;
+    find_kinks(execution_plan(blocks, optimization_level::none).steps(), lower_, settings.upper, min_width, splits, crossings);
+
+    piece_fitter fitter(exact_, settings.tolerance, min_width);
+    std::vector<fitted_piece> fitted;
+    auto position = lower_;
+    for (const auto& crossing : crossings) {
+      const auto start = std::max(crossing.first, position);
+      const auto end = std::nextafter(crossing.second, infinity);
+      if (end <= position)
+        continue;
+      if (start > position)
+        fitter.fit(position, start, fitted);
+      fitted.push_back({ start, end, {} });
+      position = end;
+    }
+    if (position < end_)
+      fitter.fit(position, end_, fitted);
+    max_error_ = fitter.max_error;
+
+    // Dense sample of the whole domain, pieces that fail are fitted again in halves and finally evaluated exactly
+    auto samples = uniform_samples(lower_, settings.upper, domain_samples);
+    samples.push_back(settings.upper);
+    std::vector<double> expected(samples.size());
+    exact_.eval_batch(samples.data(), expected.data(), samples.size());
+    for (int round = 0; round <= refit_rounds; ++round) {
+      std::vector<bool> failed(fitted.size());
+      auto found = fitted.begin();
+      for (size_t i = 0; i < samples.size(); ++i) {
+        while (samples[i] >= found->end)
+          ++found;
+        if (found->coefficients.empty())
+          continue;
+        const auto transform = transform_of(found->start, found->end);
+        const auto degree = static_cast<unsigned>(found->coefficients.size() - 1);
+        const auto error = fitter.error_of(eval_chebyshev(found->coefficients.data(), degree, transform.first, transform.second, samples[i]), expected[i]);
+        if (fitter.within_tolerance(error))
+          max_error_ = std::max(max_error_, error);
+        else
+          failed[static_cast<size_t>(found - fitted.begin())] = true;
+      }
+      if (std::find(failed.begin(), failed.end(), true) == failed.end())
+        break;
+      std::vector<fitted_piece> refitted;
+      for (size_t i = 0; i < fitted.size(); ++i) {
+        if (!failed[i])
+          refitted.push_back(std::move(fitted[i]));
+        else if (round == refit_rounds)
+          refitted.push_back({ fitted[i].start, fitted[i].end, {} });
+        else {
+          const auto middle = fitted[i].start + (fitted[i].end - fitted[i].start) / 2;
+          fitter.fit(fitted[i].start, middle, refitted);
+          fitter.fit(middle, fitted[i].end, refitted);
+        }
+      }
+      fitted = std::move(refitted);
+    }
+
+    for (const auto& part : fitted) {
+      const auto transform = transform_of(part.start, part.end);
+      const auto exact = part.coefficients.empty();
+      starts_.push_back(part.start);
+      pieces_.push_back({ transform.first, transform.second, coefficients_.size(),
+        exact ? 0u : static_cast<unsigned>(part.coefficients.size() - 1), exact });
+      coefficients_.insert(coefficients_.end(), part.coefficients.begin(), part.coefficients.end());
+    }
+    starts_.push_back(end_);
+    const auto bucket_count = 4 * pieces_.size();
+    bucket_scale_ = static_cast<double>(bucket_count) / (end_ - lower_);
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+      const auto start = lower_ + static_cast<double>(bucket) / bucket_scale_;
+      bucket_pieces_.push_back(static_cast<size_t>(std::upper_bound(starts_.begin(), starts_.end() - 1, start) - starts_.begin()) - 1);
+    }
+  }
+
+  size_t piecewise_approximation::exact_piece_count() const {
+    return static_cast<size_t>(std::count_if(pieces_.begin(), pieces_.end(), [](const piece& piece) { return piece.exact; }));
+  }
+
+  size_t piecewise_approximation::piece_of(double input) const {
+    const auto bucket = std::min(static_cast<size_t>((input - lower_) * bucket_scale_), bucket_pieces_.size() - 1);
+    auto index = bucket_pieces_[bucket];
+    while (index > 0 && input < starts_[index])
+      --index;
+    while (input >= starts_[index + 1])
+      ++index;
+    return index;
+  }
+
+  double piecewise_approximation::eval_piece(const piece& piece, double input) const {
+    return eval_chebyshev(coefficients_.data() + piece.first_coefficient, piece.degree, piece.center, piece.scale, input);
+  }
+
+  double piecewise_approximation::eval(double input) const {
+    if (!(input >= lower_ && input < end_))
+      return exact_.eval(input);
+    const auto& piece = pieces_[piece_of(input)];
+    return piece.exact ? exact_.eval(input) : eval_piece(piece, input);
+  }
+
+  // Inputs evaluated exactly are gathered per tile and evaluated by the plan together
+  void piecewise_approximation::eval_batch(const double* input, double* output, size_t count) const {
+    const auto tile_size = std::min(count, execution_plan::tile_size);
+    std::vector<double> exact_values(tile_size);
+    std::vector<size_t> exact_positions(tile_size);
+    for (size_t offset = 0; offset < count; offset += tile_size) {
+      const auto tile = std::min(tile_size, count - offset);
+      size_t exact = 0;
+      for (size_t i = offset; i < offset + tile; ++i) {
+        const auto value = input[i];
+        if (value >= lower_ && value < end_) {
+          const auto& piece = pieces_[piece_of(value)];
+          if (!piece.exact) {
+            output[i] = eval_piece(piece, value);
+            continue;
+          }
+        }
+        exact_values[exact] = value;
+        exact_positions[exact++] = i;
+      }
+      if (exact == 0)
+        continue;
+      exact_.eval_batch(exact_values.data(), exact_values.data(), exact);
+      for (size_t j = 0; j < exact; ++j)
+        output[exact_positions[j]] = exact_values[j];
+    }
+  }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "execution_plan.h"
+#include <vector>
+
+namespace mathlab {
+
+  // Error allowed by an approximation, absolute or relative to the magnitude of the exact result
+  struct error_tolerance {
+    double value;
+    bool relative;
+  };
+
+  // Inputs in [lower, upper] are approximated within tolerance
+  struct approximation_settings {
+    double lower;
+    double upper;
+    error_tolerance tolerance;
+  };
+
+  // Approximation of a sequence of blocks by Chebyshev polynomials on pieces of the input domain
+  // Pieces are halved until the range of the input of every limit, condition and power block on a piece stays off
+  // its limits, constant or zero, and pieces of the smallest width where it does not are evaluated exactly; smooth
+  // pieces are split further until the fit is within tolerance of exact evaluation on a dense sample of every piece
+  // Pieces that can not be fitted, e.g. around poles, and inputs outside the domain or NaN are evaluated exactly
+  // The error bound holds on the verification samples, between them it relies on the smoothness of the pieces
+  class piecewise_approximation {
+    struct piece {
+      double center;
+      // Maps piece to [-1, 1]
+      double scale;
+      size_t first_coefficient;
+      // Polynomial degree, exact pieces have none
+      unsigned degree;
+      bool exact;
+    };
+    execution_plan exact_;
+    double lower_;
+    // First input after the domain
+    double end_;
+    // Start of every piece and end_ after the last one
+    std::vector<double> starts_;
+    std::vector<piece> pieces_;
+    std::vector<double> coefficients_;
+    // First piece of every bucket of equal width, for lookup without binary search
+    std::vector<size_t> bucket_pieces_;
+    double bucket_scale_ = 0.;
+    double max_error_ = 0.;
+  public:
+    static constexpr unsigned max_degree = 15;
+    // Verification samples of every piece, the whole domain is sampled again after pieces are fitted
+    static constexpr size_t piece_samples = 256;
+    static constexpr size_t domain_samples = 1 << 16;
+    // Splits of pieces, e.g. for a tolerance below rounding error, after which pieces that fail are evaluated exactly
+    static constexpr size_t max_pieces = 1 << 14;
+
+    // Exact evaluation runs a plan of blocks optimized at level
+    // Throws invalid_argument if domain is empty or not finite or tolerance is not positive
+    piecewise_approximation(const std::vector<block_description>& blocks, optimization_level level, const approximation_settings& settings);
+    double eval(double input) const;
+    // Input and output may point to the same buffer
+    void eval_batch(const double* input, double* output, size_t count) const;
+    size_t piece_count() const { return pieces_.size(); }
+    size_t exact_piece_count() const;
+    // Largest error found on verification samples, relative if tolerance is relative
+    double max_error() const { return max_error_; }
+  private:
+    size_t piece_of(double input) const;
+    double eval_piece(const piece& piece, double input) const;
+  };
+}
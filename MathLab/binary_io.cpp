@@ -0,0 +1,335 @@
+#include "binary_io.h"
+#include "little_endian.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace {
+  using namespace mathlab;
+
+  const char magic[4] = { 'M', 'L', 'V', 'F' };
+
+  size_t header_size(precision type) {
+    return type == precision::f64 ? binary_header_size : binary_header_v2_size;
+  }
+
+  void store_header(uint64_t count, precision type, char* to) {
+    std::memcpy(to, magic, sizeof(magic));
+    store_little_endian(type == precision::f64 ? uint32_t(1) : binary_format_version, to + 4);
+    store_little_endian(count, to + 8);
+    if (type != precision::f64) {
+      store_little_endian(static_cast<uint32_t>(type), to + 16);
+      store_little_endian(uint32_t(0), to + 20);
+    }
+  }
+
+  struct header {
+    uint64_t count;
+    precision type;
+  };
+
+  // Validates header of size bytes, which may be longer than the header
+  header parse_header(const char* data, size_t size) {
+    if (size < binary_header_size || !is_binary(data, size))
+      throw std::invalid_argument("Input is not in binary format");
+    const auto version = load_little_endian<uint32_t>(data + 4);
+    const auto count = load_little_endian<uint64_t>(data + 8);
+    if (version == 1)
+      return { count, precision::f64 };
+    if (version != binary_format_version)
+      throw std::invalid_argument("Unsupported binary format version " + std::to_string(version));
+    if (size < binary_header_v2_size)
+      throw std::invalid_argument("Input is not in binary format");
+    const auto type = load_little_endian<uint32_t>(data + 16);
+    if (type > static_cast<uint32_t>(precision::f80))
+      throw std::invalid_argument("Unsupported precision of binary values " + std::to_string(type));
+    return { count, static_cast<precision>(type) };
+  }
+
+  void store_float32(float value, char* to) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    store_little_endian(bits, to);
+  }
+
+  float load_float32(const char* from) {
+    const auto bits = load_little_endian<uint32_t>(from);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  void store_float64(double value, char* to) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    store_little_endian(bits, to);
+  }
+
+  double load_float64(const char* from) {
+    const auto bits = load_little_endian<uint64_t>(from);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  // Encoded from the value, so that hosts where long double is not x87 extended precision read and write the same files
+  void store_float80(long double value, char* to) {
+    uint64_t significand = 0;
+    uint16_t sign_exponent = std::signbit(value) ? 0x8000 : 0;
+    if (std::isnan(value)) {
+      sign_exponent |= 0x7FFF;
+      significand = 0xC000000000000000ull;
+    }
+    else if (std::isinf(value)) {
+      sign_exponent |= 0x7FFF;
+      significand = 0x8000000000000000ull;
+    }
+    else if (value != 0) {
+      int exponent;
+      // value is fraction * 2^exponent with fraction in [0.5, 1), the integer bit is the highest bit of significand
+      const auto fraction = std::frexp(std::fabs(value), &exponent);
+      const auto biased = exponent - 1 + 16383;
+      if (biased > 0) {
+        significand = static_cast<uint64_t>(std::ldexp(fraction, 64));
+        sign_exponent |= static_cast<uint16_t>(biased);
+      }
+      else {
+        // Denormal, the exponent field is zero and stands for the same exponent as one
+        significand = static_cast<uint64_t>(std::ldexp(fraction, 63 + biased));
+      }
+    }
+    store_little_endian(significand, to);
+    store_little_endian(sign_exponent, to + 8);
+    std::memset(to + 10, 0, 6);
+  }
+
+  long double load_float80(const char* from) {
+    const auto significand = load_little_endian<uint64_t>(from);
+    const auto sign_exponent = load_little_endian<uint16_t>(from + 8);
+    const auto exponent = sign_exponent & 0x7FFF;
+    long double value;
+    if (exponent == 0x7FFF)
+      value = (significand << 1) == 0 ? std::numeric_limits<long double>::infinity() : std::numeric_limits<long double>::quiet_NaN();
+    else
+      value = std::ldexp(static_cast<long double>(significand), (exponent == 0 ? 1 : exponent) - 16383 - 63);
+    return (sign_exponent & 0x8000) != 0 ? -value : value;
+  }
+
+  template<typename TValue>
+  void convert_text(std::istream& text, binary_writer& writer) {
+    text_reader reader(text);
+    std::vector<TValue> values(text_buffer_size / sizeof(TValue));
+    while (auto count = reader.read(values.data(), values.size()))
+      writer.write(values.data(), count);
+  }
+
+  template<typename TValue>
+  void convert_binary(binary_reader& reader, std::ostream& text) {
+    text_writer writer(text);
+    std::vector<TValue> values(text_buffer_size / sizeof(TValue));
+    while (auto count = reader.read(values.data(), values.size()))
+      writer.write(values.data(), count);
+  }
+}
+
+namespace mathlab {
+
+  size_t binary_value_size(precision type) {
+    switch (type) {
+    case precision::f32: return 4;
+    case precision::f80: return 16;
+    default: return 8;
+    }
+  }
+
+  bool is_binary(const char* data, size_t size) {
+    return size >= sizeof(magic) && std::memcmp(data, magic, sizeof(magic)) == 0;
+  }
+
+  binary_values parse_binary(const char* first, const char* last) {
+    const auto size = static_cast<size_t>(last - first);
+    const auto header = parse_header(first, size);
+    const auto value_size = binary_value_size(header.type);
+    const auto value_bytes = size - header_size(header.type);
+    if (value_bytes % value_size != 0 || (header.count != unknown_value_count && header.count != value_bytes / value_size))
+      throw std::invalid_argument("Size of binary input does not match its header");
+    return { first + header_size(header.type), value_bytes / value_size, header.type };
+  }
+
+  void store_binary_values(const double* values, char* to, size_t count) {
+    if (is_little_endian()) {
+      std::memcpy(to, values, count * sizeof(double));
+      return;
+    }
+    for (size_t i = 0; i < count; ++i)
+      store_float64(values[i], to + i * sizeof(double));
+  }
+
+  void load_binary_values(const char* from, double* to, size_t count) {
+    if (is_little_endian()) {
+      std::memcpy(to, from, count * sizeof(double));
+      return;
+    }
+    for (size_t i = 0; i < count; ++i)
+      to[i] = load_float64(from + i * sizeof(double));
+  }
+
+  const double* binary_values_in_place(const char* data) {
+    if (!is_little_endian() || reinterpret_cast<uintptr_t>(data) % alignof(double) != 0)
+      return nullptr;
+    return reinterpret_cast<const double*>(data);
+  }
+
+  template<typename TValue>
+  void store_binary_values(const TValue* values, char* to, size_t count, precision type) {
+    const auto size = binary_value_size(type);
+    if (type == precision_of<TValue>() && type != precision::f80 && is_little_endian()) {
+      std::memcpy(to, values, count * size);
+      return;
+    }
+    for (size_t i = 0; i < count; ++i, to += size) {
+      switch (type) {
+      case precision::f32: store_float32(static_cast<float>(values[i]), to); break;
+      case precision::f64: store_float64(static_cast<double>(values[i]), to); break;
+      case precision::f80: store_float80(values[i], to); break;
+      }
+    }
+  }
+
+  template<typename TValue>
+  void load_binary_values(const char* from, precision type, TValue* to, size_t count) {
+    const auto size = binary_value_size(type);
+    if (type == precision_of<TValue>() && type != precision::f80 && is_little_endian()) {
+      std::memcpy(to, from, count * size);
+      return;
+    }
+    for (size_t i = 0; i < count; ++i, from += size) {
+      switch (type) {
+      case precision::f32: to[i] = static_cast<TValue>(load_float32(from)); break;
+      case precision::f64: to[i] = static_cast<TValue>(load_float64(from)); break;
+      case precision::f80: to[i] = static_cast<TValue>(load_float80(from)); break;
+      }
+    }
+  }
+
+  template<typename TValue>
+  const TValue* binary_values_in_place(const char* data, precision type) {
+    if (type != precision_of<TValue>() || type == precision::f80 || !is_little_endian() || reinterpret_cast<uintptr_t>(data) % alignof(TValue) != 0)
+      return nullptr;
+    return reinterpret_cast<const TValue*>(data);
+  }
+
+  binary_reader::binary_reader(std::istream& input) : input_(&input) {
+    char header[binary_header_v2_size];
+    input.read(header, binary_header_size);
+    auto size = static_cast<size_t>(input.gcount());
+    // Version 2 header continues after the header of version 1
+    if (size == binary_header_size && is_binary(header, size) && load_little_endian<uint32_t>(header + 4) != 1) {
+      input.read(header + size, binary_header_v2_size - binary_header_size);
+      size += static_cast<size_t>(input.gcount());
+    }
+    const auto parsed = parse_header(header, size);
+    count_ = parsed.count;
+    type_ = parsed.type;
+    remaining_ = count_;
+  }
+
+  binary_reader::binary_reader(const binary_values& values)
+    : position_(values.data), count_(values.count), remaining_(values.count), type_(values.type) {}
+
+  template<typename TValue>
+  size_t binary_reader::read(TValue* values, size_t capacity) {
+    const auto size = binary_value_size(type_);
+    const auto count = static_cast<size_t>(std::min<uint64_t>(capacity, remaining_));
+    if (input_ == nullptr) {
+      load_binary_values(position_, type_, values, count);
+      position_ += count * size;
+      remaining_ -= count;
+      return count;
+    }
+    // Values of the same precision are read in place
+    const auto in_place = type_ == precision_of<TValue>() && type_ != precision::f80;
+    if (!in_place)
+      buffer_.resize(count * size);
+    const auto bytes = in_place ? reinterpret_cast<char*>(values) : buffer_.data();
+    input_->read(bytes, static_cast<std::streamsize>(count * size));
+    const auto read_bytes = static_cast<size_t>(input_->gcount());
+    const auto read_count = read_bytes / size;
+    if (read_bytes % size != 0 || (count_ != unknown_value_count && read_count < count))
+      throw std::invalid_argument("Binary input is truncated");
+    if (!in_place || !is_little_endian())
+      load_binary_values(bytes, type_, values, read_count);
+    if (count_ != unknown_value_count)
+      remaining_ -= read_count;
+    return read_count;
+  }
+
+  binary_writer::binary_writer(std::ostream& output, precision type) : output_(output), header_position_(output.tellp()), type_(type) {
+    char header[binary_header_v2_size];
+    store_header(unknown_value_count, type_, header);
+    output_.write(header, static_cast<std::streamsize>(header_size(type_)));
+  }
+
+  template<typename TValue>
+  void binary_writer::write(const TValue* values, size_t count) {
+    count_ += count;
+    if (type_ == precision_of<TValue>() && type_ != precision::f80 && is_little_endian()) {
+      output_.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(count * sizeof(TValue)));
+      return;
+    }
+    buffer_.resize(count * binary_value_size(type_));
+    store_binary_values(values, buffer_.data(), count, type_);
+    output_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+  }
+
+  void binary_writer::finish() {
+    if (header_position_ == std::streampos(-1) || !output_)
+      return;
+    const auto end = output_.tellp();
+    char header[binary_header_v2_size];
+    store_header(count_, type_, header);
+    output_.seekp(header_position_);
+    output_.write(header, static_cast<std::streamsize>(header_size(type_)));
+    output_.seekp(end);
+  }
+
+  // Text is parsed directly in precision of binary values, so that every value is rounded once
+  void text_to_binary(std::istream& text, std::ostream& binary, precision type) {
+    binary_writer writer(binary, type);
+    switch (type) {
+    case precision::f32: convert_text<float>(text, writer); break;
+    case precision::f64: convert_text<double>(text, writer); break;
+    case precision::f80: convert_text<long double>(text, writer); break;
+    }
+    writer.finish();
+  }
+
+  void binary_to_text(std::istream& binary, std::ostream& text) {
+    binary_reader reader(binary);
+    switch (reader.type()) {
+    case precision::f32: convert_binary<float>(reader, text); break;
+    case precision::f64: convert_binary<double>(reader, text); break;
+    case precision::f80: convert_binary<long double>(reader, text); break;
+    }
+  }
+
+  template void store_binary_values(const float* values, char* to, size_t count, precision type);
+  template void store_binary_values(const double* values, char* to, size_t count, precision type);
+  template void store_binary_values(const long double* values, char* to, size_t count, precision type);
+  template void load_binary_values(const char* from, precision type, float* to, size_t count);
+  template void load_binary_values(const char* from, precision type, double* to, size_t count);
+  template void load_binary_values(const char* from, precision type, long double* to, size_t count);
+  template const float* binary_values_in_place(const char* data, precision type);
+  template const double* binary_values_in_place(const char* data, precision type);
+  template const long double* binary_values_in_place(const char* data, precision type);
+  template size_t binary_reader::read(float* values, size_t capacity);
+  template size_t binary_reader::read(double* values, size_t capacity);
+  template size_t binary_reader::read(long double* values, size_t capacity);
+  template void binary_writer::write(const float* values, size_t count);
+  template void binary_writer::write(const double* values, size_t count);
+  template void binary_writer::write(const long double* values, size_t count);
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "value_io.h"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace mathlab {
+
+  // Binary format of values, all numbers little-endian:
+  //  4 bytes - magic "MLVF"
+  //  uint32 - format version
+  //  uint64 - number of values, unknown_value_count if values were streamed and run until the end of file
+  //  version 2 only: uint32 - precision of values, 0 for f32, 1 for f64 and 2 for f80, then uint32 - zero
+  //  values - float64 in version 1, float32, float64 or float80 in version 2
+  // float80 is x87 extended precision, 64-bit significand with explicit integer bit followed by sign and 15-bit exponent,
+  // padded with zeros to 16 bytes
+  // f64 values are written in version 1, which earlier versions of the program read
+  constexpr size_t binary_header_size = 16;
+  constexpr size_t binary_header_v2_size = 24;
+  constexpr uint32_t binary_format_version = 2;
+  constexpr uint64_t unknown_value_count = ~uint64_t(0);
+
+  // Bytes of one value of given precision in binary format
+  size_t binary_value_size(precision type);
+
+  // True if data starts with magic of binary format
+  bool is_binary(const char* data, size_t size);
+
+  struct binary_values {
+    // First byte of little-endian values, not necessarily aligned
+    const char* data;
+    size_t count;
+    precision type = precision::f64;
+  };
+
+  // Validates header and size of binary format in memory
+  // Throws invalid_argument if data is not in binary format or size does not match header
+  binary_values parse_binary(const char* first, const char* last);
+  // Converts count doubles to little-endian values
+  void store_binary_values(const double* values, char* to, size_t count);
+  // Converts count little-endian values to doubles
+  void load_binary_values(const char* from, double* to, size_t count);
+  // Values as doubles without conversion, nullptr if host is not little-endian or data is not aligned
+  const double* binary_values_in_place(const char* data);
+  // Same for values of any precision, templated functions are defined for float, double and long double
+  // Values are converted, except for values of TValue's own precision on little-endian hosts
+  template<typename TValue>
+  void store_binary_values(const TValue* values, char* to, size_t count, precision type);
+  template<typename TValue>
+  void load_binary_values(const char* from, precision type, TValue* to, size_t count);
+  // nullptr also if values are not of TValue's precision or are float80
+  template<typename TValue>
+  const TValue* binary_values_in_place(const char* data, precision type);
+
+  // Reads values of binary format from a stream or from memory
+  class binary_reader {
+    std::istream* input_ = nullptr;
+    const char* position_ = nullptr;
+    uint64_t count_;
+    uint64_t remaining_;
+    precision type_ = precision::f64;
+    // Values read from stream before conversion
+    std::vector<char> buffer_;
+  public:
+    // Reads and validates header, throws invalid_argument
+    explicit binary_reader(std::istream& input);
+    explicit binary_reader(const binary_values& values);
+
+    // Number of values from header, may be unknown_value_count for stream
+    uint64_t count() const { return count_; }
+    precision type() const { return type_; }
+    // Reads up to capacity values and converts them to TValue, returns number of read values or 0 at the end of input
+    // Throws invalid_argument if input ends in the middle of a value or before count values
+    template<typename TValue>
+    size_t read(TValue* values, size_t capacity);
+  };
+
+  // Writes values in binary format, header is written on construction
+  class binary_writer {
+    std::ostream& output_;
+    std::streampos header_position_;
+    const precision type_;
+    uint64_t count_ = 0;
+    std::vector<char> buffer_;
+  public:
+    explicit binary_writer(std::ostream& output, precision type = precision::f64);
+    // Converts values to precision of the writer
+    template<typename TValue>
+    void write(const TValue* values, size_t count);
+    // Stores number of written values to header if output is seekable, otherwise header keeps unknown_value_count
+    void finish();
+  };
+
+  // Converters between text with one value per line and binary format, text is written in precision of binary values
+  // Throw invalid_argument on invalid input
+  void text_to_binary(std::istream& text, std::ostream& binary, precision type = precision::f64);
+  void binary_to_text(std::istream& binary, std::ostream& text);
+}
@@ -1,77 +1,341 @@
 #include "block_sequence.h"
-#include <numeric>
+#include <algorithm>
+#include <atomic>
 #include <sstream>
 
 namespace {
-  std::pair<std::string, std::istringstream> extract_type(const std::string& line)
-  {
-    std::string block_type;
-    std::istringstream line_stream(line);
-    line_stream >> block_type;
-    return std::make_pair(std::move(block_type), std::move(line_stream));
+  // Constants of block as written by dump of the block itself, so that a dumped sequence loads again with the same results
+  std::ostream& dump_constants(std::ostream& to_stream, const mathlab::compact_block& block) {
+    for (size_t i = 0; i < mathlab::constant_count(block.kind); ++i)
+      mathlab::write_token(to_stream, block.constants[i]);
+    return to_stream;
   }
 }
 
 namespace mathlab {
 
-  block_sequence::block_sequence(factory& factory) : factory_(factory) {}
+  sequence_version::sequence_version(const sequence_version& previous) : number_(previous.number_ + 1), factory_(previous.factory_), blocks_(previous.blocks_),
+    optimization_(previous.optimization_), plan_(previous.plan_), unoptimized_plan_(previous.unoptimized_plan_), use_jit_(previous.use_jit_), jit_(previous.jit_),
+    stats_(previous.stats_), cache_(previous.cache_), prefix_(previous.prefix_), prefix_generation_(previous.prefix_generation_),
+    approximation_settings_(previous.approximation_settings_), approximation_(previous.approximation_) {}
+
+  std::ostream& sequence_version::dump(std::ostream& to_stream, bool with_line_numbers) const {
+    int position = 1;
+    for (auto& block : blocks_) {
+      if (with_line_numbers)
+        to_stream << position++ << ": ";
+      dump_constants(to_stream << factory_->type_name(block.type) << ' ', block) << std::endl;
+    }
+    return to_stream;
+  }
+
+  double sequence_version::eval(double input) const {
+    if (stats_ != nullptr)
+      return eval_with_stats(input);
+    return plan_->eval(input);
+  }
+
+  void sequence_version::eval_batch(const double* input, double* output, size_t count) const {
+    if (stats_ != nullptr)
+      eval_batch_with_stats(input, output, count);
+    else if (prefix_ != nullptr)
+      eval_batch_incremental(input, output, count);
+    else if (cache_ != nullptr && cache_->active())
+      cache_->eval_batch(input, output, count, [this](const double* from, double* to, size_t missed) { eval_batch_uncached(from, to, missed); });
+    else
+      eval_batch_uncached(input, output, count);
+  }
+
+  void sequence_version::eval_batch_uncached(const double* input, double* output, size_t count) const {
+    if (approximation_ != nullptr)
+      approximation_->eval_batch(input, output, count);
+    else if (jit_ != nullptr)
+      jit_->eval_batch(input, output, count);
+    else
+      plan_->eval_batch(input, output, count);
+  }
+
+  // Checkpoints run segments with the same plans, so their outputs are not affected by checkpoints taken before
+  void sequence_version::eval_batch_incremental(const double* input, double* output, size_t count) const {
+    const auto found = prefix_->find(input, count, prefix_generation_);
+    // Input is kept before it is overwritten by evaluation in place
+    const auto batch = found.batch != nullptr ? found.batch : prefix_->insert(input, count);
+    auto position = found.position;
+    if (found.values != nullptr)
+      std::copy(found.values->begin(), found.values->end(), output);
+    else if (input != output)
+      std::copy(input, input + count, output);
+    const auto run = [this, output, count](size_t first, size_t last) {
+      const auto& segment = segment_of(first, last);
+      if (segment.jit != nullptr)
+        segment.jit->eval_batch(output, output, count);
+      else
+        segment.plan.eval_batch(output, output, count);
+    };
+    for (auto checkpoint : prefix_cache::checkpoint_positions(blocks_.size())) {
+      if (checkpoint <= position)
+        continue;
+      run(position, checkpoint);
+      position = checkpoint;
+      if (batch != nullptr)
+        prefix_->add_checkpoint(batch, position, output, prefix_generation_);
+    }
+    if (position < blocks_.size())
+      run(position, blocks_.size());
+  }
+
+  const sequence_version::segment& sequence_version::segment_of(size_t first, size_t last) const {
+    std::lock_guard<std::mutex> lock(segments_mutex_);
+    auto& found = segments_[{ first, last }];
+    if (found == nullptr) {
+      const auto descriptions = describe();
+      auto plan = execution_plan(std::vector<block_description>(descriptions.begin() + first, descriptions.begin() + last), optimization_);
+      auto jit = use_jit_ ? jit_program::compile(plan) : nullptr;
+      found = std::make_unique<segment>(segment{ std::move(plan), std::move(jit) });
+    }
+    return *found;
+  }
+
+  std::vector<block_description> sequence_version::describe() const {
+    std::vector<block_description> descriptions;
+    descriptions.reserve(blocks_.size());
+    for (auto& block : blocks_)
+      descriptions.push_back(block.describe());
+    return descriptions;
+  }
+
+  std::vector<std::string_view> sequence_version::type_names() const {
+    std::vector<std::string_view> names;
+    names.reserve(blocks_.size());
+    for (auto& block : blocks_)
+      names.push_back(factory_->type_name(block.type));
+    return names;
+  }
+
+  std::vector<std::string> sequence_version::block_names() const {
+    std::vector<std::string> names;
+    names.reserve(blocks_.size());
+    for (auto& block : blocks_) {
+      std::ostringstream name;
+      dump_constants(name << factory_->type_name(block.type) << ' ', block);
+      auto text = name.str();
+      text.erase(text.find_last_not_of(' ') + 1);
+      names.push_back(std::move(text));
+    }
+    return names;
+  }
+
+  // Blocks are evaluated one by one like a plan without optimization, time is measured for sampled calls only
+  // Statistics of the call are collected in a buffer of the thread, so that single evaluation does not allocate
+  double sequence_version::eval_with_stats(double input) const {
+    thread_local std::vector<block_stats> blocks;
+    blocks.assign(blocks_.size(), block_stats());
+    const auto timed = stats_->sample();
+    const auto start = timed ? stats_clock::now() : stats_clock::time_point();
+    auto previous = start;
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+      input = eval_described(blocks_[i].describe(), input);
+      blocks[i].add_outputs(&input, 1);
+      if (timed) {
+        const auto now = stats_clock::now();
+        blocks[i].add_time(1, now - previous);
+        previous = now;
+      }
+    }
+    std::optional<double> latency;
+    if (timed)
+      latency = to_nanoseconds(previous - start);
+    stats_->record_eval(blocks, latency);
+    return input;
+  }
+
+  // Every block is timed over whole tiles, so the clock is read twice per block and tile_size values
+  void sequence_version::eval_batch_with_stats(const double* input, double* output, size_t count) const {
+    std::vector<block_stats> blocks(blocks_.size());
+    const auto start = stats_clock::now();
+    for (size_t offset = 0; offset < count; offset += tile_size) {
+      const auto tile = std::min(tile_size, count - offset);
+      const double* from = input + offset;
+      double* to = output + offset;
+      if (blocks_.empty())
+        std::copy(from, from + tile, to);
+      for (size_t i = 0; i < blocks_.size(); ++i) {
+        const auto block_start = stats_clock::now();
+        eval_batch_described(blocks_[i].describe(), from, to, tile);
+        blocks[i].add_time(tile, stats_clock::now() - block_start);
+        blocks[i].add_outputs(to, tile);
+        from = to;
+      }
+    }
+    stats_->record_batch(blocks, to_nanoseconds(stats_clock::now() - start));
+  }
+
+  block_sequence::block_sequence(factory& factory) : factory_(factory) {
+    auto first = std::unique_ptr<sequence_version>(new sequence_version());
+    first->factory_ = &factory;
+    first->plan_ = std::make_shared<const execution_plan>(std::vector<block_description>(), first->optimization_);
+    first->unoptimized_plan_ = first->plan_;
+    current_ = std::move(first);
+  }
+
+  std::shared_ptr<const sequence_version> block_sequence::current() const {
+    return std::atomic_load(&current_);
+  }
+
+  std::unique_ptr<sequence_version> block_sequence::next_version() const {
+    return std::unique_ptr<sequence_version>(new sequence_version(*current()));
+  }
+
+  void block_sequence::publish(std::unique_ptr<sequence_version> next) {
+    std::atomic_store(&current_, std::shared_ptr<const sequence_version>(std::move(next)));
+  }
 
   std::string block_sequence::append_from(std::istream& input_stream) {
-    std::string block_type;
-    std::istringstream constants;
+    std::ostringstream text;
+    text << input_stream.rdbuf();
+    return append_from(text.str());
+  }
+
+  std::string block_sequence::append_from(std::string_view text) {
+    std::lock_guard<std::mutex> lock(edit_mutex_);
+    auto next = next_version();
+    const auto first_appended = next->blocks_.size();
+    auto invalid_lines = append_to(*next, text);
+    update_plan(*next, first_appended);
+    publish(std::move(next));
+    return invalid_lines;
+  }
+
+  std::string block_sequence::append_to(sequence_version& next, std::string_view text) const {
     std::string invalid_lines;
-    std::string line;
-    while (!input_stream.eof()) {
-      std::getline(input_stream, line);
-      std::tie(block_type, constants) = extract_type(line);
-      if (!block_type.empty()) {
-        std::unique_ptr<block> block;
-        try {
-          block = factory_.create(block_type, constants);
-        }
-        catch (std::invalid_argument&) {
-          // Deliberately empty - handle same as unknown command
-        }
-        if (block != nullptr)
-          blocks_.push_back(std::make_pair(std::move(block_type), std::move(block)));
-        else
-          invalid_lines += line + "\n";
-      }
+    while (!text.empty()) {
+      const auto end = std::min(text.find('\n'), text.size());
+      const auto line = text.substr(0, end);
+      text.remove_prefix(std::min(end + 1, text.size()));
+      auto constants = line;
+      const auto block_type = next_token(constants);
+      if (block_type.empty())
+        continue;
+      if (auto block = factory_.create_compact(block_type, constants))
+        next.blocks_.push_back(*block);
+      else
+        invalid_lines.append(line).append("\n");
     }
     return invalid_lines;
   }
 
   std::string block_sequence::load_from(std::istream& input_stream) {
-    blocks_.clear();
-    return append_from(input_stream);
+    std::ostringstream text;
+    text << input_stream.rdbuf();
+    return load_from(text.str());
   }
 
-  std::ostream& block_sequence::dump(std::ostream& to_stream, bool with_line_numbers) const {
-    int position = 1;
-    for (auto& name_with_block : blocks_) {
-      if (with_line_numbers)
-        to_stream << position++ << ": ";
-      to_stream << name_with_block.first << ' ' << *name_with_block.second << std::endl;
-    }
-    return to_stream;
+  std::string block_sequence::load_from(std::string_view text) {
+    std::lock_guard<std::mutex> lock(edit_mutex_);
+    auto next = next_version();
+    next->blocks_.clear();
+    auto invalid_lines = append_to(*next, text);
+    update_plan(*next, 0);
+    publish(std::move(next));
+    return invalid_lines;
   }
 
-  double block_sequence::eval(double input) const {
-    return std::accumulate(
-      blocks_.cbegin(),
-      blocks_.cend(),
-      input,
-      [](double val, const std::pair<std::string, std::unique_ptr<block>> &name_with_block) { return name_with_block.second->eval(val); });
+  void block_sequence::assign(std::vector<compact_block> blocks) {
+    std::lock_guard<std::mutex> lock(edit_mutex_);
+    auto next = next_version();
+    next->blocks_ = std::move(blocks);
+    update_plan(*next, 0);
+    publish(std::move(next));
   }
 
   void block_sequence::remove_at(unsigned index) {
-    if (index < blocks_.size())
-      blocks_.erase(blocks_.begin() + index);
+    std::lock_guard<std::mutex> lock(edit_mutex_);
+    if (index >= current()->size())
+      return;
+    auto next = next_version();
+    next->blocks_.erase(next->blocks_.begin() + index);
+    update_plan(*next, index);
+    publish(std::move(next));
   }
 
   void block_sequence::move_to_beginning(unsigned index) {
-    if (index < blocks_.size() && index > 0) {
-      std::swap(blocks_[0], blocks_[index]);
+    std::lock_guard<std::mutex> lock(edit_mutex_);
+    auto next = next_version();
+    if (index < next->blocks_.size() && index > 0) {
+      std::swap(next->blocks_[0], next->blocks_[index]);
+      update_plan(*next, 0);
+    }
+    else {
+      update_plan(*next, next->blocks_.size());
     }
+    publish(std::move(next));
+  }
+
+  void block_sequence::set_optimization(optimization_level level) {
+    std::lock_guard<std::mutex> lock(edit_mutex_);
+    auto next = next_version();
+    next->optimization_ = level;
+    update_plan(*next, 0);
+    publish(std::move(next));
+  }
+
+  void block_sequence::set_jit(bool enabled) {
+    std::lock_guard<std::mutex> lock(edit_mutex_);
+    auto next = next_version();
+    next->use_jit_ = enabled;
+    // Native code computes the same values as the plan, so statistics and cached results stay valid
+    next->jit_ = enabled ? jit_program::compile(*next->plan_) : nullptr;
+    publish(std::move(next));
+  }
+
+  void block_sequence::set_stats(bool enabled) {
+    std::lock_guard<std::mutex> lock(edit_mutex_);
+    auto next = next_version();
+    next->stats_ = enabled ? std::make_shared<sequence_stats>(next->block_names()) : nullptr;
+    publish(std::move(next));
+  }
+
+  void block_sequence::set_cache(bool enabled) {
+    std::lock_guard<std::mutex> lock(edit_mutex_);
+    auto next = next_version();
+    next->cache_ = enabled ? std::make_shared<result_cache>() : nullptr;
+    publish(std::move(next));
+  }
+
+  void block_sequence::set_approximation(std::optional<approximation_settings> settings) {
+    std::lock_guard<std::mutex> lock(edit_mutex_);
+    auto next = next_version();
+    next->approximation_settings_ = settings;
+    next->approximation_ = settings ? std::make_shared<const piecewise_approximation>(next->describe(), next->optimization_, *settings) : nullptr;
+    // Statistics come from exact evaluation, cached results only from approximation being replaced
+    if (next->cache_ != nullptr && current()->approximation_ != nullptr)
+      next->cache_ = std::make_shared<result_cache>();
+    publish(std::move(next));
+  }
+
+  void block_sequence::set_incremental(bool enabled, size_t budget) {
+    std::lock_guard<std::mutex> lock(edit_mutex_);
+    auto next = next_version();
+    next->prefix_ = enabled ? std::make_shared<prefix_cache>(budget) : nullptr;
+    next->prefix_generation_ = enabled ? next->prefix_->generation() : 0;
+    publish(std::move(next));
+  }
+
+  // Runs before next is published, so readers keep evaluating the previous version while code is compiled
+  void block_sequence::update_plan(sequence_version& next, size_t first_changed) {
+    const auto blocks = next.describe();
+    auto plan = std::make_shared<const execution_plan>(blocks, next.optimization_);
+    next.jit_ = next.use_jit_ ? jit_program::compile(*plan) : nullptr;
+    // Optimization folds and rewrites steps in double, which other types would round differently
+    next.unoptimized_plan_ = next.optimization_ == optimization_level::none ? plan : std::make_shared<const execution_plan>(blocks, optimization_level::none);
+    next.plan_ = std::move(plan);
+    next.approximation_ = next.approximation_settings_
+      ? std::make_shared<const piecewise_approximation>(blocks, next.optimization_, *next.approximation_settings_) : nullptr;
+    if (next.stats_ != nullptr)
+      next.stats_ = std::make_shared<sequence_stats>(next.block_names());
+    if (next.cache_ != nullptr)
+      next.cache_ = std::make_shared<result_cache>();
+    if (next.prefix_ != nullptr)
+      next.prefix_generation_ = next.prefix_->invalidate_from(first_changed);
   }
 }
@@ -1,24 +1,168 @@
 #pragma once
+#include "approximation.h"
 #include "factory.h"
+#include "execution_plan.h"
+#include "jit_compiler.h"
+#include "prefix_cache.h"
+#include "result_cache.h"
+#include "sequence_stats.h"
+#include <map>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 
 namespace mathlab {
+  // Blocks and settings of a sequence at one point of its history, never changed after it is published
+  // Evaluation runs entirely on one version, so it is not affected by edits published meanwhile; a version is
+  // freed when the sequence and the last evaluation holding it drop it
+  class sequence_version {
+    friend class block_sequence;
+  public:
+    static constexpr size_t tile_size = execution_plan::tile_size;
+
+    // Versions of a sequence are numbered from 1 in the order they were published
+    uint64_t number() const { return number_; }
+    size_t size() const { return blocks_.size(); }
+    std::ostream& dump(std::ostream& to_stream, bool with_line_numbers) const;
+    double eval(double input) const;
+    // Evaluates count values from input into output, step by step over tiles of tile_size values
+    // Input and output may point to the same buffer
+    void eval_batch(const double* input, double* output, size_t count) const;
+    // Floats and long doubles are evaluated by a plan without optimization, so that results are those of the blocks
+    // in that type; native code, caches and statistics work on doubles only
+    void eval_batch(const float* input, float* output, size_t count) const { unoptimized_plan_->eval_batch(input, output, count); }
+    void eval_batch(const long double* input, long double* output, size_t count) const { unoptimized_plan_->eval_batch(input, output, count); }
+    // Descriptions of all blocks, in sequence order
+    std::vector<block_description> describe() const;
+    // Type names of all blocks, in sequence order
+    std::vector<std::string_view> type_names() const;
+    const execution_plan& plan() const { return *plan_; }
+    const jit_program* jit() const { return jit_.get(); }
+    sequence_stats* stats() const { return stats_.get(); }
+    const result_cache* cache() const { return cache_.get(); }
+    prefix_cache* incremental() const { return prefix_.get(); }
+    const piecewise_approximation* approximation() const { return approximation_.get(); }
+  private:
+    uint64_t number_ = 1;
+    // Blocks by value in one array, names of their types are kept by factory_
+    const factory* factory_ = nullptr;
+    std::vector<compact_block> blocks_;
+    optimization_level optimization_ = optimization_level::exact;
+    // Evaluation runs from the plan, rebuilt after every change of blocks
+    std::shared_ptr<const execution_plan> plan_;
+    // One step per block for floats and long doubles, the same as plan_ when optimization is none
+    std::shared_ptr<const execution_plan> unoptimized_plan_;
+    // Native code compiled from the plan when enabled, nullptr if disabled or not supported on this platform
+    bool use_jit_ = false;
+    std::shared_ptr<const jit_program> jit_;
+    // Statistics collected while enabled, evaluation then runs block by block, nullptr if disabled
+    std::shared_ptr<sequence_stats> stats_;
+    // Results of batch evaluation by input, nullptr if disabled
+    std::shared_ptr<result_cache> cache_;
+    // Outputs of unchanged blocks for batches evaluated before, shared by versions while enabled, nullptr if disabled
+    // Checkpoints are used only by versions of the generation the cache had when they were published
+    std::shared_ptr<prefix_cache> prefix_;
+    uint64_t prefix_generation_ = 0;
+    // Batch evaluation within domain of settings runs approximation built with the plan, nullptr if disabled
+    std::optional<approximation_settings> approximation_settings_;
+    std::shared_ptr<const piecewise_approximation> approximation_;
+    // Plan and native code of a range of blocks evaluated after a checkpoint of prefix_, built on first use
+    struct segment {
+      execution_plan plan;
+      std::unique_ptr<jit_program> jit;
+    };
+    mutable std::mutex segments_mutex_;
+    mutable std::map<std::pair<size_t, size_t>, std::unique_ptr<segment>> segments_;
+
+    sequence_version() = default;
+    // Blocks and settings of previous version under the next number, segments are built again
+    explicit sequence_version(const sequence_version& previous);
+    // Type and constants of every block as listed by dump
+    std::vector<std::string> block_names() const;
+    double eval_with_stats(double input) const;
+    void eval_batch_with_stats(const double* input, double* output, size_t count) const;
+    void eval_batch_uncached(const double* input, double* output, size_t count) const;
+    void eval_batch_incremental(const double* input, double* output, size_t count) const;
+    const segment& segment_of(size_t first, size_t last) const;
+  };
+
+  // Sequence of blocks that is edited while other threads evaluate it
+  // Every change builds a new version from the current one and publishes it with an atomic store, readers take
+  // the current version with an atomic load and never wait for an edit in progress; changes are serialized among themselves
+  // The atomic shared_ptr functions are not lock-free: libstdc++ guards the pointer with a mutex from a shared pool and
+  // MSVC with a global spinlock, held only while the pointer is copied or replaced
   class block_sequence {
-    std::vector<std::pair<std::string, std::unique_ptr<block>>> blocks_;
     factory& factory_;
+    std::mutex edit_mutex_;
+    // Accessed only by std::atomic_load and std::atomic_store once the constructor returns
+    std::shared_ptr<const sequence_version> current_;
   public:
+    static constexpr size_t tile_size = sequence_version::tile_size;
+
     block_sequence(factory& factory);
+    // Current version, kept alive by the returned pointer while later versions are published
+    std::shared_ptr<const sequence_version> current() const;
     // Appends one or more block from supplied stream
     // Returns invalid lines
     std::string append_from(std::istream& input_stream);
+    // Appends blocks from text, one per line, without copying lines or throwing
+    // Returns invalid lines, lines with unknown block type or without expected constants
+    std::string append_from(std::string_view text);
     // Load sequence from supplied stream
     // Returns invalid lines
     std::string load_from(std::istream& input_stream);
-    std::ostream& dump(std::ostream& to_stream, bool with_line_numbers) const;
-    double eval(double input) const;
+    std::string load_from(std::string_view text);
+    // Replaces all blocks with blocks created by caller, like a loader of another format
+    // Types of blocks are numbered by the factory of this sequence
+    void assign(std::vector<compact_block> blocks);
+    std::ostream& dump(std::ostream& to_stream, bool with_line_numbers) const { return current()->dump(to_stream, with_line_numbers); }
+    double eval(double input) const { return current()->eval(input); }
+    // Evaluates count values from input into output on the current version
+    // Input and output may point to the same buffer
+    void eval_batch(const double* input, double* output, size_t count) const { current()->eval_batch(input, output, count); }
+    void eval_batch(const float* input, float* output, size_t count) const { current()->eval_batch(input, output, count); }
+    void eval_batch(const long double* input, long double* output, size_t count) const { current()->eval_batch(input, output, count); }
+    // Index past the last block leaves the sequence unchanged
     void remove_at(unsigned index);
     void move_to_beginning(unsigned index);
+    // Descriptions of all blocks, in sequence order
+    std::vector<block_description> describe() const { return current()->describe(); }
+    // Type names of all blocks, in sequence order
+    std::vector<std::string_view> type_names() const { return current()->type_names(); }
+    void set_optimization(optimization_level level);
+    // Accessors below return parts of the current version, valid until the next change
+    const execution_plan& plan() const { return current()->plan(); }
+    // Batch evaluation runs native code compiled after every change of blocks, falls back to the plan where unsupported
+    void set_jit(bool enabled);
+    const jit_program* jit() const { return current()->jit(); }
+    // Instrumented evaluation records per block statistics, disabled evaluation is not affected
+    // Statistics are reset after every change of blocks
+    void set_stats(bool enabled);
+    sequence_stats* stats() const { return current()->stats(); }
+    // Batch evaluation looks up results of repeated inputs until the cache switches itself off at a low hit rate
+    // Cached results are dropped after every change of blocks or of the approximation that computed them,
+    // enabling again restarts a cache that switched off
+    void set_cache(bool enabled);
+    const result_cache* cache() const { return current()->cache(); }
+    // Batch evaluation keeps outputs after some of the last blocks for every batch within budget, and resumes from them
+    // when the same batch is evaluated again; a change of blocks drops outputs from the first changed block onward
+    // Kept outputs belong to one input, set by begin_input of incremental()
+    void set_incremental(bool enabled, size_t budget = prefix_cache::default_budget);
+    prefix_cache* incremental() const { return current()->incremental(); }
+    // Batch evaluation without statistics and kept outputs runs a piecewise approximation, rebuilt after every change of blocks
+    // Single evaluation stays exact, nullopt disables approximation
+    // Throws invalid_argument if domain or tolerance of settings is not valid
+    void set_approximation(std::optional<approximation_settings> settings);
+    const piecewise_approximation* approximation() const { return current()->approximation(); }
+  private:
+    // Copy of the current version to be changed by the caller holding edit_mutex_
+    std::unique_ptr<sequence_version> next_version() const;
+    void publish(std::unique_ptr<sequence_version> next);
+    // Rebuilds plan of next, blocks before first_changed are the same as before the change
+    static void update_plan(sequence_version& next, size_t first_changed);
+    // Appends blocks from text to next, returns invalid lines
+    std::string append_to(sequence_version& next, std::string_view text) const;
   };
 }
@@ -1,9 +1,77 @@
 #include "blocks.h"
+#include "simd_kernels.h"
 
 namespace mathlab
 {
-  std::ostream& operator<<(std::ostream& stream, const block& block) {
-    block.dump(stream);
-    return stream;
+  double eval_described(const block_description& block, double input) {
+    switch (block.kind) {
+    case block_kind::addition: return input + block.constants[0];
+    case block_kind::multiplication: return input * block.constants[0];
+    case block_kind::power: return power_function<double>()(input, block.constants[0]);
+    case block_kind::condition: return condition_function<double>()(input, block.constants[0]);
+    case block_kind::limit: return limit_function<double>()(input, block.constants[0], block.constants[1]);
+    default: return input;
+    }
   }
+
+  void eval_batch_described(const block_description& block, const double* input, double* output, size_t count) {
+    const auto& kernels = simd::kernels_of<double>();
+    switch (block.kind) {
+    case block_kind::addition: kernels.add(input, output, count, block.constants[0]); break;
+    case block_kind::multiplication: kernels.multiply(input, output, count, block.constants[0]); break;
+    case block_kind::power: kernels.power(input, output, count, block.constants[0]); break;
+    case block_kind::condition: kernels.condition(input, output, count, block.constants[0]); break;
+    case block_kind::limit: kernels.limit(input, output, count, block.constants[0], block.constants[1]); break;
+    default: kernels.copy(input, output, count); break;
+    }
+  }
+
+  template<typename TValue>
+  void basic_identity<TValue>::eval_batch(const TValue* input, TValue* output, size_t count) const {
+    simd::kernels_of<TValue>().copy(input, output, count);
+  }
+
+  template<typename TValue>
+  void basic_addition<TValue>::eval_batch(const TValue* input, TValue* output, size_t count) const {
+    simd::kernels_of<TValue>().add(input, output, count, std::get<0>(this->constants()));
+  }
+
+  template<typename TValue>
+  void basic_multiplication<TValue>::eval_batch(const TValue* input, TValue* output, size_t count) const {
+    simd::kernels_of<TValue>().multiply(input, output, count, std::get<0>(this->constants()));
+  }
+
+  template<typename TValue>
+  void basic_power<TValue>::eval_batch(const TValue* input, TValue* output, size_t count) const {
+    simd::kernels_of<TValue>().power(input, output, count, std::get<0>(this->constants()));
+  }
+
+  template<typename TValue>
+  void basic_condition<TValue>::eval_batch(const TValue* input, TValue* output, size_t count) const {
+    simd::kernels_of<TValue>().condition(input, output, count, std::get<0>(this->constants()));
+  }
+
+  template<typename TValue>
+  void basic_limit<TValue>::eval_batch(const TValue* input, TValue* output, size_t count) const {
+    simd::kernels_of<TValue>().limit(input, output, count, std::get<0>(this->constants()), std::get<1>(this->constants()));
+  }
+
+  template struct basic_identity<float>;
+  template struct basic_identity<double>;
+  template struct basic_identity<long double>;
+  template struct basic_addition<float>;
+  template struct basic_addition<double>;
+  template struct basic_addition<long double>;
+  template struct basic_multiplication<float>;
+  template struct basic_multiplication<double>;
+  template struct basic_multiplication<long double>;
+  template struct basic_power<float>;
+  template struct basic_power<double>;
+  template struct basic_power<long double>;
+  template struct basic_condition<float>;
+  template struct basic_condition<double>;
+  template struct basic_condition<long double>;
+  template struct basic_limit<float>;
+  template struct basic_limit<double>;
+  template struct basic_limit<long double>;
 }
\ No newline at end of file
@@ -1,22 +1,72 @@
 #pragma once
 #include <functional>
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
 #include "tuple_serialization.h"
 
 namespace mathlab
 {
-  // block interface
-  struct block {
-    virtual double eval(double input) const = 0;
+  enum class block_kind { identity, addition, multiplication, power, condition, limit };
+
+  // Kind and constants of a block, used to analyze and optimize sequences
+  // Unused constants are zero
+  struct block_description {
+    block_kind kind;
+    double constants[2];
+  };
+
+  // Number of constants used by blocks of kind
+  constexpr size_t constant_count(block_kind kind) {
+    return kind == block_kind::identity ? 0 : kind == block_kind::limit ? 2 : 1;
+  }
+
+  // Block stored by value in a sequence, type is the number of its type name interned by factory
+  // Unused constants are zero
+  struct compact_block {
+    block_kind kind;
+    uint32_t type;
+    double constants[2];
+
+    block_description describe() const { return { kind, { constants[0], constants[1] } }; }
+  };
+
+  // Evaluate block of kind and constants of description like the block itself, without creating it
+  double eval_described(const block_description& block, double input);
+  void eval_batch_described(const block_description& block, const double* input, double* output, size_t count);
+
+  // block interface over values of type TValue, block is the interface over doubles used by block_sequence
+  template<typename TValue>
+  struct basic_block {
+    using value_type = TValue;
+    virtual TValue eval(TValue input) const = 0;
+    // Evaluates count values from input into output
+    // Input and output may point to the same buffer
+    virtual void eval_batch(const TValue* input, TValue* output, size_t count) const = 0;
     virtual void dump(std::ostream& to_stream) const = 0;
-    virtual ~block() = default;
+    // Constants are converted to double
+    virtual block_description describe() const = 0;
+    virtual ~basic_block() = default;
   };
+  using block = basic_block<double>;
 
-  template<typename TCallable, typename ...TArgs>
-  struct block_with_constants : block {
-    double eval(double input) const override {
-      auto input_with_constants = std::tuple_cat(std::tuple<double>(input), constants_);
-      return std::apply(callable_, input_with_constants);
+  template<typename TValue, typename TCallable, typename ...TArgs>
+  struct basic_block_with_constants : basic_block<TValue> {
+    using function_type = TCallable;
+    using constants_type = std::tuple<TArgs...>;
+
+    TValue eval(TValue input) const override {
+      return std::apply([this, input](const TArgs&... constants) { return callable_(input, constants...); }, constants_);
+    }
+    // Unpacks constants once and applies callable to the whole batch
+    void eval_batch(const TValue* input, TValue* output, size_t count) const override {
+      std::apply([this, input, output, count](const TArgs&... constants) {
+        for (size_t i = 0; i < count; ++i)
+          output[i] = callable_(input[i], constants...);
+      }, constants_);
     }
     // Serializes all constants to stream
     void dump(std::ostream& to) const override {
@@ -31,39 +81,137 @@ namespace mathlab
       TBlock* block = std::apply(create<TBlock, TArgs...>, to);
       return std::unique_ptr<TBlock>(block);
     }
+    // Creates new block from constants at the beginning of text, separated by whitespace
+    // Returns nullptr if text does not start with expected constants
+    template<typename TBlock>
+    static std::unique_ptr<TBlock> create_from_text(std::string_view text) {
+      std::tuple<TArgs...> to;
+      if (!tuple_serialization<sizeof...(TArgs), TArgs...>::parse(text, to))
+        return nullptr;
+      return std::unique_ptr<TBlock>(std::apply(create<TBlock, TArgs...>, to));
+    }
+    // Creates new block from constants in the order of constructor arguments, as listed by describe
+    template<typename TBlock>
+    static std::unique_ptr<TBlock> create_from_values(const double* values) {
+      return create_from_values<TBlock>(values, std::index_sequence_for<TArgs...>());
+    }
+    // Parses constants at the beginning of text like create_from_text into values, converted to double like describe
+    // Returns false if text does not start with expected constants
+    static bool parse_constants(std::string_view text, double* values) {
+      std::tuple<TArgs...> to;
+      if (!tuple_serialization<sizeof...(TArgs), TArgs...>::parse(text, to))
+        return false;
+      store_constants(to, values, std::index_sequence_for<TArgs...>());
+      return true;
+    }
+    const std::tuple<TArgs...>& constants() const { return constants_; }
   protected:
-    block_with_constants(TCallable callable, TArgs... args) : callable_(std::move(callable)), constants_(std::tie(args...)) {}
+    basic_block_with_constants(TCallable callable, TArgs... args) : constants_(std::tie(args...)), callable_(std::move(callable)) {}
   private:
+    template<typename TBlock, size_t... Indices>
+    static std::unique_ptr<TBlock> create_from_values(const double* values, std::index_sequence<Indices...>) {
+      (void)values;
+      return std::unique_ptr<TBlock>(create<TBlock, TArgs...>(static_cast<TArgs>(values[Indices])...));
+    }
+    template<size_t... Indices>
+    static void store_constants(const std::tuple<TArgs...>& from, double* values, std::index_sequence<Indices...>) {
+      (void)from;
+      (void)values;
+      ((values[Indices] = static_cast<double>(std::get<Indices>(from))), ...);
+    }
+
     std::tuple<TArgs...> constants_;
     TCallable callable_;
   };
 
-  std::ostream& operator<<(std::ostream& stream, const block& block);
+  template<typename TCallable, typename ...TArgs>
+  using block_with_constants = basic_block_with_constants<double, TCallable, TArgs...>;
+
+  template<typename TValue>
+  std::ostream& operator<<(std::ostream& stream, const basic_block<TValue>& block) {
+    block.dump(stream);
+    return stream;
+  }
+
+  // Stateless functions of supported blocks, callable without indirection
+  template<typename TValue = double>
+  struct identity_function {
+    TValue operator()(TValue input) const { return input; }
+  };
+
+  template<typename TValue = double>
+  struct power_function {
+    TValue operator()(TValue input, TValue exponent) const { return std::pow(input, exponent); }
+  };
+
+  template<typename TValue = double>
+  struct condition_function {
+    TValue operator()(TValue input, TValue constant) const { return input < constant ? TValue(-1) : TValue(input == constant ? 0 : 1); }
+  };
+
+  template<typename TValue = double>
+  struct limit_function {
+    TValue operator()(TValue input, TValue lower, TValue upper) const { return std::clamp(input, lower, upper); }
+  };
 
-  // Supported blocks:
+  // Supported blocks, defined for float, double and long double; the names without basic_ are blocks over doubles
+  // eval_batch of each block runs vectorized kernel for running CPU (see simd_kernels.h)
+  // type_name is used by register_all_blocks and static_sequence
 
-  struct identity final : block_with_constants<std::function<double(double)>> {
-    identity() : block_with_constants([](auto input) { return input; }) {}
+  template<typename TValue>
+  struct basic_identity final : basic_block_with_constants<TValue, identity_function<TValue>> {
+    static constexpr const char* type_name = "identity";
+    basic_identity() : basic_identity::basic_block_with_constants(identity_function<TValue>()) {}
+    void eval_batch(const TValue* input, TValue* output, size_t count) const override;
+    block_description describe() const override { return { block_kind::identity, {} }; }
   };
 
-  struct addition final : block_with_constants<std::plus<double>, double> {
-    addition(double constant) : block_with_constants(std::plus<double>(), constant) {}
+  template<typename TValue>
+  struct basic_addition final : basic_block_with_constants<TValue, std::plus<TValue>, TValue> {
+    static constexpr const char* type_name = "addition";
+    basic_addition(TValue constant) : basic_addition::basic_block_with_constants(std::plus<TValue>(), constant) {}
+    void eval_batch(const TValue* input, TValue* output, size_t count) const override;
+    block_description describe() const override { return { block_kind::addition, { static_cast<double>(std::get<0>(this->constants())) } }; }
   };
 
-  struct multiplication final : block_with_constants<std::multiplies<double>, double> {
-    multiplication(double constant) : block_with_constants(std::multiplies<double>(), constant) {}
+  template<typename TValue>
+  struct basic_multiplication final : basic_block_with_constants<TValue, std::multiplies<TValue>, TValue> {
+    static constexpr const char* type_name = "multiplication";
+    basic_multiplication(TValue constant) : basic_multiplication::basic_block_with_constants(std::multiplies<TValue>(), constant) {}
+    void eval_batch(const TValue* input, TValue* output, size_t count) const override;
+    block_description describe() const override { return { block_kind::multiplication, { static_cast<double>(std::get<0>(this->constants())) } }; }
   };
 
-  struct power final : block_with_constants<std::function<double(double, double)>, double> {
-    power(double constant) : block_with_constants([](double input, double other) { return std::pow(input, other); }, constant) {}
+  template<typename TValue>
+  struct basic_power final : basic_block_with_constants<TValue, power_function<TValue>, TValue> {
+    static constexpr const char* type_name = "power";
+    basic_power(TValue constant) : basic_power::basic_block_with_constants(power_function<TValue>(), constant) {}
+    void eval_batch(const TValue* input, TValue* output, size_t count) const override;
+    block_description describe() const override { return { block_kind::power, { static_cast<double>(std::get<0>(this->constants())) } }; }
   };
   
-  struct condition final : block_with_constants<std::function<double(double, double)>, double> {
-    condition(double constant) : 
-      block_with_constants([](double input, double other) { return input < other ? -1 : (input == other ? 0 : 1); }, constant) {}
+  template<typename TValue>
+  struct basic_condition final : basic_block_with_constants<TValue, condition_function<TValue>, TValue> {
+    static constexpr const char* type_name = "condition";
+    basic_condition(TValue constant) : basic_condition::basic_block_with_constants(condition_function<TValue>(), constant) {}
+    void eval_batch(const TValue* input, TValue* output, size_t count) const override;
+    block_description describe() const override { return { block_kind::condition, { static_cast<double>(std::get<0>(this->constants())) } }; }
   };
 
-  struct limit final : block_with_constants<std::function<double(double, double, double)>, double, double> {
-    limit(double lower, double upper) : block_with_constants(std::clamp<double>, lower, upper) {}
+  template<typename TValue>
+  struct basic_limit final : basic_block_with_constants<TValue, limit_function<TValue>, TValue, TValue> {
+    static constexpr const char* type_name = "limit";
+    basic_limit(TValue lower, TValue upper) : basic_limit::basic_block_with_constants(limit_function<TValue>(), lower, upper) {}
+    void eval_batch(const TValue* input, TValue* output, size_t count) const override;
+    block_description describe() const override {
+      return { block_kind::limit, { static_cast<double>(std::get<0>(this->constants())), static_cast<double>(std::get<1>(this->constants())) } };
+    }
   };
-}
+
+  using identity = basic_identity<double>;
+  using addition = basic_addition<double>;
+  using multiplication = basic_multiplication<double>;
+  using power = basic_power<double>;
+  using condition = basic_condition<double>;
+  using limit = basic_limit<double>;
+}
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "command_line.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+  const std::string& value_of(const std::vector<std::string>& arguments, size_t& index) {
+    if (index + 1 == arguments.size())
+      throw std::invalid_argument("Missing value of " + arguments[index]);
+    return arguments[++index];
+  }
+
+  unsigned parse_thread_count(const std::string& value) {
+    size_t parsed = 0;
+    int count = 0;
+    try {
+      count = std::stoi(value, &parsed);
+    }
+    catch (std::exception&) {
+      // Deliberately empty - reported below
+    }
+    if (parsed != value.size() || count <= 0)
+      throw std::invalid_argument("Invalid thread count " + value);
+    return static_cast<unsigned>(count);
+  }
+
+  size_t parse_count(const std::string& value, const std::string& option) {
+    size_t parsed = 0;
+    unsigned long long count = 0;
+    try {
+      count = value.empty() || value[0] == '-' ? 0 : std::stoull(value, &parsed);
+    }
+    catch (std::exception&) {
+      // Deliberately empty - reported below
+    }
+    if (parsed != value.size() || count == 0)
+      throw std::invalid_argument("Invalid count " + value + " of " + option);
+    return static_cast<size_t>(count);
+  }
+
+  // Finite number or nullopt
+  std::optional<double> parse_number(const std::string& value) {
+    size_t parsed = 0;
+    double number = 0.;
+    try {
+      number = std::stod(value, &parsed);
+    }
+    catch (std::exception&) {
+      return std::nullopt;
+    }
+    if (parsed != value.size() || !std::isfinite(number))
+      return std::nullopt;
+    return number;
+  }
+}
+
+namespace mathlab {
+
+  batch_options::batch_options() : threads(default_thread_count()) {}
+
+  batch_options parse_command_line(const std::vector<std::string>& arguments) {
+    batch_options options;
+    std::optional<std::pair<double, double>> domain;
+    mathlab::error_tolerance tolerance = { 1e-9, false };
+    bool tolerance_given = false;
+    bool input_given = false;
+    bool summary_given = false;
+    for (size_t i = 0; i < arguments.size(); ++i) {
+      const auto& argument = arguments[i];
+      if (argument == "--sequence") {
+        options.sequence_paths.push_back(value_of(arguments, i));
+        options.sequence_path = options.sequence_paths[0];
+      }
+      else if (argument == "--in") {
+        options.input_path = value_of(arguments, i);
+        input_given = true;
+      }
+      else if (argument == "--sweep") {
+        const auto& value = value_of(arguments, i);
+        const auto first = value.find(':', 1);
+        const auto second = first == std::string::npos ? std::string::npos : value.find(':', first + 2);
+        const auto start = first == std::string::npos ? std::nullopt : parse_number(value.substr(0, first));
+        const auto stop = second == std::string::npos ? std::nullopt : parse_number(value.substr(first + 1, second - first - 1));
+        const auto step = second == std::string::npos ? std::nullopt : parse_number(value.substr(second + 1));
+        if (!start || !stop || !step)
+          throw std::invalid_argument("Invalid range " + value);
+        options.sweep = make_sweep_range(*start, *stop, *step);
+      }
+      else if (argument == "--out")
+        options.output_path = value_of(arguments, i);
+      else if (argument == "--threads")
+        options.threads = parse_thread_count(value_of(arguments, i));
+      else if (argument == "--format") {
+        const auto& format = value_of(arguments, i);
+        if (format == "text")
+          options.format = value_format::text;
+        else if (format == "binary")
+          options.format = value_format::binary;
+        else
+          throw std::invalid_argument("Invalid format " + format);
+      }
+      else if (argument == "--optimization") {
+        const auto& level = value_of(arguments, i);
+        if (level == "none")
+          options.optimization = optimization_level::none;
+        else if (level == "exact")
+          options.optimization = optimization_level::exact;
+        else if (level == "relaxed")
+          options.optimization = optimization_level::relaxed;
+        else
+          throw std::invalid_argument("Invalid optimization " + level);
+      }
+      else if (argument == "--precision") {
+        const auto& name = value_of(arguments, i);
+        if (auto parsed = parse_precision(name))
+          options.precision = *parsed;
+        else
+          throw std::invalid_argument("Invalid precision " + name);
+      }
+      else if (argument == "--approximate") {
+        const auto& value = value_of(arguments, i);
+        const auto separator = value.find(':', 1);
+        const auto lower = separator == std::string::npos ? std::nullopt : parse_number(value.substr(0, separator));
+        const auto upper = separator == std::string::npos ? std::nullopt : parse_number(value.substr(separator + 1));
+        if (!lower || !upper || !(*lower < *upper))
+          throw std::invalid_argument("Invalid domain " + value);
+        domain = std::make_pair(*lower, *upper);
+      }
+      else if (argument == "--tolerance") {
+        const auto& value = value_of(arguments, i);
+        const auto parsed = parse_number(value);
+        if (!parsed || !(*parsed > 0.))
+          throw std::invalid_argument("Invalid tolerance " + value);
+        tolerance.value = *parsed;
+        tolerance_given = true;
+      }
+      else if (argument == "--relative") {
+        tolerance.relative = true;
+        tolerance_given = true;
+      }
+      else if (argument == "--summary") {
+        const auto& format = value_of(arguments, i);
+        if (format == "text")
+          options.summary = summary_format::text;
+        else if (format == "json")
+          options.summary = summary_format::json;
+        else
+          throw std::invalid_argument("Invalid summary format " + format);
+      }
+      else if (argument == "--quantiles") {
+        options.summary_settings.quantiles = parse_quantiles(value_of(arguments, i));
+        summary_given = true;
+      }
+      else if (argument == "--histogram") {
+        options.summary_settings.histogram_bins = std::min<size_t>(parse_count(value_of(arguments, i), argument), 1 << 16);
+        summary_given = true;
+      }
+      else if (argument == "--jit")
+        options.jit = true;
+      else if (argument == "--cache")
+        options.cache = true;
+      else if (argument == "--stats")
+        options.stats_path = value_of(arguments, i);
+      else if (argument == "--serve")
+        options.serve_path = value_of(arguments, i);
+      else if (argument == "--load")
+        options.load_path = value_of(arguments, i);
+      else if (argument == "--clients")
+        options.load_clients = static_cast<unsigned>(std::min<size_t>(parse_count(value_of(arguments, i), argument), 1024));
+      else if (argument == "--requests")
+        options.load_requests = parse_count(value_of(arguments, i), argument);
+      else if (argument == "--values")
+        options.load_values = parse_count(value_of(arguments, i), argument);
+      else if (argument == "--help" || argument == "-h")
+        options.help = true;
+      else
+        throw std::invalid_argument("Unknown option " + argument);
+    }
+    if (domain)
+      options.approximation = approximation_settings{ domain->first, domain->second, tolerance };
+    else if (tolerance_given)
+      throw std::invalid_argument("--tolerance and --relative need --approximate");
+    if (options.approximation && (options.precision != precision::f64 || options.sequence_paths.size() > 1))
+      throw std::invalid_argument("--approximate needs a single sequence in precision f64");
+    if (options.sweep && (input_given || options.sequence_paths.size() > 1 || !options.serve_path.empty() || !options.load_path.empty()))
+      throw std::invalid_argument("--sweep needs a single sequence without --in, --serve and --load");
+    if (summary_given && options.summary == summary_format::none)
+      throw std::invalid_argument("--quantiles and --histogram need --summary");
+    if (options.summary != summary_format::none && (options.precision != precision::f64 || options.sequence_paths.size() > 1
+      || !options.serve_path.empty() || !options.load_path.empty()))
+      throw std::invalid_argument("--summary needs a single sequence in precision f64 without --serve and --load");
+    if (!options.serve_path.empty() && !options.load_path.empty())
+      throw std::invalid_argument("--serve and --load are exclusive");
+    // Native code, caches, statistics, tries and server work on doubles only
+    if (options.precision != precision::f64 && (options.jit || options.cache || !options.stats_path.empty()
+      || options.sequence_paths.size() > 1 || !options.serve_path.empty() || !options.load_path.empty()))
+      throw std::invalid_argument("--precision f32 and f80 need a single sequence without --jit, --cache, --stats, --serve and --load");
+    if (options.sequence_paths.size() > 1) {
+      if (options.cache || !options.stats_path.empty())
+        throw std::invalid_argument("--cache and --stats need a single sequence");
+      if (options.format == value_format::binary && options.output_path == "-")
+        throw std::invalid_argument("Binary results of several sequences need --out file");
+    }
+    return options;
+  }
+
+  std::ostream& dump_command_line_usage(std::ostream& to_stream) {
+    to_stream << "Usage: mathlab [options]" << std::endl;
+    to_stream << "Without options starts interactive mode, with options evaluates input and exits" << std::endl;
+    to_stream << "  --sequence file - sequence to evaluate, sequence.txt by default" << std::endl;
+    to_stream << "    Repeated for several sequences evaluated in one pass, common first blocks are evaluated once;" << std::endl;
+    to_stream << "    text results have a column per sequence, binary results a file per sequence named file.sequence" << std::endl;
+    to_stream << "  --in file - numbers to evaluate, - for standard input (default); gzip or zstd compressed file is decompressed" << std::endl;
+    to_stream << "  --sweep start:stop:step - evaluates start, start + step, ... up to stop instead of input" << std::endl;
+    to_stream << "  --out file - results, - for standard output (default); file with extension .gz or .zst is compressed" << std::endl;
+    to_stream << "  --threads count - number of threads, number of cores by default" << std::endl;
+    to_stream << "  --format text|binary - format of input and output, text by default" << std::endl;
+    to_stream << "  --optimization none|exact|relaxed - how blocks are combined before evaluation, exact by default" << std::endl;
+    to_stream << "  --precision f32|f64|f80 - float, double or long double values, f64 by default;" << std::endl;
+    to_stream << "    binary results are written in this precision, binary input of any precision is converted" << std::endl;
+    to_stream << "  --approximate lower:upper - evaluates numbers in [lower, upper] with piecewise polynomials, others exactly:" << std::endl;
+    to_stream << "    --tolerance error - largest error on verification samples, 1e-9 by default" << std::endl;
+    to_stream << "    --relative - error is relative to magnitude of exact result" << std::endl;
+    to_stream << "  --summary text|json - writes summary of results to output instead of the results:" << std::endl;
+    to_stream << "    count, range, mean, variance, quantiles and histogram from one pass, format selects input format only" << std::endl;
+    to_stream << "    --quantiles q1,q2,... - quantiles in [0, 1] estimated from a sketch, 0.5,0.9,0.99 by default" << std::endl;
+    to_stream << "    --histogram bins - bins of equal width between the smallest and largest finite result, 10 by default" << std::endl;
+    to_stream << "  --jit - evaluates with native code" << std::endl;
+    to_stream << "  --cache - reuses results of repeated numbers, switches off at low hit rate" << std::endl;
+    to_stream << "  --stats file - collects per block statistics and writes them to file in JSON format" << std::endl;
+    to_stream << "  --serve socket - serves evaluation on Unix domain socket until interrupted, input and output are not used" << std::endl;
+    to_stream << "  --load socket - measures latency of server at socket with requests of random numbers:" << std::endl;
+    to_stream << "    --clients count - concurrent clients, 4 by default" << std::endl;
+    to_stream << "    --requests count - requests of each client, 10000 by default" << std::endl;
+    to_stream << "    --values count - numbers in each request, 16 by default" << std::endl;
+    return to_stream;
+  }
+}
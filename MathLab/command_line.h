@@ -0,0 +1,56 @@
+#pragma once
+#include "approximation.h"
+#include "execution_plan.h"
+#include "result_summary.h"
+#include "value_io.h"
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace mathlab {
+
+  enum class value_format { text, binary };
+  // Output of a summary of results written instead of the results, none if results are written
+  enum class summary_format { none, text, json };
+
+  // Options of non-interactive mode, "-" stands for standard input or output
+  struct batch_options {
+    std::string sequence_path = "sequence.txt";
+    // Every --sequence in order, sequence_path is the first one
+    // Several sequences are evaluated together in one pass over input
+    std::vector<std::string> sequence_paths;
+    std::string input_path = "-";
+    // Values of range are evaluated instead of input, nullopt if input is read
+    std::optional<sweep_range> sweep;
+    std::string output_path = "-";
+    unsigned threads;
+    value_format format = value_format::text;
+    optimization_level optimization = optimization_level::exact;
+    // Values are read, evaluated and written in this precision
+    mathlab::precision precision = precision::f64;
+    // Batch evaluation is approximated within tolerance on the domain, nullopt if exact
+    std::optional<approximation_settings> approximation;
+    summary_format summary = summary_format::none;
+    mathlab::summary_settings summary_settings;
+    bool jit = false;
+    bool cache = false;
+    // Statistics in JSON format are written here after evaluation, empty if not collected
+    std::string stats_path;
+    // Serves evaluation on Unix domain socket at this path instead of evaluating input, empty if not served
+    std::string serve_path;
+    // Runs load generator against server at this path, empty if not run
+    std::string load_path;
+    unsigned load_clients = 4;
+    size_t load_requests = 10000;
+    size_t load_values = 16;
+    bool help = false;
+
+    batch_options();
+  };
+
+  // Parses arguments that follow program name
+  // Throws invalid_argument on unknown option or invalid value
+  batch_options parse_command_line(const std::vector<std::string>& arguments);
+  std::ostream& dump_command_line_usage(std::ostream& to_stream);
+}
@@ -0,0 +1,509 @@
+#include "compressed_stream.h"
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#if defined(MATHLAB_HAS_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(MATHLAB_HAS_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace {
+  // Blocks held between a stream and its codec thread, besides the one each of them works on
+  constexpr size_t queue_capacity = 4;
+  // Results are written once, so fast levels keep compression from holding up evaluation
+  constexpr int gzip_level = 1;
+  constexpr int zstd_level = 3;
+
+  const char* name(mathlab::compression type) {
+    switch (type) {
+    case mathlab::compression::gzip: return "gzip";
+    case mathlab::compression::zstd: return "zstd";
+    default: return "none";
+    }
+  }
+
+  [[noreturn]] void throw_unsupported(mathlab::compression type) {
+    if (type == mathlab::compression::none)
+      throw std::invalid_argument("Compression none has no codec");
+    throw std::invalid_argument(std::string("Compression ") + name(type) + " is not supported by this build");
+  }
+
+  // Bounded queue of blocks between a stream and the thread that decompresses or compresses for it
+  class block_queue {
+    std::deque<std::vector<char>> blocks_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    bool closed_ = false;
+    bool abandoned_ = false;
+    std::exception_ptr error_;
+  public:
+    // Waits while queue is full, returns false if consumer abandoned the queue
+    bool push(std::vector<char> block) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [this]() { return blocks_.size() < queue_capacity || abandoned_; });
+      if (abandoned_)
+        return false;
+      blocks_.push_back(std::move(block));
+      changed_.notify_all();
+      return true;
+    }
+
+    // Waits for a block, nullopt after the last one
+    // Rethrows error passed to close after all blocks before it are taken
+    std::optional<std::vector<char>> pop() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [this]() { return !blocks_.empty() || closed_; });
+      if (blocks_.empty()) {
+        if (error_)
+          std::rethrow_exception(error_);
+        return std::nullopt;
+      }
+      auto block = std::move(blocks_.front());
+      blocks_.pop_front();
+      changed_.notify_all();
+      return block;
+    }
+
+    // Producer pushes no more blocks, error if it failed
+    void close(std::exception_ptr error = nullptr) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+      error_ = error;
+      changed_.notify_all();
+    }
+
+    // Consumer takes no more blocks, error if it failed
+    void abandon(std::exception_ptr error = nullptr) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      abandoned_ = true;
+      error_ = error;
+      blocks_.clear();
+      changed_.notify_all();
+    }
+
+    bool failed() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return error_ != nullptr;
+    }
+  };
+
+  // Decompresses from [in, in_end) into [out, out_end), advances in and out
+  class decoder {
+  public:
+    virtual ~decoder() = default;
+    virtual void decode(const char*& in, const char* in_end, char*& out, char* out_end) = 0;
+    // True at the end of a gzip member or zstd frame
+    virtual bool at_end() const = 0;
+  };
+
+  // Compresses from [in, in_end) into [out, out_end), advances in and out
+  // With finish writes the end of compressed data and returns true when it is written completely
+  class encoder {
+  public:
+    virtual ~encoder() = default;
+    virtual bool encode(const char*& in, const char* in_end, char*& out, char* out_end, bool finish) = 0;
+  };
+
+#if defined(MATHLAB_HAS_ZLIB)
+  class gzip_decoder : public decoder {
+    z_stream stream_{};
+    bool at_end_ = false;
+  public:
+    // Window of 15 bits plus 16 accepts gzip header and trailer only
+    gzip_decoder() {
+      if (inflateInit2(&stream_, 15 + 16) != Z_OK)
+        throw std::bad_alloc();
+    }
+    ~gzip_decoder() override { inflateEnd(&stream_); }
+
+    void decode(const char*& in, const char* in_end, char*& out, char* out_end) override {
+      if (at_end_) {
+        if (in == in_end)
+          return;
+        // Next member of concatenated gzip files
+        inflateReset(&stream_);
+        at_end_ = false;
+      }
+      stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+      stream_.avail_in = static_cast<uInt>(in_end - in);
+      stream_.next_out = reinterpret_cast<Bytef*>(out);
+      stream_.avail_out = static_cast<uInt>(out_end - out);
+      const auto result = inflate(&stream_, Z_NO_FLUSH);
+      if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+        throw std::invalid_argument("Invalid gzip data");
+      at_end_ = result == Z_STREAM_END;
+      in = in_end - stream_.avail_in;
+      out = out_end - stream_.avail_out;
+    }
+
+    bool at_end() const override { return at_end_; }
+  };
+
+  class gzip_encoder : public encoder {
+    z_stream stream_{};
+  public:
+    gzip_encoder() {
+      if (deflateInit2(&stream_, gzip_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::bad_alloc();
+    }
+    ~gzip_encoder() override { deflateEnd(&stream_); }
+
+    bool encode(const char*& in, const char* in_end, char*& out, char* out_end, bool finish) override {
+      stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+      stream_.avail_in = static_cast<uInt>(in_end - in);
+      stream_.next_out = reinterpret_cast<Bytef*>(out);
+      stream_.avail_out = static_cast<uInt>(out_end - out);
+      const auto result = deflate(&stream_, finish ? Z_FINISH : Z_NO_FLUSH);
+      if (result == Z_STREAM_ERROR)
+        throw std::system_error(std::make_error_code(std::errc::io_error), "gzip compression");
+      in = in_end - stream_.avail_in;
+      out = out_end - stream_.avail_out;
+      return result == Z_STREAM_END;
+    }
+  };
+#endif
+
+#if defined(MATHLAB_HAS_ZSTD)
+  class zstd_decoder : public decoder {
+    ZSTD_DCtx* context_;
+    bool at_end_ = false;
+  public:
+    zstd_decoder() : context_(ZSTD_createDCtx()) {
+      if (context_ == nullptr)
+        throw std::bad_alloc();
+    }
+    ~zstd_decoder() override { ZSTD_freeDCtx(context_); }
+
+    void decode(const char*& in, const char* in_end, char*& out, char* out_end) override {
+      ZSTD_inBuffer source = { in, static_cast<size_t>(in_end - in), 0 };
+      ZSTD_outBuffer target = { out, static_cast<size_t>(out_end - out), 0 };
+      const auto result = ZSTD_decompressStream(context_, &target, &source);
+      if (ZSTD_isError(result))
+        throw std::invalid_argument(std::string("Invalid zstd data: ") + ZSTD_getErrorName(result));
+      // Zero is returned when a frame is complete, a call without progress would start the next one
+      if (source.pos != 0 || target.pos != 0)
+        at_end_ = result == 0;
+      in += source.pos;
+      out += target.pos;
+    }
+
+    bool at_end() const override { return at_end_; }
+  };
+
+  class zstd_encoder : public encoder {
+    ZSTD_CCtx* context_;
+  public:
+    zstd_encoder() : context_(ZSTD_createCCtx()) {
+      if (context_ == nullptr)
+        throw std::bad_alloc();
+      ZSTD_CCtx_setParameter(context_, ZSTD_c_compressionLevel, zstd_level);
+      // Corrupt data is detected like with the CRC of gzip
+      ZSTD_CCtx_setParameter(context_, ZSTD_c_checksumFlag, 1);
+    }
+    ~zstd_encoder() override { ZSTD_freeCCtx(context_); }
+
+    bool encode(const char*& in, const char* in_end, char*& out, char* out_end, bool finish) override {
+      ZSTD_inBuffer source = { in, static_cast<size_t>(in_end - in), 0 };
+      ZSTD_outBuffer target = { out, static_cast<size_t>(out_end - out), 0 };
+      const auto result = ZSTD_compressStream2(context_, &target, &source, finish ? ZSTD_e_end : ZSTD_e_continue);
+      if (ZSTD_isError(result))
+        throw std::system_error(std::make_error_code(std::errc::io_error), std::string("zstd compression: ") + ZSTD_getErrorName(result));
+      in += source.pos;
+      out += target.pos;
+      return finish && result == 0;
+    }
+  };
+#endif
+
+  std::unique_ptr<decoder> make_decoder(mathlab::compression type) {
+    switch (type) {
+#if defined(MATHLAB_HAS_ZLIB)
+    case mathlab::compression::gzip: return std::make_unique<gzip_decoder>();
+#endif
+#if defined(MATHLAB_HAS_ZSTD)
+    case mathlab::compression::zstd: return std::make_unique<zstd_decoder>();
+#endif
+    default: throw_unsupported(type);
+    }
+  }
+
+  std::unique_ptr<encoder> make_encoder(mathlab::compression type) {
+    switch (type) {
+#if defined(MATHLAB_HAS_ZLIB)
+    case mathlab::compression::gzip: return std::make_unique<gzip_encoder>();
+#endif
+#if defined(MATHLAB_HAS_ZSTD)
+    case mathlab::compression::zstd: return std::make_unique<zstd_encoder>();
+#endif
+    default: throw_unsupported(type);
+    }
+  }
+
+  // Body of decompressing thread, blocks of compression_block_size are pushed as they fill up
+  void decompress(std::istream& input, decoder& decoder, block_queue& queue, mathlab::compression type) {
+    try {
+      std::vector<char> compressed(mathlab::compression_block_size);
+      const char* in = compressed.data();
+      const char* in_end = in;
+      bool input_end = false;
+      std::vector<char> block(mathlab::compression_block_size);
+      char* out = block.data();
+      for (;;) {
+        if (in == in_end && !input_end) {
+          input.read(compressed.data(), static_cast<std::streamsize>(compressed.size()));
+          in = compressed.data();
+          in_end = in + input.gcount();
+          input_end = in == in_end;
+        }
+        const auto in_before = in;
+        const auto out_before = out;
+        decoder.decode(in, in_end, out, block.data() + block.size());
+        if (out == block.data() + block.size()) {
+          if (!queue.push(std::move(block)))
+            return;
+          block = std::vector<char>(mathlab::compression_block_size);
+          out = block.data();
+        }
+        else if (input_end && in == in_before && out == out_before) {
+          break;
+        }
+      }
+      if (input.bad())
+        throw std::system_error(std::make_error_code(std::errc::io_error), "Unable to read compressed input");
+      if (!decoder.at_end())
+        throw std::invalid_argument(std::string("Truncated ") + name(type) + " data");
+      block.resize(static_cast<size_t>(out - block.data()));
+      if (!block.empty() && !queue.push(std::move(block)))
+        return;
+      queue.close();
+    }
+    catch (...) {
+      queue.close(std::current_exception());
+    }
+  }
+
+  // Body of compressing thread, compressed data is written in blocks of compression_block_size
+  void compress(std::ostream& output, encoder& encoder, block_queue& queue) {
+    try {
+      std::vector<char> compressed(mathlab::compression_block_size);
+      char* out = compressed.data();
+      char* const out_end = out + compressed.size();
+      const auto write = [&]() {
+        output.write(compressed.data(), out - compressed.data());
+        out = compressed.data();
+        if (!output)
+          throw std::system_error(std::make_error_code(std::errc::io_error), "Unable to write compressed output");
+      };
+      while (auto block = queue.pop()) {
+        const char* in = block->data();
+        const char* const in_end = in + block->size();
+        while (in != in_end) {
+          encoder.encode(in, in_end, out, out_end, false);
+          if (out == out_end)
+            write();
+        }
+      }
+      const char* none = nullptr;
+      while (!encoder.encode(none, none, out, out_end, true))
+        write();
+      write();
+      if (!output.flush())
+        throw std::system_error(std::make_error_code(std::errc::io_error), "Unable to write compressed output");
+    }
+    catch (...) {
+      queue.abandon(std::current_exception());
+    }
+  }
+}
+
+namespace mathlab {
+
+  compression compression_of_path(const std::filesystem::path& path) {
+    const auto extension = path.extension();
+    if (extension == ".gz")
+      return compression::gzip;
+    if (extension == ".zst")
+      return compression::zstd;
+    return compression::none;
+  }
+
+  compression compression_of_data(const char* data, size_t size) {
+    static const unsigned char gzip_magic[] = { 0x1F, 0x8B };
+    static const unsigned char zstd_magic[] = { 0x28, 0xB5, 0x2F, 0xFD };
+    if (size >= sizeof(gzip_magic) && std::memcmp(data, gzip_magic, sizeof(gzip_magic)) == 0)
+      return compression::gzip;
+    if (size >= sizeof(zstd_magic) && std::memcmp(data, zstd_magic, sizeof(zstd_magic)) == 0)
+      return compression::zstd;
+    return compression::none;
+  }
+
+  compression compression_of_file(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[4];
+    file.read(magic, sizeof(magic));
+    return compression_of_data(magic, static_cast<size_t>(file.gcount()));
+  }
+
+  const char* extension(compression type) {
+    switch (type) {
+    case compression::gzip: return ".gz";
+    case compression::zstd: return ".zst";
+    default: return "";
+    }
+  }
+
+  bool is_supported(compression type) {
+    switch (type) {
+#if defined(MATHLAB_HAS_ZLIB)
+    case compression::gzip: return true;
+#endif
+#if defined(MATHLAB_HAS_ZSTD)
+    case compression::zstd: return true;
+#endif
+    case compression::none: return true;
+    default: return false;
+    }
+  }
+
+  // Get area is the block taken last from the decompressing thread
+  class decompressing_istream::buffer : public std::streambuf {
+    block_queue queue_;
+    std::vector<char> block_;
+    // Position of the first character of block_ in decompressed data
+    off_type block_position_ = 0;
+    bool at_end_ = false;
+    std::unique_ptr<decoder> decoder_;
+    std::thread thread_;
+  public:
+    buffer(std::istream& input, compression type) : decoder_(make_decoder(type)) {
+      thread_ = std::thread([this, &input, type]() { decompress(input, *decoder_, queue_, type); });
+    }
+
+    ~buffer() override {
+      queue_.abandon();
+      thread_.join();
+    }
+  protected:
+    int_type underflow() override {
+      if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+      if (at_end_)
+        return traits_type::eof();
+      auto next = queue_.pop();
+      // The last block stays, so that it can be sought
+      if (!next) {
+        at_end_ = true;
+        return traits_type::eof();
+      }
+      block_position_ += static_cast<off_type>(block_.size());
+      block_ = std::move(*next);
+      setg(block_.data(), block_.data(), block_.data() + block_.size());
+      return traits_type::to_int_type(*gptr());
+    }
+
+    pos_type seekoff(off_type offset, std::ios::seekdir direction, std::ios::openmode which) override {
+      if (direction == std::ios::cur)
+        offset += block_position_ + (gptr() - eback());
+      else if (direction != std::ios::beg)
+        return pos_type(off_type(-1));
+      return seekpos(pos_type(offset), which);
+    }
+
+    pos_type seekpos(pos_type position, std::ios::openmode which) override {
+      const auto offset = off_type(position) - block_position_;
+      if (!(which & std::ios::in) || offset < 0 || offset > static_cast<off_type>(block_.size()))
+        return pos_type(off_type(-1));
+      setg(block_.data(), block_.data() + offset, block_.data() + block_.size());
+      return position;
+    }
+  };
+
+  decompressing_istream::decompressing_istream(std::istream& input, compression type)
+    : std::istream(nullptr), buffer_(std::make_unique<buffer>(input, type)) {
+    rdbuf(buffer_.get());
+    // Errors of decompression reach the reader instead of looking like the end of input
+    exceptions(std::ios::badbit);
+  }
+
+  decompressing_istream::~decompressing_istream() = default;
+
+  // Put area is the block being filled, full blocks are passed to the compressing thread
+  class compressing_ostream::buffer : public std::streambuf {
+    block_queue queue_;
+    std::vector<char> block_;
+    bool finished_ = false;
+    std::unique_ptr<encoder> encoder_;
+    std::thread thread_;
+  public:
+    buffer(std::ostream& output, compression type) : block_(compression_block_size), encoder_(make_encoder(type)) {
+      setp(block_.data(), block_.data() + block_.size());
+      thread_ = std::thread([this, &output]() { compress(output, *encoder_, queue_); });
+    }
+
+    ~buffer() override { finish(); }
+
+    // Returns false if output could not be written
+    bool finish() {
+      if (!finished_) {
+        finished_ = true;
+        push_block();
+        queue_.close();
+        thread_.join();
+        setp(nullptr, nullptr);
+      }
+      return !queue_.failed();
+    }
+  protected:
+    int_type overflow(int_type character) override {
+      if (finished_ || !push_block())
+        return traits_type::eof();
+      if (!traits_type::eq_int_type(character, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(character);
+        pbump(1);
+      }
+      return traits_type::not_eof(character);
+    }
+
+    // Passes written data on without waiting for it to be compressed
+    int sync() override {
+      if (finished_)
+        return queue_.failed() ? -1 : 0;
+      return push_block() ? 0 : -1;
+    }
+  private:
+    bool push_block() {
+      const auto used = static_cast<size_t>(pptr() - pbase());
+      if (used == 0)
+        return !queue_.failed();
+      block_.resize(used);
+      const auto pushed = queue_.push(std::move(block_));
+      block_ = std::vector<char>(compression_block_size);
+      setp(block_.data(), block_.data() + block_.size());
+      return pushed;
+    }
+  };
+
+  compressing_ostream::compressing_ostream(std::ostream& output, compression type)
+    : std::ostream(nullptr), buffer_(std::make_unique<buffer>(output, type)) {
+    rdbuf(buffer_.get());
+  }
+
+  compressing_ostream::~compressing_ostream() = default;
+
+  void compressing_ostream::finish() {
+    if (!buffer_->finish())
+      setstate(std::ios::badbit);
+  }
+}
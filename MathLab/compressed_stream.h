@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <istream>
+#include <memory>
+#include <ostream>
+
+namespace mathlab {
+
+  // Compression of input and output files, gzip with zlib and zstd with libzstd when found at build time
+  enum class compression { none, gzip, zstd };
+
+  // Size of blocks passed between a codec thread and its stream
+  constexpr size_t compression_block_size = 1 << 18;
+
+  // By extension, .gz or .zst
+  compression compression_of_path(const std::filesystem::path& path);
+  // By magic bytes at the start of data
+  compression compression_of_data(const char* data, size_t size);
+  // By magic bytes at the start of file, none if file can not be read
+  compression compression_of_file(const std::filesystem::path& path);
+  // Extension with dot, empty for none
+  const char* extension(compression type);
+  bool is_supported(compression type);
+
+  // Decompressed contents of a compressed stream
+  // Input is read and decompressed on a thread of its own, up to a few blocks ahead of the reader
+  // Concatenated gzip members and zstd frames are read as one stream
+  // Reading throws invalid_argument on data that is not valid or is truncated and system_error if input can not be read
+  // Positions within the block being read can be sought, e.g. back to the start after reading a header
+  class decompressing_istream : public std::istream {
+    class buffer;
+    std::unique_ptr<buffer> buffer_;
+  public:
+    // Throws invalid_argument if type is none or is not supported
+    decompressing_istream(std::istream& input, compression type);
+    ~decompressing_istream();
+  };
+
+  // Compresses written data into output on a thread of its own
+  // Output is complete only after finish, stream goes bad if output can not be written
+  class compressing_ostream : public std::ostream {
+    class buffer;
+    std::unique_ptr<buffer> buffer_;
+  public:
+    // Throws invalid_argument if type is none or is not supported
+    compressing_ostream(std::ostream& output, compression type);
+    // Finishes output if finish was not called
+    ~compressing_ostream();
+
+    // Compresses remaining data and writes the end of compressed data, further writes fail
+    void finish();
+  };
+}
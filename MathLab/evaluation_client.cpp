@@ -0,0 +1,173 @@
+#include "evaluation_client.h"
+#include "binary_io.h"
+#include "evaluation_server.h"
+#include "little_endian.h"
+#include "sequence_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  // Quantile of sorted latencies, nearest rank
+  double quantile(const std::vector<double>& sorted, double q) {
+    if (sorted.empty())
+      return 0.;
+    const auto rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+  }
+}
+
+namespace mathlab {
+
+#if defined(__linux__)
+  evaluation_client::evaluation_client(const std::string& socket_path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+      throw std::system_error(std::make_error_code(std::errc::filename_too_long), socket_path);
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    socket_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket_ < 0 || connect(socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+      const auto error = errno;
+      if (socket_ >= 0)
+        close(socket_);
+      throw std::system_error(error, std::generic_category(), socket_path);
+    }
+  }
+
+  evaluation_client::~evaluation_client() {
+    close(socket_);
+  }
+
+  void evaluation_client::flush() {
+    size_t written = 0;
+    while (written < requests_.size()) {
+      const auto sent = ::send(socket_, requests_.data() + written, requests_.size() - written, MSG_NOSIGNAL);
+      if (sent < 0 && errno == EINTR)
+        continue;
+      if (sent < 0)
+        throw std::system_error(errno, std::generic_category(), "send");
+      written += static_cast<size_t>(sent);
+    }
+    requests_.clear();
+  }
+
+  void evaluation_client::finish_sending() {
+    flush();
+    if (shutdown(socket_, SHUT_WR) != 0)
+      throw std::system_error(errno, std::generic_category(), "shutdown");
+  }
+
+  void evaluation_client::receive_exactly(char* to, size_t size) {
+    while (size > 0) {
+      const auto received = recv(socket_, to, size, 0);
+      if (received < 0 && errno == EINTR)
+        continue;
+      if (received <= 0)
+        throw std::system_error(received == 0 ? ECONNRESET : errno, std::generic_category(), "recv");
+      to += received;
+      size -= static_cast<size_t>(received);
+    }
+  }
+#else
+  evaluation_client::evaluation_client(const std::string&) {
+    throw std::system_error(std::make_error_code(std::errc::not_supported), "Evaluation server needs Linux");
+  }
+
+  evaluation_client::~evaluation_client() = default;
+  void evaluation_client::flush() {}
+  void evaluation_client::finish_sending() {}
+  void evaluation_client::receive_exactly(char*, size_t) {}
+#endif
+
+  void evaluation_client::send(const double* values, size_t count) {
+    if (count > max_request_values)
+      throw std::invalid_argument("Request has more than " + std::to_string(max_request_values) + " values");
+    const auto used = requests_.size();
+    requests_.resize(used + request_header_size + count * sizeof(double));
+    store_little_endian(static_cast<uint32_t>(count), requests_.data() + used);
+    store_binary_values(values, requests_.data() + used + request_header_size, count);
+  }
+
+  size_t evaluation_client::receive(double* results, size_t capacity) {
+    flush();
+    char header[request_header_size];
+    receive_exactly(header, sizeof(header));
+    const auto count = load_little_endian<uint32_t>(header);
+    if (count > capacity)
+      throw std::invalid_argument("Reply has more results than expected");
+    buffer_.resize(count * sizeof(double));
+    receive_exactly(buffer_.data(), buffer_.size());
+    load_binary_values(buffer_.data(), results, count);
+    return count;
+  }
+
+  void evaluation_client::eval_batch(const double* input, double* output, size_t count) {
+    send(input, count);
+    if (receive(output, count) != count)
+      throw std::invalid_argument("Reply has fewer results than values");
+  }
+
+  load_report run_load(const std::string& socket_path, unsigned client_count, size_t requests_per_client, size_t values_per_request) {
+    std::vector<double> latencies;
+    std::mutex mutex;
+    std::exception_ptr failure;
+    const auto start = stats_clock::now();
+    std::vector<std::thread> clients;
+    for (unsigned c = 0; c < client_count; ++c) {
+      clients.emplace_back([&, c]() {
+        try {
+          evaluation_client client(socket_path);
+          std::mt19937_64 random(c);
+          std::uniform_real_distribution<double> distribution(-1000., 1000.);
+          std::vector<double> values(values_per_request);
+          std::vector<double> results(values_per_request);
+          std::vector<double> local;
+          local.reserve(requests_per_client);
+          for (size_t r = 0; r < requests_per_client; ++r) {
+            for (auto& value : values)
+              value = distribution(random);
+            const auto sent = stats_clock::now();
+            client.eval_batch(values.data(), results.data(), values.size());
+            local.push_back(std::chrono::duration<double, std::micro>(stats_clock::now() - sent).count());
+          }
+          std::lock_guard<std::mutex> lock(mutex);
+          latencies.insert(latencies.end(), local.begin(), local.end());
+        }
+        catch (...) {
+          std::lock_guard<std::mutex> lock(mutex);
+          failure = std::current_exception();
+        }
+      });
+    }
+    for (auto& client : clients)
+      client.join();
+    if (failure)
+      std::rethrow_exception(failure);
+
+    load_report report;
+    report.seconds = std::chrono::duration<double>(stats_clock::now() - start).count();
+    report.requests = latencies.size();
+    report.values = latencies.size() * values_per_request;
+    std::sort(latencies.begin(), latencies.end());
+    for (auto latency : latencies)
+      report.mean += latency / static_cast<double>(latencies.size());
+    report.p50 = quantile(latencies, .5);
+    report.p99 = quantile(latencies, .99);
+    report.max = latencies.empty() ? 0. : latencies.back();
+    return report;
+  }
+}
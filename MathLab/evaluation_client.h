@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mathlab {
+
+  // Blocking client of evaluation_server
+  class evaluation_client {
+    int socket_ = -1;
+    // Requests not sent yet
+    std::vector<char> requests_;
+    std::vector<char> buffer_;
+  public:
+    // Throws system_error if server does not accept connection
+    explicit evaluation_client(const std::string& socket_path);
+    ~evaluation_client();
+    evaluation_client(const evaluation_client&) = delete;
+    evaluation_client& operator=(const evaluation_client&) = delete;
+
+    // Adds one request, requests are sent together by the next receive or flush,
+    // so several requests may be sent before their replies are received
+    // Throws invalid_argument if count is over max_request_values
+    void send(const double* values, size_t count);
+    // Throws system_error if connection fails
+    void flush();
+    // Sends added requests and tells the server that no more follow, their replies can still be received
+    // Throws system_error if connection fails
+    void finish_sending();
+    // Sends added requests and receives reply to the oldest request without reply, returns number of results
+    // Throws system_error if connection fails, invalid_argument if reply has more than capacity results
+    size_t receive(double* results, size_t capacity);
+    // Sends request and waits for its reply
+    void eval_batch(const double* input, double* output, size_t count);
+  private:
+    void receive_exactly(char* to, size_t size);
+  };
+
+  // Latency of requests measured by run_load, in microseconds
+  struct load_report {
+    uint64_t requests = 0;
+    uint64_t values = 0;
+    double seconds = 0;
+    double mean = 0;
+    double p50 = 0;
+    double p99 = 0;
+    double max = 0;
+  };
+
+  // Runs client_count clients on their own threads, every client sends requests_per_client requests
+  // of values_per_request random values and waits for each reply before sending the next request
+  // Throws system_error if a client fails
+  load_report run_load(const std::string& socket_path, unsigned client_count, size_t requests_per_client, size_t values_per_request);
+}
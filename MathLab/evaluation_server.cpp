@@ -0,0 +1,307 @@
+#include "evaluation_server.h"
+#include "binary_io.h"
+#include "little_endian.h"
+#include <algorithm>
+#include <system_error>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace mathlab {
+
+#if defined(__linux__)
+  namespace {
+    // Identifiers of epoll events, connections have identifiers from first_connection_id
+    constexpr uint64_t listener_id = 0;
+    constexpr uint64_t wake_id = 1;
+    constexpr uint64_t first_connection_id = 2;
+    constexpr size_t read_size = 1 << 16;
+
+    [[noreturn]] void throw_system_error(const char* what) {
+      throw std::system_error(errno, std::generic_category(), what);
+    }
+  }
+
+  struct evaluation_server::connection {
+    uint64_t id;
+    int socket;
+    // Received bytes of requests that are not complete yet
+    std::vector<char> input;
+    // Replies not written yet, from written onward
+    std::vector<char> output;
+    size_t written = 0;
+    // Requests waiting for evaluation
+    size_t unanswered = 0;
+    // Client shut down sending, the connection is closed once its replies are written
+    bool received_all = false;
+    uint32_t events = EPOLLIN;
+
+    size_t unsent() const { return output.size() - written; }
+  };
+
+  evaluation_server::evaluation_server(const block_sequence& sequence, const std::string& socket_path)
+    : sequence_(sequence), path_(socket_path), next_id_(first_connection_id) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+      throw std::system_error(std::make_error_code(std::errc::filename_too_long), socket_path);
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    listener_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener_ < 0)
+      throw_system_error("socket");
+    unlink(socket_path.c_str());
+    if (bind(listener_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener_, SOMAXCONN) != 0) {
+      const auto error = errno;
+      close(listener_);
+      throw std::system_error(error, std::generic_category(), socket_path);
+    }
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event listener_event = { EPOLLIN, { } };
+    listener_event.data.u64 = listener_id;
+    epoll_event wake_event = { EPOLLIN, { } };
+    wake_event.data.u64 = wake_id;
+    if (epoll_ < 0 || wake_ < 0 || epoll_ctl(epoll_, EPOLL_CTL_ADD, listener_, &listener_event) != 0
+      || epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &wake_event) != 0) {
+      const auto error = errno;
+      close_all();
+      throw std::system_error(error, std::generic_category(), "epoll");
+    }
+  }
+
+  evaluation_server::~evaluation_server() {
+    close_all();
+  }
+
+  void evaluation_server::close_all() {
+    for (auto& pair : connections_)
+      close(pair.second->socket);
+    connections_.clear();
+    for (auto descriptor : { listener_, epoll_, wake_ }) {
+      if (descriptor >= 0)
+        close(descriptor);
+    }
+    listener_ = epoll_ = wake_ = -1;
+    unlink(path_.c_str());
+  }
+
+  void evaluation_server::run() {
+    epoll_event events[64];
+    for (;;) {
+      const auto count = epoll_wait(epoll_, events, 64, -1);
+      if (count < 0 && errno == EINTR)
+        continue;
+      if (count < 0)
+        throw_system_error("epoll_wait");
+      bool stopped = false;
+      for (int i = 0; i < count; ++i) {
+        const auto id = events[i].data.u64;
+        if (id == listener_id) {
+          accept_connections();
+          continue;
+        }
+        if (id == wake_id) {
+          stopped = true;
+          continue;
+        }
+        // Writing may close the connection
+        auto found = connections_.find(id);
+        if (found != connections_.end() && (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)))
+          write_replies(*found->second);
+        found = connections_.find(id);
+        if (found != connections_.end() && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+          read_requests(*found->second);
+        if (pending_values_.size() >= max_batch_values)
+          evaluate_pending();
+      }
+      evaluate_pending();
+      if (stopped)
+        return;
+    }
+  }
+
+  void evaluation_server::stop() {
+    const uint64_t one = 1;
+    // Only write is allowed in a signal handler
+    [[maybe_unused]] const auto written = write(wake_, &one, sizeof(one));
+  }
+
+  bool evaluation_server::is_supported() {
+    return true;
+  }
+
+  void evaluation_server::accept_connections() {
+    for (;;) {
+      const auto socket = accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (socket < 0 && (errno == EINTR || errno == ECONNABORTED))
+        continue;
+      // Connections waiting to be accepted would report the listener readable again at once
+      if (socket < 0 && (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM))
+        watch_listener(false);
+      if (socket < 0)
+        return;
+      const auto id = next_id_++;
+      epoll_event event = { EPOLLIN, { } };
+      event.data.u64 = id;
+      if (epoll_ctl(epoll_, EPOLL_CTL_ADD, socket, &event) != 0) {
+        close(socket);
+        continue;
+      }
+      connections_[id] = std::make_unique<connection>(connection{ id, socket, {}, {}, 0, 0, false, EPOLLIN });
+    }
+  }
+
+  void evaluation_server::watch_listener(bool accepting) {
+    accepting_ = accepting;
+    epoll_event event = { accepting ? uint32_t(EPOLLIN) : 0u, { } };
+    event.data.u64 = listener_id;
+    epoll_ctl(epoll_, EPOLL_CTL_MOD, listener_, &event);
+  }
+
+  // Complete requests are added to pending ones, a connection that sends an invalid request or fails is closed
+  // Reading stops while a batch of values is pending or too many replies wait, the rest stays in the socket
+  void evaluation_server::read_requests(connection& client) {
+    const auto id = client.id;
+    while (!client.received_all && pending_values_.size() < max_batch_values && client.unsent() < max_output_bytes) {
+      const auto used = client.input.size();
+      client.input.resize(used + read_size);
+      const auto received = recv(client.socket, client.input.data() + used, read_size, 0);
+      client.input.resize(used + (received > 0 ? static_cast<size_t>(received) : 0));
+      if (received < 0 && errno == EINTR)
+        continue;
+      if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+      if (received < 0 || !parse_requests(client)) {
+        close_connection(id);
+        return;
+      }
+      client.received_all = received == 0;
+    }
+    if (client.received_all && client.unanswered == 0 && client.unsent() == 0) {
+      close_connection(id);
+      return;
+    }
+    watch(client);
+  }
+
+  // Moves complete requests from input to pending ones, false if a request is invalid
+  bool evaluation_server::parse_requests(connection& client) {
+    size_t position = 0;
+    while (client.input.size() - position >= request_header_size) {
+      const auto count = load_little_endian<uint32_t>(client.input.data() + position);
+      if (count > max_request_values)
+        return false;
+      const auto size = request_header_size + count * sizeof(double);
+      if (client.input.size() - position < size)
+        break;
+      const auto used = pending_values_.size();
+      pending_values_.resize(used + count);
+      load_binary_values(client.input.data() + position + request_header_size, pending_values_.data() + used, count);
+      pending_requests_.emplace_back(client.id, count);
+      ++client.unanswered;
+      position += size;
+    }
+    client.input.erase(client.input.begin(), client.input.begin() + static_cast<std::ptrdiff_t>(position));
+    return true;
+  }
+
+  // Sockets are read unless the client shut down sending or too many replies wait, and written while replies wait
+  void evaluation_server::watch(connection& client) {
+    const auto events = (!client.received_all && client.unsent() < max_output_bytes ? uint32_t(EPOLLIN) : 0u)
+      | (client.unsent() > 0 ? uint32_t(EPOLLOUT) : 0u);
+    if (events == client.events)
+      return;
+    client.events = events;
+    epoll_event event = { events, { } };
+    event.data.u64 = client.id;
+    epoll_ctl(epoll_, EPOLL_CTL_MOD, client.socket, &event);
+  }
+
+  // A connection that fails, or whose client shut down sending and got all replies, is closed
+  void evaluation_server::write_replies(connection& client) {
+    while (client.unsent() > 0) {
+      const auto sent = send(client.socket, client.output.data() + client.written, client.unsent(), MSG_NOSIGNAL);
+      if (sent < 0 && errno == EINTR)
+        continue;
+      if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        close_connection(client.id);
+        return;
+      }
+      if (sent < 0)
+        break;
+      client.written += static_cast<size_t>(sent);
+    }
+    if (client.unsent() == 0) {
+      client.output.clear();
+      client.written = 0;
+      if (client.received_all && client.unanswered == 0) {
+        close_connection(client.id);
+        return;
+      }
+    }
+    watch(client);
+  }
+
+  void evaluation_server::evaluate_pending() {
+    if (pending_requests_.empty())
+      return;
+    for (size_t start = 0; start < pending_values_.size(); start += max_batch_values) {
+      const auto count = std::min(max_batch_values, pending_values_.size() - start);
+      sequence_.eval_batch(pending_values_.data() + start, pending_values_.data() + start, count);
+      batches_.fetch_add(1, std::memory_order_relaxed);
+    }
+    requests_.fetch_add(pending_requests_.size(), std::memory_order_relaxed);
+    const double* results = pending_values_.data();
+    for (auto& request : pending_requests_) {
+      const auto found = connections_.find(request.first);
+      if (found != connections_.end()) {
+        --found->second->unanswered;
+        auto& output = found->second->output;
+        const auto used = output.size();
+        output.resize(used + request_header_size + request.second * sizeof(double));
+        store_little_endian(static_cast<uint32_t>(request.second), output.data() + used);
+        store_binary_values(results, output.data() + used + request_header_size, request.second);
+      }
+      results += request.second;
+    }
+    // Connections closed meanwhile have no replies
+    for (auto& request : pending_requests_) {
+      const auto found = connections_.find(request.first);
+      if (found != connections_.end() && found->second->unsent() > 0)
+        write_replies(*found->second);
+    }
+    pending_values_.clear();
+    pending_requests_.clear();
+  }
+
+  void evaluation_server::close_connection(uint64_t id) {
+    const auto found = connections_.find(id);
+    if (found == connections_.end())
+      return;
+    epoll_ctl(epoll_, EPOLL_CTL_DEL, found->second->socket, nullptr);
+    close(found->second->socket);
+    connections_.erase(found);
+    if (!accepting_)
+      watch_listener(true);
+  }
+#else
+  struct evaluation_server::connection {};
+
+  evaluation_server::evaluation_server(const block_sequence& sequence, const std::string& socket_path) : sequence_(sequence), path_(socket_path) {
+    throw std::system_error(std::make_error_code(std::errc::not_supported), "Evaluation server needs Linux");
+  }
+
+  evaluation_server::~evaluation_server() = default;
+  void evaluation_server::close_all() {}
+  void evaluation_server::run() {}
+  void evaluation_server::stop() {}
+  bool evaluation_server::is_supported() { return false; }
+#endif
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "block_sequence.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mathlab {
+
+  // Protocol of evaluation server over a Unix domain socket, all numbers little-endian:
+  //  request - uint32 number of values, float64 values
+  //  reply - uint32 number of results, float64 results in the order of values
+  // Replies on a connection come in the order of requests, so a client may send several requests before reading replies
+  constexpr size_t request_header_size = 4;
+  constexpr size_t max_request_values = 1 << 20;
+
+  // Serves evaluation of a sequence on one thread, waiting for all connections with epoll
+  // Requests read in one round of events are evaluated together, with one eval_batch per max_batch_values values,
+  // and replies are written without blocking as sockets accept them
+  // A connection is not read while max_output_bytes of its replies wait for the client or a batch of values waits
+  // for evaluation, so buffers stay bounded; requests sent before the client shuts down sending are still answered
+  // Sequence must not change while server runs
+  class evaluation_server {
+    struct connection;
+    const block_sequence& sequence_;
+    std::string path_;
+    int listener_ = -1;
+    int epoll_ = -1;
+    // Wakes the loop to stop it
+    int wake_ = -1;
+    // Listener is not watched while the process is out of descriptors, until a connection closes
+    bool accepting_ = true;
+    uint64_t next_id_ = 0;
+    std::map<uint64_t, std::unique_ptr<connection>> connections_;
+    // Values of requests waiting for evaluation and their connections and number of values
+    std::vector<double> pending_values_;
+    std::vector<std::pair<uint64_t, size_t>> pending_requests_;
+    std::atomic<uint64_t> requests_{ 0 };
+    std::atomic<uint64_t> batches_{ 0 };
+  public:
+    static constexpr size_t max_batch_values = 1 << 16;
+    static constexpr size_t max_output_bytes = 1 << 22;
+
+    // Listens on socket at path, an existing socket file is replaced
+    // Throws system_error if socket can not be created
+    evaluation_server(const block_sequence& sequence, const std::string& socket_path);
+    // Closes connections and removes socket file
+    ~evaluation_server();
+    evaluation_server(const evaluation_server&) = delete;
+    evaluation_server& operator=(const evaluation_server&) = delete;
+
+    // Serves until stop is called, throws system_error if waiting for events fails
+    void run();
+    // May be called from other threads and from signal handlers
+    void stop();
+    uint64_t requests() const { return requests_.load(std::memory_order_relaxed); }
+    // Calls of eval_batch, fewer than requests when requests are coalesced
+    uint64_t batches() const { return batches_.load(std::memory_order_relaxed); }
+    // False where Unix domain sockets and epoll are not available
+    static bool is_supported();
+  private:
+    void accept_connections();
+    void read_requests(connection& client);
+    void write_replies(connection& client);
+    bool parse_requests(connection& client);
+    void watch(connection& client);
+    void watch_listener(bool accepting);
+    void evaluate_pending();
+    void close_connection(uint64_t id);
+    void close_all();
+  };
+}
@@ -0,0 +1,388 @@
+#include "execution_plan.h"
+#include "simd_kernels.h"
+#include <limits>
+#include <utility>
+
+namespace {
+  using mathlab::optimization_level;
+  using mathlab::plan_operation;
+  using mathlab::plan_step;
+  using mathlab::value_range;
+
+  const auto infinity = std::numeric_limits<double>::infinity();
+
+  bool is_negative_zero(double value) {
+    return value == 0. && std::signbit(value);
+  }
+
+  // Steps that return their input unchanged, including -0 and NaN
+  bool is_no_op(const plan_step& step) {
+    const auto& c = step.constants;
+    switch (step.operation) {
+    case plan_operation::add: return is_negative_zero(c[0]);
+    case plan_operation::multiply: return c[0] == 1.;
+    case plan_operation::power: return c[0] == 1.;
+    case plan_operation::limit: return c[0] == -infinity && c[1] == infinity;
+    default: return false;
+    }
+  }
+
+  bool is_well_formed_limit(const plan_step& step) {
+    return step.operation == plan_operation::limit && step.constants[0] <= step.constants[1];
+  }
+
+  // limit [c, d] after limit [a, b] equals limit [clamp(a, c, d), clamp(b, c, d)] when the ranges overlap
+  bool can_merge_limits(const plan_step& first, const plan_step& second) {
+    return is_well_formed_limit(first) && is_well_formed_limit(second)
+      && first.constants[0] <= second.constants[1] && second.constants[0] <= first.constants[1];
+  }
+
+  // Limit that can not change any value in range, NaN passes through a limit unchanged
+  // Bounds must differ from the range, clamp of -0 to [+0, upper] may return either zero
+  bool covers(const plan_step& limit, const value_range& range) {
+    return is_well_formed_limit(limit)
+      && (limit.constants[0] == -infinity || limit.constants[0] < range.lower)
+      && (limit.constants[1] == infinity || range.upper < limit.constants[1]);
+  }
+
+  bool is_table(const plan_step& step) {
+    return step.operation == plan_operation::condition || step.operation == plan_operation::select;
+  }
+
+  plan_step to_select(const plan_step& step) {
+    if (step.operation == plan_operation::condition)
+      return { plan_operation::select, { step.constants[0], -1., 0., 1. } };
+    return step;
+  }
+
+  bool is_empty(const value_range& range) {
+    return !(range.lower <= range.upper);
+  }
+
+  // Smallest range that holds both ranges
+  value_range join(const value_range& first, const value_range& second) {
+    return { std::min(first.lower, second.lower), std::max(first.upper, second.upper), first.nan || second.nan };
+  }
+
+  // Addition and multiplication round monotonically, so bounds map to bounds
+  value_range add(const value_range& range, double constant) {
+    if (!std::isfinite(constant))
+      return value_range::all();
+    if (is_empty(range))
+      return range;
+    return { range.lower + constant, range.upper + constant, range.nan };
+  }
+
+  value_range multiply(const value_range& range, double constant) {
+    if (!std::isfinite(constant))
+      return value_range::all();
+    if (is_empty(range))
+      return range;
+    if (constant == 0.)
+      return { 0., 0., range.nan || range.lower == -infinity || range.upper == infinity };
+    if (constant > 0.)
+      return { range.lower * constant, range.upper * constant, range.nan };
+    return { range.upper * constant, range.lower * constant, range.nan };
+  }
+
+  value_range square(const value_range& range) {
+    if (is_empty(range))
+      return range;
+    if (range.lower >= 0.)
+      return { range.lower * range.lower, range.upper * range.upper, range.nan };
+    if (range.upper <= 0.)
+      return { range.upper * range.upper, range.lower * range.lower, range.nan };
+    return { 0., std::max(range.lower * range.lower, range.upper * range.upper), range.nan };
+  }
+
+  // std::pow is within an ulp of the exact power and kernels that multiply repeatedly within a few,
+  // so bounds of powers are moved away from the range by far more than either
+  double widen(double bound, double direction) {
+    if (!std::isfinite(bound))
+      return bound;
+    return bound + direction * (std::fabs(bound) * std::ldexp(1., -40) + std::numeric_limits<double>::min());
+  }
+
+  // Powers of magnitudes in [lower, upper], 0 <= lower <= upper, exact powers are monotonic there
+  value_range magnitude_power(double lower, double upper, double exponent) {
+    auto first = std::pow(lower, exponent);
+    auto second = std::pow(upper, exponent);
+    if (exponent < 0.)
+      std::swap(first, second);
+    return { std::max(0., widen(first, -1.)), widen(second, 1.), false };
+  }
+
+  // Negative inputs are powers of their magnitudes, negated for odd exponents and NaN for exponents that are not integers
+  value_range raise(const value_range& range, double exponent) {
+    if (!std::isfinite(exponent))
+      return value_range::all();
+    if (exponent == 0.)
+      return value_range::of(1.);
+    auto result = value_range::of(std::numeric_limits<double>::quiet_NaN());
+    result.nan = range.nan;
+    if (is_empty(range))
+      return result;
+    if (range.upper >= 0.)
+      result = join(result, magnitude_power(std::max(range.lower, 0.), range.upper, exponent));
+    // Zero in range may be -0, whose odd negative powers are -infinity
+    if (range.lower <= 0.) {
+      const auto magnitudes = magnitude_power(std::max(-range.upper, 0.), -range.lower, exponent);
+      if (exponent != std::floor(exponent))
+        result.nan = result.nan || range.lower < 0.;
+      else if (std::fmod(exponent, 2.) == 0.)
+        result = join(result, magnitudes);
+      else
+        result = join(result, { -magnitudes.upper, -magnitudes.lower, false });
+    }
+    return result;
+  }
+
+  value_range select(const value_range& range, const double* constants) {
+    const auto c = constants[0];
+    const auto any = !is_empty(range);
+    auto result = value_range::of(std::numeric_limits<double>::quiet_NaN());
+    result.nan = false;
+    if (any && range.lower < c)
+      result = join(result, value_range::of(constants[1]));
+    if (any && range.lower <= c && c <= range.upper)
+      result = join(result, value_range::of(constants[2]));
+    // NaN input or constant compares as greater
+    if (range.nan || (any && !(range.upper <= c)))
+      result = join(result, value_range::of(constants[3]));
+    return result;
+  }
+
+  bool is_affine(const plan_step& step) {
+    return step.operation == plan_operation::add || step.operation == plan_operation::multiply || step.operation == plan_operation::multiply_add;
+  }
+
+  // Factor and addend of input * factor + addend, -0 is the addend that keeps the sign of zero
+  std::pair<double, double> to_affine(const plan_step& step) {
+    switch (step.operation) {
+    case plan_operation::add: return { 1., step.constants[0] };
+    case plan_operation::multiply: return { step.constants[0], -0. };
+    default: return { step.constants[0], step.constants[1] };
+    }
+  }
+
+  plan_step from_affine(double factor, double addend) {
+    if (factor == 1.)
+      return { plan_operation::add, { addend } };
+    if (is_negative_zero(addend))
+      return { plan_operation::multiply, { factor } };
+    return { plan_operation::multiply_add, { factor, addend } };
+  }
+}
+
+namespace mathlab {
+
+  value_range value_range::all() {
+    return { -infinity, infinity, true };
+  }
+
+  value_range value_range::of(double value) {
+    if (std::isnan(value))
+      return { infinity, -infinity, true };
+    return { value, value, false };
+  }
+
+  bool value_range::is_single_value() const {
+    return !nan && lower == upper && lower != 0.;
+  }
+
+  value_range output_range(const plan_step& step, const value_range& input) {
+    const auto& c = step.constants;
+    switch (step.operation) {
+    case plan_operation::add: return add(input, c[0]);
+    case plan_operation::multiply: return multiply(input, c[0]);
+    case plan_operation::multiply_add: return add(multiply(input, c[0]), c[1]);
+    case plan_operation::square: return square(input);
+    case plan_operation::power: return raise(input, c[0]);
+    case plan_operation::condition: return select(input, to_select(step).constants);
+    case plan_operation::select: return select(input, c);
+    case plan_operation::limit:
+      if (!is_well_formed_limit(step))
+        return value_range::all();
+      if (is_empty(input))
+        return input;
+      return { std::clamp(input.lower, c[0], c[1]), std::clamp(input.upper, c[0], c[1]), input.nan };
+    case plan_operation::constant: return value_range::of(c[0]);
+    default: return value_range::all();
+    }
+  }
+
+  execution_plan::execution_plan(const std::vector<block_description>& blocks, optimization_level level) : level_(level) {
+    for (auto& block : blocks)
+      append(block);
+  }
+
+  void execution_plan::append(const block_description& block) {
+    const auto first = block.constants[0];
+    const auto second = block.constants[1];
+    switch (block.kind) {
+    case block_kind::identity:
+      break;
+    case block_kind::addition:
+      append(plan_step{ plan_operation::add, { first } });
+      break;
+    case block_kind::multiplication:
+      append(plan_step{ plan_operation::multiply, { first } });
+      break;
+    case block_kind::power:
+      append(plan_step{ plan_operation::power, { first } });
+      break;
+    case block_kind::condition:
+      append(plan_step{ plan_operation::condition, { first } });
+      break;
+    case block_kind::limit:
+      append(plan_step{ plan_operation::limit, { first, second } });
+      break;
+    }
+  }
+
+  void execution_plan::append(const plan_step& step) {
+    if (level_ == optimization_level::none) {
+      steps_.push_back(step);
+      return;
+    }
+    if (is_no_op(step))
+      return;
+
+    auto reduced = step;
+    if (step.operation == plan_operation::power) {
+      const auto exponent = step.constants[0];
+      if (exponent == 0.)
+        reduced = { plan_operation::constant, { 1. } };
+      else if (level_ == optimization_level::relaxed && exponent == 2.)
+        reduced = { plan_operation::square, {} };
+      else if (level_ == optimization_level::relaxed && exponent == -1.)
+        reduced = { plan_operation::reciprocal, {} };
+      else if (level_ == optimization_level::relaxed && exponent > 2. && exponent <= 16. && exponent == std::floor(exponent))
+        reduced = { plan_operation::integer_power, { exponent } };
+    }
+    if (covers(reduced, range_))
+      return;
+    const auto range = output_range(reduced, range_);
+    if (range.is_single_value())
+      reduced = { plan_operation::constant, { range.lower } };
+    // Steps before a constant can not change the result
+    if (reduced.operation == plan_operation::constant)
+      steps_.clear();
+
+    if (!steps_.empty()) {
+      auto& last = steps_.back();
+      if (last.operation == plan_operation::constant) {
+        last.constants[0] = eval_step(reduced, last.constants[0]);
+        range_ = value_range::of(last.constants[0]);
+        return;
+      }
+      range_ = range;
+      // eval_step computes every step like its batch kernel, so folded results are those of evaluation
+      if (is_table(last)) {
+        last = to_select(last);
+        for (size_t i = 1; i < 4; ++i)
+          last.constants[i] = eval_step(reduced, last.constants[i]);
+        return;
+      }
+      if (reduced.operation == plan_operation::limit && can_merge_limits(last, reduced)) {
+        const auto lower = std::clamp(last.constants[0], reduced.constants[0], reduced.constants[1]);
+        const auto upper = std::clamp(last.constants[1], reduced.constants[0], reduced.constants[1]);
+        last = { plan_operation::limit, { lower, upper } };
+        return;
+      }
+      if (level_ == optimization_level::relaxed && is_affine(last) && is_affine(reduced)) {
+        const auto previous = to_affine(last);
+        const auto next = to_affine(reduced);
+        last = from_affine(previous.first * next.first, previous.second * next.first + next.second);
+        if (is_no_op(last))
+          steps_.pop_back();
+        return;
+      }
+    }
+    range_ = range;
+    steps_.push_back(reduced);
+  }
+
+  template<typename TValue>
+  TValue execution_plan::eval(TValue input) const {
+    for (auto& step : steps_)
+      input = eval_step(step, input);
+    return input;
+  }
+
+  template<typename TValue>
+  void execution_plan::eval_batch(const TValue* input, TValue* output, size_t count) const {
+    for (size_t offset = 0; offset < count; offset += tile_size) {
+      const auto tile = std::min(tile_size, count - offset);
+      const TValue* from = input + offset;
+      TValue* to = output + offset;
+      if (steps_.empty())
+        simd::kernels_of<TValue>().copy(from, to, tile);
+      // First step reads the input tile, the rest work in place on the output tile
+      for (auto& step : steps_) {
+        eval_step_batch(step, from, to, tile);
+        from = to;
+      }
+    }
+  }
+
+  template<typename TValue>
+  TValue eval_step(const plan_step& step, TValue input) {
+    const TValue c[4] = { static_cast<TValue>(step.constants[0]), static_cast<TValue>(step.constants[1]),
+      static_cast<TValue>(step.constants[2]), static_cast<TValue>(step.constants[3]) };
+    switch (step.operation) {
+    case plan_operation::add: return input + c[0];
+    case plan_operation::multiply: return input * c[0];
+    case plan_operation::multiply_add: return input * c[0] + c[1];
+    case plan_operation::power: return std::pow(input, c[0]);
+    case plan_operation::square: return input * input;
+    case plan_operation::reciprocal: return TValue(1) / input;
+    case plan_operation::integer_power: return simd::integer_power(input, static_cast<unsigned>(step.constants[0]));
+    case plan_operation::condition: return input < c[0] ? TValue(-1) : TValue(input == c[0] ? 0 : 1);
+    case plan_operation::select: return input < c[0] ? c[1] : (input == c[0] ? c[2] : c[3]);
+    case plan_operation::limit: return std::clamp(input, c[0], c[1]);
+    case plan_operation::constant: return c[0];
+    }
+    return input;
+  }
+
+  template<typename TValue>
+  void eval_step_batch(const plan_step& step, const TValue* input, TValue* output, size_t count) {
+    const auto& kernels = simd::kernels_of<TValue>();
+    const TValue c[4] = { static_cast<TValue>(step.constants[0]), static_cast<TValue>(step.constants[1]),
+      static_cast<TValue>(step.constants[2]), static_cast<TValue>(step.constants[3]) };
+    switch (step.operation) {
+    case plan_operation::add: kernels.add(input, output, count, c[0]); break;
+    case plan_operation::multiply: kernels.multiply(input, output, count, c[0]); break;
+    case plan_operation::multiply_add: kernels.multiply_add(input, output, count, c[0], c[1]); break;
+    case plan_operation::power: kernels.power(input, output, count, c[0]); break;
+    // Plain loops are vectorized by the compiler
+    case plan_operation::square:
+      for (size_t i = 0; i < count; ++i)
+        output[i] = input[i] * input[i];
+      break;
+    case plan_operation::reciprocal:
+      for (size_t i = 0; i < count; ++i)
+        output[i] = TValue(1) / input[i];
+      break;
+    case plan_operation::integer_power: kernels.integer_power(input, output, count, static_cast<unsigned>(step.constants[0])); break;
+    case plan_operation::condition: kernels.condition(input, output, count, c[0]); break;
+    case plan_operation::select: kernels.select(input, output, count, c[0], c[1], c[2], c[3]); break;
+    case plan_operation::limit: kernels.limit(input, output, count, c[0], c[1]); break;
+    case plan_operation::constant: std::fill(output, output + count, c[0]); break;
+    }
+  }
+
+  template float execution_plan::eval(float input) const;
+  template double execution_plan::eval(double input) const;
+  template long double execution_plan::eval(long double input) const;
+  template void execution_plan::eval_batch(const float* input, float* output, size_t count) const;
+  template void execution_plan::eval_batch(const double* input, double* output, size_t count) const;
+  template void execution_plan::eval_batch(const long double* input, long double* output, size_t count) const;
+  template float eval_step(const plan_step& step, float input);
+  template double eval_step(const plan_step& step, double input);
+  template long double eval_step(const plan_step& step, long double input);
+  template void eval_step_batch(const plan_step& step, const float* input, float* output, size_t count);
+  template void eval_step_batch(const plan_step& step, const double* input, double* output, size_t count);
+  template void eval_step_batch(const plan_step& step, const long double* input, long double* output, size_t count);
+}
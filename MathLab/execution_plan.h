@@ -0,0 +1,79 @@
+#pragma once
+#include "blocks.h"
+#include <vector>
+
+namespace mathlab {
+
+  // How much an execution plan may differ from the blocks it was built from
+  //  none - one step per block, identity blocks are skipped
+  //  exact - drops identity and no-op blocks, merges nested limits and folds constants; results are bit-identical
+  //          Tracks the range of values after every step, drops limits that can not change them,
+  //          replaces steps whose output is one value with a constant and folds steps after
+  //          a condition into a table of its three results; powers are evaluated by std::pow, also in batch
+  //  relaxed - additionally folds runs of addition and multiplication into one multiply-add,
+  //            replaces power 2 and -1 with multiplication and division, which std::pow does not always match,
+  //            and evaluates integer powers up to 16 by repeated squaring; results may differ in the last bits
+  enum class optimization_level { none, exact, relaxed };
+
+  enum class plan_operation { add, multiply, multiply_add, power, square, reciprocal, integer_power, condition, select, limit, constant };
+
+  // One step of an execution plan, unused constants are zero
+  //  multiply_add - input * constants[0] + constants[1]
+  //  select - constants[1], [2] or [3] where input is less than, equal to or greater than constants[0], NaN counts as greater
+  //  constant - returns constants[0] regardless of input
+  struct plan_step {
+    plan_operation operation;
+    double constants[4];
+  };
+
+  // Values that a step may output: an interval, empty when lower > upper, and whether NaN is possible
+  // Zeros of both signs are in the interval when lower or upper is zero
+  struct value_range {
+    double lower;
+    double upper;
+    bool nan;
+
+    // Any value including NaN
+    static value_range all();
+    static value_range of(double value);
+    // True if every value in range has the same bits
+    bool is_single_value() const;
+  };
+
+  // Range of outputs of step for inputs in given range
+  value_range output_range(const plan_step& step, const value_range& input);
+
+  // Flat list of steps that evaluates a sequence of blocks without virtual calls
+  // Steps are built and optimized in double, evaluation in float or long double rounds constants to the value type;
+  // only plans without optimization evaluate other types like the blocks do
+  class execution_plan {
+    std::vector<plan_step> steps_;
+    optimization_level level_;
+    // Range of values after the last step
+    value_range range_ = value_range::all();
+  public:
+    execution_plan(const std::vector<block_description>& blocks, optimization_level level);
+    // Defined for float, double and long double
+    template<typename TValue>
+    TValue eval(TValue input) const;
+    // Evaluates count values from input into output, step by step over tiles of tile_size values
+    // Input and output may point to the same buffer
+    template<typename TValue>
+    void eval_batch(const TValue* input, TValue* output, size_t count) const;
+    const std::vector<plan_step>& steps() const { return steps_; }
+    // Range of results for any input, computed when optimized
+    const value_range& range() const { return range_; }
+    // Number of values evaluated by each step before moving to the next one (16 KB fits in L1 cache)
+    static constexpr size_t tile_size = 2048;
+  private:
+    void append(const block_description& block);
+    void append(const plan_step& step);
+  };
+
+  // Evaluates one step for one value, defined for float, double and long double
+  template<typename TValue>
+  TValue eval_step(const plan_step& step, TValue input);
+  // Evaluates one step for count values with vector kernels, input and output may point to the same buffer
+  template<typename TValue>
+  void eval_step_batch(const plan_step& step, const TValue* input, TValue* output, size_t count);
+}
@@ -1,19 +1,118 @@
 #include "factory.h"
+#include <algorithm>
+#include <numeric>
 
 namespace mathlab
 {
-  template <typename TBlock>
-  void factory::register_block(const std::string& type_name) {
-    types_[type_name] = TBlock::template create_from_stream<TBlock>;
-  }
-
   std::unique_ptr<block> factory::create(const std::string& type_name, std::istream& stream) const {
     const auto found = types_.find(type_name);
     if (found != types_.end())
-      return found->second(stream);
+      return found->second.from_stream(stream);
     return std::unique_ptr<block>();
   }
 
+  std::unique_ptr<block> factory::create(std::string_view type_name, std::string_view constants) const {
+    if (slots_.empty())
+      return nullptr;
+    const auto& slot = slots_[slot_of(type_name)];
+    if (slot.from_text == nullptr || slot.type_name != type_name)
+      return nullptr;
+    return slot.from_text(constants);
+  }
+
+  factory::type_id factory::find_type(std::string_view type_name) const {
+    if (slots_.empty())
+      return no_type;
+    const auto& slot = slots_[slot_of(type_name)];
+    return slot.type_name == type_name ? slot.type : no_type;
+  }
+
+  std::optional<compact_block> factory::create_compact(std::string_view type_name, std::string_view constants) const {
+    if (slots_.empty())
+      return std::nullopt;
+    const auto& slot = slots_[slot_of(type_name)];
+    if (slot.parse_constants == nullptr || slot.type_name != type_name)
+      return std::nullopt;
+    compact_block block = { interned_[slot.type].kind, slot.type, {} };
+    if (!slot.parse_constants(constants, block.constants))
+      return std::nullopt;
+    return block;
+  }
+
+  compact_block factory::create_compact(type_id type, const double* constants) const {
+    compact_block block = { interned_[type].kind, type, {} };
+    std::copy(constants, constants + constant_count(block.kind), block.constants);
+    return block;
+  }
+
+  // Buckets of about two names in a table of at least twice the names, the largest buckets are placed first while
+  // most slots are free; a bucket of k names fits with probability above 2^-k per seed, so seeds are tried until one
+  // fits and the table is doubled in the unlikely case that max_seed_tries seeds do not
+  void factory::index_types() {
+    size_t size = 1;
+    while (size < types_.size() * 2)
+      size *= 2;
+    const auto bucket_count = std::max<size_t>(1, size / 4);
+    using type_entry = const std::pair<const std::string, creators>*;
+    std::vector<std::vector<type_entry>> buckets(bucket_count);
+    for (auto& type : types_)
+      buckets[hash_of(type.first, 0) & (bucket_count - 1)].push_back(&type);
+    std::vector<size_t> order(bucket_count);
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&](size_t first, size_t second) { return buckets[first].size() > buckets[second].size(); });
+    for (;; size *= 2) {
+      std::vector<bool> used(size);
+      std::vector<size_t> placed;
+      bucket_seeds_.assign(bucket_count, 0);
+      bool fits = true;
+      for (auto bucket : order) {
+        const auto& names = buckets[bucket];
+        // Empty buckets come last
+        if (names.empty())
+          break;
+        bool found = false;
+        for (uint64_t seed = 1; !found && seed <= max_seed_tries; ++seed) {
+          placed.clear();
+          for (auto type : names) {
+            const auto slot = hash_of(type->first, seed) & (size - 1);
+            if (used[slot] || std::find(placed.begin(), placed.end(), slot) != placed.end())
+              break;
+            placed.push_back(slot);
+          }
+          found = placed.size() == names.size();
+          if (found)
+            bucket_seeds_[bucket] = seed;
+        }
+        fits = found;
+        if (!fits)
+          break;
+        for (auto slot : placed)
+          used[slot] = true;
+      }
+      if (!fits)
+        continue;
+      slots_.assign(size, slot());
+      for (auto& type : types_) {
+        slots_[slot_of(type.first)] = {
+          type.first, type.second.from_text, type.second.parse_constants, type.second.type };
+      }
+      return;
+    }
+  }
+
+  size_t factory::slot_of(std::string_view type_name) const {
+    const auto seed = bucket_seeds_[hash_of(type_name, 0) & (bucket_seeds_.size() - 1)];
+    return hash_of(type_name, seed) & (slots_.size() - 1);
+  }
+
+  // FNV-1a starting from seed
+  uint64_t factory::hash_of(std::string_view type_name, uint64_t seed) {
+    auto hash = 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull);
+    for (auto character : type_name)
+      hash = (hash ^ static_cast<unsigned char>(character)) * 1099511628211ull;
+    return hash ^ (hash >> 32);
+  }
+
   std::ostream& factory::dump_registered(std::ostream& to_stream) {
     for (auto pair : types_)
       to_stream << pair.first << ' ';
@@ -21,12 +120,11 @@ namespace mathlab
   }
 
   void register_all_blocks(factory& factory) {
-    factory.register_block<identity>("identity");
-    factory.register_block<addition>("addition");
-    factory.register_block<multiplication>("multiplication");
-    factory.register_block<power>("power");
-    factory.register_block<condition>("condition");
-    factory.register_block<addition>("addition");
-    factory.register_block<limit>("limit");
-  }
-}
+    factory.register_block<identity>(identity::type_name);
+    factory.register_block<addition>(addition::type_name);
+    factory.register_block<multiplication>(multiplication::type_name);
+    factory.register_block<power>(power::type_name);
+    factory.register_block<condition>(condition::type_name);
+    factory.register_block<limit>(limit::type_name);
+  }
+}
\ No newline at end of file
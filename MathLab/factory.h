@@ -1,20 +1,98 @@
 #pragma once
 #include "blocks.h"
+#include <cstdint>
+#include <deque>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <map>
 #include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 
 namespace mathlab
 {
   struct factory {
+    // Registering a name again replaces its block, which must be of the same kind as compact blocks keep the kind
+    // Throws invalid_argument if name is registered with a block of another kind
     template<typename TBlock> void register_block(const std::string& type_name);
     // Returns nullptr if block with given type is not registered
     // Throws invalid_argument if block is known but input stream does not contain expected number of constants
     std::unique_ptr<block> create(const std::string& type_name, std::istream& stream) const;
+    // Same without streams and exceptions, constants are whitespace separated text after type name
+    // Returns nullptr if block with given type is not registered or text does not start with expected constants
+    std::unique_ptr<block> create(std::string_view type_name, std::string_view constants) const;
     std::ostream& dump_registered(std::ostream &to_stream);
+
+    // Type names are interned: types are numbered in the order of their first registration, and compact blocks
+    // store the number instead of the name
+    using type_id = uint32_t;
+    static constexpr type_id no_type = ~type_id(0);
+    // Returns no_type if type is not registered
+    type_id find_type(std::string_view type_name) const;
+    // Stays valid while types are registered
+    const std::string& type_name(type_id type) const { return interned_[type].name; }
+    // Block of registered type with constants parsed from whitespace separated text after type name, like create,
+    // without allocating a block
+    // Returns nullopt if block with given type is not registered or text does not start with expected constants
+    std::optional<compact_block> create_compact(std::string_view type_name, std::string_view constants) const;
+    // Block of registered type with constants in the order listed by block_description, unused constants are dropped
+    compact_block create_compact(type_id type, const double* constants) const;
   private:
-    std::map<std::string, std::function<std::unique_ptr<block>(std::istream&)>> types_;
+    using text_creator = std::unique_ptr<block>(*)(std::string_view);
+    using constants_parser = bool(*)(std::string_view text, double* values);
+    struct creators {
+      std::function<std::unique_ptr<block>(std::istream&)> from_stream;
+      text_creator from_text;
+      constants_parser parse_constants;
+      type_id type;
+    };
+    struct slot {
+      std::string type_name;
+      text_creator from_text = nullptr;
+      constants_parser parse_constants = nullptr;
+      type_id type = no_type;
+    };
+    struct interned_type {
+      std::string name;
+      block_kind kind;
+    };
+    std::map<std::string, creators> types_;
+    // Registered types by number, deque keeps names in place while types are added
+    std::deque<interned_type> interned_;
+    // Perfect hash of registered names by hash and displace: names are grouped into buckets by their hash with seed 0,
+    // and every bucket has the seed that puts each of its names in its own slot; rebuilt by every registration
+    std::vector<slot> slots_;
+    std::vector<uint64_t> bucket_seeds_;
+    // Seeds tried for one bucket before the table is doubled
+    static constexpr uint64_t max_seed_tries = 1 << 12;
+
+    void index_types();
+    // Slot of registered name, any slot for other names
+    size_t slot_of(std::string_view type_name) const;
+    static uint64_t hash_of(std::string_view type_name, uint64_t seed);
   };
 
+  // Defined in header so that blocks can be registered from any translation unit
+  template<typename TBlock>
+  void factory::register_block(const std::string& type_name) {
+    // Kind of a type is the kind of any of its blocks
+    const double zeros[2] = {};
+    const auto kind = TBlock::template create_from_values<TBlock>(zeros)->describe().kind;
+    const auto found = types_.find(type_name);
+    const auto type = found != types_.end() ? found->second.type : static_cast<type_id>(interned_.size());
+    if (found != types_.end() && interned_[type].kind != kind)
+      throw std::invalid_argument("Block " + type_name + " is registered with another kind");
+    if (found == types_.end())
+      interned_.push_back({ type_name, kind });
+    types_[type_name] = {
+      TBlock::template create_from_stream<TBlock>,
+      [](std::string_view constants) -> std::unique_ptr<block> { return TBlock::template create_from_text<TBlock>(constants); },
+      TBlock::parse_constants,
+      type };
+    index_types();
+  }
+
   void register_all_blocks(factory& factory);
 }
\ No newline at end of file
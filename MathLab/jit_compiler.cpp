@@ -0,0 +1,438 @@
+#include "jit_compiler.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(MATHLAB_SIMD_X86)
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+namespace {
+  using mathlab::plan_operation;
+  using mathlab::plan_step;
+
+  // Packed double instructions of 0F opcode map, all with 66 prefix
+  enum opcode : uint8_t {
+    movupd = 0x10, movapd = 0x28, andpd = 0x54, andnpd = 0x55, orpd = 0x56, xorpd = 0x57,
+    addpd = 0x58, mulpd = 0x59, minpd = 0x5D, divpd = 0x5E, maxpd = 0x5F, cmppd = 0xC2
+  };
+
+  // Predicates of cmppd
+  enum comparison : uint8_t { equal = 0, less = 1 };
+
+  // Source operand of a vector instruction, a register or an entry of the constant pool
+  struct operand {
+    bool is_constant;
+    unsigned index;
+  };
+
+  operand reg(unsigned index) {
+    return { false, index };
+  }
+
+  // Steps that run in native loops, the rest is evaluated by kernels between the loops
+  bool is_native(const plan_step& step) {
+    switch (step.operation) {
+    case plan_operation::power:
+    case plan_operation::integer_power:
+      return false;
+    case plan_operation::limit:
+      return step.constants[0] <= step.constants[1];
+    default:
+      return true;
+    }
+  }
+
+  // Emits native functions into one buffer followed by a pool of constants, each broadcast to 32 bytes
+  // Every function is void(const double* input, double* output, size_t count) for count divisible by width(),
+  // input, output and count are kept in rax, r10 and r11; only registers 0 to 7 are used
+  // Win64 preserves xmm6 and xmm7 across calls, they are saved in the home space the caller reserves above the return
+  // address, so that the stack pointer stays as it is and the functions need no unwind data
+  class assembler {
+    struct fixup {
+      size_t at;
+      size_t instruction_end;
+      unsigned constant;
+    };
+
+    bool avx_;
+    std::vector<uint8_t> code_;
+    std::vector<double> constants_;
+    std::vector<fixup> fixups_;
+
+  public:
+    static constexpr size_t constant_size = 32;
+    // Vectors evaluated together by the main loop, their independent chains of steps hide latency of each step
+    // Vector i is in register i, its scratch register is lanes + i
+    static constexpr unsigned lanes = 4;
+
+    explicit assembler(bool avx) : avx_(avx) {}
+
+    size_t width() const { return avx_ ? 4 : 2; }
+    bool empty() const { return code_.empty(); }
+
+    operand constant(double value) {
+      for (size_t i = 0; i < constants_.size(); ++i) {
+        if (std::memcmp(&constants_[i], &value, sizeof(double)) == 0)
+          return { true, static_cast<unsigned>(i) };
+      }
+      constants_.push_back(value);
+      return { true, static_cast<unsigned>(constants_.size() - 1) };
+    }
+
+    // Returns offset of the function in code
+    size_t begin_function() {
+      const auto entry = code_.size();
+#if defined(_WIN32)
+      emit({ 0x48, 0x89, 0xC8, 0x49, 0x89, 0xD2, 0x4D, 0x89, 0xC3 }); // mov rax, rcx; mov r10, rdx; mov r11, r8
+      emit({ 0xF3, 0x0F, 0x7F, 0x74, 0x24, 0x08 }); // movdqu [rsp + 8], xmm6
+      emit({ 0xF3, 0x0F, 0x7F, 0x7C, 0x24, 0x18 }); // movdqu [rsp + 24], xmm7
+#else
+      emit({ 0x48, 0x89, 0xF8, 0x49, 0x89, 0xF2, 0x49, 0x89, 0xD3 }); // mov rax, rdi; mov r10, rsi; mov r11, rdx
+#endif
+      return entry;
+    }
+
+    // Loop that evaluates vector_count vectors per iteration while at least that many remain
+    // body() emits the steps for registers 0 to vector_count - 1
+    template<typename TBody>
+    void loop(unsigned vector_count, TBody body) {
+      const auto values = static_cast<uint32_t>(vector_count * width());
+      const auto vector_bytes = static_cast<uint8_t>(width() * sizeof(double));
+      emit({ 0x49, 0x81, 0xFB }); // cmp r11, values
+      emit32(static_cast<int32_t>(values));
+      emit({ 0x0F, 0x82 }); // jb skip
+      const auto skip_jump = code_.size();
+      emit32(0);
+      const auto loop_start = code_.size();
+      for (unsigned i = 0; i < vector_count; ++i) {
+        const auto modrm = static_cast<uint8_t>(0x40 | (i << 3));
+        if (avx_)
+          emit({ 0xC5, 0xFD, 0x10, modrm, static_cast<uint8_t>(i * vector_bytes) }); // vmovupd ymm(i), [rax + offset]
+        else
+          emit({ 0x66, 0x0F, 0x10, modrm, static_cast<uint8_t>(i * vector_bytes) }); // movupd xmm(i), [rax + offset]
+      }
+      body();
+      for (unsigned i = 0; i < vector_count; ++i) {
+        const auto modrm = static_cast<uint8_t>(0x40 | (i << 3) | 0x2);
+        if (avx_)
+          emit({ 0xC4, 0xC1, 0x7D, 0x11, modrm, static_cast<uint8_t>(i * vector_bytes) }); // vmovupd [r10 + offset], ymm(i)
+        else
+          emit({ 0x66, 0x41, 0x0F, 0x11, modrm, static_cast<uint8_t>(i * vector_bytes) }); // movupd [r10 + offset], xmm(i)
+      }
+      emit({ 0x48, 0x05 }); // add rax, bytes
+      emit32(static_cast<int32_t>(values * sizeof(double)));
+      emit({ 0x49, 0x81, 0xC2 }); // add r10, bytes
+      emit32(static_cast<int32_t>(values * sizeof(double)));
+      emit({ 0x49, 0x81, 0xEB }); // sub r11, values
+      emit32(static_cast<int32_t>(values));
+      emit({ 0x49, 0x81, 0xFB }); // cmp r11, values
+      emit32(static_cast<int32_t>(values));
+      emit({ 0x0F, 0x83 }); // jae loop
+      emit32(static_cast<int32_t>(loop_start) - static_cast<int32_t>(code_.size() + 4));
+      patch32(skip_jump, static_cast<int32_t>(code_.size() - (skip_jump + 4)));
+    }
+
+    void end_function() {
+      if (avx_)
+        emit({ 0xC5, 0xF8, 0x77 }); // vzeroupper
+#if defined(_WIN32)
+      // After vzeroupper, so that legacy SSE loads do not follow dirty upper halves
+      emit({ 0xF3, 0x0F, 0x6F, 0x74, 0x24, 0x08 }); // movdqu xmm6, [rsp + 8]
+      emit({ 0xF3, 0x0F, 0x6F, 0x7C, 0x24, 0x18 }); // movdqu xmm7, [rsp + 24]
+#endif
+      emit({ 0xC3 }); // ret
+    }
+
+    // destination = first op second
+    // Legacy SSE encoding has two operands, first is copied to destination when they differ,
+    // so second must not be the destination register in that case
+    void binary(opcode code, unsigned destination, unsigned first, operand second) {
+      if (!avx_ && destination != first)
+        move(destination, first);
+      encode(code, destination, avx_ ? first : 0, second, false, 0);
+    }
+
+    // destination = first predicate second ? all ones : zero
+    void compare(comparison predicate, unsigned destination, unsigned first, operand second) {
+      if (!avx_ && destination != first)
+        move(destination, first);
+      encode(cmppd, destination, avx_ ? first : 0, second, true, predicate);
+    }
+
+    void load(unsigned destination, operand source) {
+      encode(movupd, destination, 0, source, false, 0);
+    }
+
+    void move(unsigned destination, unsigned source) {
+      encode(movapd, destination, 0, reg(source), false, 0);
+    }
+
+    // Code followed by the constant pool aligned to 32 bytes
+    std::vector<uint8_t> finish() {
+      const auto pool = (code_.size() + constant_size - 1) / constant_size * constant_size;
+      for (auto& entry : fixups_)
+        patch32(entry.at, static_cast<int32_t>(pool + entry.constant * constant_size - entry.instruction_end));
+      auto result = code_;
+      result.resize(pool, 0xCC); // int3
+      for (auto value : constants_) {
+        for (size_t i = 0; i < constant_size / sizeof(double); ++i) {
+          uint8_t bytes[sizeof(double)];
+          std::memcpy(bytes, &value, sizeof(double));
+          result.insert(result.end(), bytes, bytes + sizeof(double));
+        }
+      }
+      return result;
+    }
+
+  private:
+    // AVX uses two byte VEX prefix with 256-bit length, vvvv holds the first source register (0 when unused)
+    // Constants are addressed relative to rip
+    void encode(uint8_t code, unsigned destination, unsigned vvvv, operand source, bool has_immediate, uint8_t immediate) {
+      if (avx_)
+        emit({ 0xC5, static_cast<uint8_t>(0x80 | ((~vvvv & 0xFu) << 3) | 0x4 | 0x1), code });
+      else
+        emit({ 0x66, 0x0F, code });
+      if (source.is_constant) {
+        emit({ static_cast<uint8_t>(0x05 | (destination << 3)) });
+        fixups_.push_back({ code_.size(), code_.size() + 4 + (has_immediate ? 1 : 0), source.index });
+        emit32(0);
+      }
+      else {
+        emit({ static_cast<uint8_t>(0xC0 | (destination << 3) | source.index) });
+      }
+      if (has_immediate)
+        emit({ immediate });
+    }
+
+    void emit(std::initializer_list<uint8_t> bytes) {
+      code_.insert(code_.end(), bytes);
+    }
+
+    void emit32(int32_t value) {
+      uint8_t bytes[4];
+      std::memcpy(bytes, &value, 4);
+      code_.insert(code_.end(), bytes, bytes + 4);
+    }
+
+    void patch32(size_t at, int32_t value) {
+      std::memcpy(code_.data() + at, &value, 4);
+    }
+  };
+
+  // Same results as the vector kernels of the step, for vectors in registers 0 to vector_count - 1
+  void emit_step(assembler& code, const plan_step& step, unsigned vector_count) {
+    const auto& c = step.constants;
+    for (unsigned value = 0; value < vector_count; ++value) {
+      const auto scratch = assembler::lanes + value;
+      switch (step.operation) {
+      case plan_operation::add:
+        code.binary(addpd, value, value, code.constant(c[0]));
+        break;
+      case plan_operation::multiply:
+        code.binary(mulpd, value, value, code.constant(c[0]));
+        break;
+      case plan_operation::multiply_add:
+        code.binary(mulpd, value, value, code.constant(c[0]));
+        code.binary(addpd, value, value, code.constant(c[1]));
+        break;
+      case plan_operation::square:
+        code.binary(mulpd, value, value, reg(value));
+        break;
+      case plan_operation::reciprocal:
+        code.load(scratch, code.constant(1.));
+        code.binary(divpd, scratch, scratch, reg(value));
+        code.move(value, scratch);
+        break;
+      case plan_operation::condition:
+        // -1 where less, 0 where equal, 1 otherwise including NaN
+        code.compare(less, scratch, value, code.constant(c[0]));
+        code.compare(equal, value, value, code.constant(c[0]));
+        code.binary(orpd, value, value, reg(scratch));
+        code.binary(andnpd, value, value, code.constant(1.));
+        code.binary(andpd, scratch, scratch, code.constant(-1.));
+        code.binary(orpd, value, value, reg(scratch));
+        break;
+      case plan_operation::select: {
+        // Masks of less and equal never overlap, so the result is
+        // above ^ (equal mask & (equal ^ above)) ^ (less mask & (below ^ above)), exact for any bits including NaN
+        const auto bits_xor = [](double first, double second) {
+          uint64_t a, b;
+          std::memcpy(&a, &first, sizeof(a));
+          std::memcpy(&b, &second, sizeof(b));
+          a ^= b;
+          double result;
+          std::memcpy(&result, &a, sizeof(result));
+          return result;
+        };
+        code.compare(equal, scratch, value, code.constant(c[0]));
+        code.binary(andpd, scratch, scratch, code.constant(bits_xor(c[2], c[3])));
+        code.compare(less, value, value, code.constant(c[0]));
+        code.binary(andpd, value, value, code.constant(bits_xor(c[1], c[3])));
+        code.binary(xorpd, value, value, reg(scratch));
+        code.binary(xorpd, value, value, code.constant(c[3]));
+        break;
+      }
+      case plan_operation::limit:
+        // min(upper, max(lower, value)) keeps NaN and the sign of zero like std::clamp
+        code.load(scratch, code.constant(c[0]));
+        code.binary(maxpd, scratch, scratch, reg(value));
+        code.load(value, code.constant(c[1]));
+        code.binary(minpd, value, value, reg(scratch));
+        break;
+      case plan_operation::constant:
+        code.load(value, code.constant(c[0]));
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  // Function that runs steps over 4 vectors at a time and then over the remaining vectors one by one
+  size_t emit_function(assembler& code, const std::vector<plan_step>& steps) {
+    const auto entry = code.begin_function();
+    for (auto vector_count : { assembler::lanes, 1u }) {
+      code.loop(vector_count, [&]() {
+        for (auto& step : steps)
+          emit_step(code, step, vector_count);
+      });
+    }
+    code.end_function();
+    return entry;
+  }
+
+  // Copies code into memory that is writable only until it becomes executable
+  void* allocate_executable(const std::vector<uint8_t>& code) {
+#if !defined(MATHLAB_SIMD_X86)
+    return nullptr;
+#elif defined(_WIN32)
+    auto memory = VirtualAlloc(nullptr, code.size(), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (memory == nullptr)
+      return nullptr;
+    std::memcpy(memory, code.data(), code.size());
+    DWORD previous;
+    if (!VirtualProtect(memory, code.size(), PAGE_EXECUTE_READ, &previous)) {
+      VirtualFree(memory, 0, MEM_RELEASE);
+      return nullptr;
+    }
+    FlushInstructionCache(GetCurrentProcess(), memory, code.size());
+    return memory;
+#else
+    auto memory = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+      return nullptr;
+    std::memcpy(memory, code.data(), code.size());
+    if (mprotect(memory, code.size(), PROT_READ | PROT_EXEC) != 0) {
+      munmap(memory, code.size());
+      return nullptr;
+    }
+    return memory;
+#endif
+  }
+
+  void free_executable(void* memory, size_t size) {
+#if !defined(MATHLAB_SIMD_X86)
+    (void)memory;
+    (void)size;
+#elif defined(_WIN32)
+    (void)size;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, size);
+#endif
+  }
+}
+
+namespace mathlab {
+
+  std::unique_ptr<jit_program> jit_program::compile(const execution_plan& plan) {
+    const auto set = simd::is_supported(simd::instruction_set::avx2) ? simd::instruction_set::avx2 : simd::instruction_set::sse2;
+    return compile(plan, set);
+  }
+
+  std::unique_ptr<jit_program> jit_program::compile(const execution_plan& plan, simd::instruction_set set) {
+#if defined(MATHLAB_SIMD_X86)
+    if ((set != simd::instruction_set::sse2 && set != simd::instruction_set::avx2) || !simd::is_supported(set))
+      return nullptr;
+    const auto avx = set == simd::instruction_set::avx2;
+    assembler code(avx);
+    std::unique_ptr<jit_program> program(new jit_program(set, code.width()));
+    // Stage index and offset of its function in code, function pointers are known once code is executable
+    std::vector<std::pair<size_t, size_t>> entries;
+    std::vector<plan_step> native;
+    const auto end_native = [&]() {
+      if (native.empty())
+        return;
+      entries.emplace_back(program->stages_.size(), emit_function(code, native));
+      program->stages_.push_back({ nullptr, native.front() });
+      program->native_steps_ += native.size();
+      native.clear();
+    };
+    for (auto& step : plan.steps()) {
+      if (is_native(step)) {
+        native.push_back(step);
+        continue;
+      }
+      end_native();
+      program->stages_.push_back({ nullptr, step });
+    }
+    end_native();
+
+    if (!code.empty()) {
+      const auto bytes = code.finish();
+      program->code_ = allocate_executable(bytes);
+      if (program->code_ == nullptr)
+        return nullptr;
+      program->code_size_ = bytes.size();
+      for (auto& entry : entries)
+        program->stages_[entry.first].function = reinterpret_cast<native_function>(static_cast<uint8_t*>(program->code_) + entry.second);
+    }
+    return program;
+#else
+    (void)plan;
+    (void)set;
+    return nullptr;
+#endif
+  }
+
+  jit_program::~jit_program() {
+    if (code_ != nullptr)
+      free_executable(code_, code_size_);
+  }
+
+  void jit_program::eval_batch(const double* input, double* output, size_t count) const {
+    for (size_t offset = 0; offset < count; offset += execution_plan::tile_size) {
+      const auto tile = std::min(execution_plan::tile_size, count - offset);
+      const double* from = input + offset;
+      double* to = output + offset;
+      if (stages_.empty())
+        simd::kernels().copy(from, to, tile);
+      for (auto& stage : stages_) {
+        if (stage.function != nullptr)
+          run(stage.function, from, to, tile);
+        else
+          eval_step_batch(stage.step, from, to, tile);
+        from = to;
+      }
+    }
+  }
+
+  void jit_program::run(native_function function, const double* input, double* output, size_t count) const {
+    const auto full = count - count % width_;
+    function(input, output, full);
+    if (full == count)
+      return;
+    // Tail is padded to one vector
+    double tail[4] = {};
+    std::copy(input + full, input + count, tail);
+    function(tail, tail, width_);
+    std::copy(tail, tail + (count - full), output + full);
+  }
+}
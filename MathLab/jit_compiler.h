@@ -0,0 +1,51 @@
+#pragma once
+#include "execution_plan.h"
+#include "simd_kernels.h"
+#include <memory>
+#include <vector>
+
+namespace mathlab {
+
+  // Native x86-64 code compiled from an execution plan
+  // Runs of steps are compiled into one loop that keeps each value in a register (AVX when supported, otherwise SSE2),
+  // power steps between those loops call the vector power kernel
+  // Results are bit-identical to execution_plan::eval_batch
+  class jit_program {
+  public:
+    using native_function = void (*)(const double* input, double* output, size_t count);
+
+    // Returns nullptr if native code can not be generated on this platform
+    static std::unique_ptr<jit_program> compile(const execution_plan& plan);
+    // Instruction set is sse2 or avx2 (only AVX instructions are used)
+    // Returns nullptr if the instruction set is not supported by running CPU
+    static std::unique_ptr<jit_program> compile(const execution_plan& plan, simd::instruction_set set);
+
+    ~jit_program();
+    jit_program(const jit_program&) = delete;
+    jit_program& operator=(const jit_program&) = delete;
+
+    // Input and output may point to the same buffer
+    void eval_batch(const double* input, double* output, size_t count) const;
+    simd::instruction_set instruction_set() const { return set_; }
+    // Number of steps of the plan that run as native code
+    size_t native_steps() const { return native_steps_; }
+
+  private:
+    // Either a native loop over consecutive steps or one step evaluated by kernels
+    struct stage {
+      native_function function;
+      plan_step step;
+    };
+
+    jit_program(simd::instruction_set set, size_t width) : set_(set), width_(width) {}
+    void run(native_function function, const double* input, double* output, size_t count) const;
+
+    simd::instruction_set set_;
+    // Number of values per vector register
+    size_t width_;
+    size_t native_steps_ = 0;
+    std::vector<stage> stages_;
+    void* code_ = nullptr;
+    size_t code_size_ = 0;
+  };
+}
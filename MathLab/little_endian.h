@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace mathlab {
+
+  // Helpers of binary file formats, which store numbers little-endian on every host
+
+  inline bool is_little_endian() {
+    const uint16_t one = 1;
+    char first;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+  }
+
+  template<typename T>
+  void store_little_endian(T value, char* to) {
+    for (size_t i = 0; i < sizeof(T); ++i)
+      to[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+  }
+
+  template<typename T>
+  T load_little_endian(const char* from) {
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+      value |= static_cast<T>(static_cast<unsigned char>(from[i])) << (8 * i);
+    return value;
+  }
+}
@@ -0,0 +1,76 @@
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mathlab {
+
+#if defined(_WIN32)
+  mapped_file::mapped_file(const std::filesystem::path& path) {
+    auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      return;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+      CloseHandle(file);
+      return;
+    }
+    if (size.QuadPart == 0) {
+      open_ = true;
+    }
+    else {
+      auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping != nullptr) {
+        data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        size_ = static_cast<size_t>(size.QuadPart);
+        open_ = data_ != nullptr;
+        // View keeps the mapping alive
+        CloseHandle(mapping);
+      }
+    }
+    CloseHandle(file);
+  }
+
+  mapped_file::~mapped_file() {
+    if (data_ != nullptr)
+      UnmapViewOfFile(data_);
+  }
+#else
+  mapped_file::mapped_file(const std::filesystem::path& path) {
+    const auto file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+      return;
+    struct stat status;
+    if (fstat(file, &status) != 0) {
+      close(file);
+      return;
+    }
+    if (status.st_size == 0) {
+      open_ = true;
+    }
+    else {
+      auto memory = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+      if (memory != MAP_FAILED) {
+        madvise(memory, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(memory);
+        size_ = static_cast<size_t>(status.st_size);
+        open_ = true;
+      }
+    }
+    // Mapping stays valid after file is closed
+    close(file);
+  }
+
+  mapped_file::~mapped_file() {
+    if (data_ != nullptr)
+      munmap(const_cast<char*>(data_), size_);
+  }
+#endif
+}
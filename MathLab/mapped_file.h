@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+
+namespace mathlab {
+
+  // Read-only memory mapping of a whole file
+  class mapped_file {
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool open_ = false;
+  public:
+    explicit mapped_file(const std::filesystem::path& path);
+    ~mapped_file();
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    // False if file does not exist or can not be mapped
+    bool is_open() const { return open_; }
+    // nullptr for empty file
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+  };
+}
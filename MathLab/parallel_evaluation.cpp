@@ -0,0 +1,502 @@
+#include "parallel_evaluation.h"
+#include "binary_io.h"
+#include "thread_pool.h"
+#include "value_io.h"
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+  // Parses, evaluates and formats one chunk of text, returns the text and number of values
+  template<typename TValue>
+  std::pair<std::string, size_t> evaluate_chunk(const mathlab::sequence_version& sequence, const char* first, const char* last) {
+    std::string text;
+    size_t evaluated = 0;
+    std::vector<TValue> values(mathlab::sequence_version::tile_size);
+    mathlab::text_reader reader(first, last);
+    while (auto count = reader.read(values.data(), values.size())) {
+      sequence.eval_batch(values.data(), values.data(), count);
+      evaluated += count;
+      auto used = text.size();
+      text.resize(used + count * mathlab::max_formatted_size);
+      auto to = &text[used];
+      for (size_t i = 0; i < count; ++i)
+        to = mathlab::format_value(values[i], to);
+      text.resize(static_cast<size_t>(to - text.data()));
+    }
+    return std::make_pair(std::move(text), evaluated);
+  }
+
+  // Same for all sequences of a trie, one line per value with results separated by spaces
+  std::pair<std::string, size_t> evaluate_chunk(const mathlab::sequence_trie& sequences, const char* first, const char* last) {
+    std::string text;
+    size_t evaluated = 0;
+    const auto columns = sequences.sequence_count();
+    std::vector<double> values(mathlab::sequence_trie::tile_size);
+    std::vector<double> results(columns * values.size());
+    std::vector<double*> outputs(columns);
+    for (size_t column = 0; column < columns; ++column)
+      outputs[column] = results.data() + column * values.size();
+    mathlab::text_reader reader(first, last);
+    while (auto count = reader.read(values.data(), values.size())) {
+      sequences.eval_batch(values.data(), outputs.data(), count);
+      evaluated += count;
+      auto used = text.size();
+      text.resize(used + count * columns * mathlab::max_formatted_size);
+      auto to = &text[used];
+      for (size_t i = 0; i < count; ++i) {
+        for (size_t column = 0; column < columns; ++column) {
+          to = mathlab::format_value(outputs[column][i], to);
+          if (column + 1 < columns)
+            to[-1] = ' ';
+        }
+      }
+      text.resize(static_cast<size_t>(to - text.data()));
+    }
+    return std::make_pair(std::move(text), evaluated);
+  }
+
+  // Results of all sequences of a trie for count values
+  struct column_results {
+    std::vector<std::vector<double>> columns;
+    size_t count;
+  };
+
+  column_results evaluate_columns(const mathlab::sequence_trie& sequences, const double* input, size_t count) {
+    column_results results = { std::vector<std::vector<double>>(sequences.sequence_count(), std::vector<double>(count)), count };
+    std::vector<double*> outputs;
+    for (auto& column : results.columns)
+      outputs.push_back(column.data());
+    sequences.eval_batch(input, outputs.data(), count);
+    return results;
+  }
+
+  // Splits range into chunks of chunk_values values, evaluate_chunk(first, count) returns results of a chunk
+  // and write(results) writes them in the order of range
+  template<typename TEvaluate, typename TWrite>
+  void evaluate_range_chunks(const mathlab::sweep_range& range, unsigned thread_count, size_t chunk_values,
+    const TEvaluate& evaluate_chunk, const TWrite& write) {
+    // First index and count of values in chunk
+    using chunk = std::pair<size_t, size_t>;
+    size_t offset = 0;
+    mathlab::run_ordered(thread_count,
+      [&]() -> std::optional<chunk> {
+        if (offset == range.count)
+          return std::nullopt;
+        const auto begin = offset;
+        offset += std::min(chunk_values, range.count - offset);
+        return chunk(begin, offset - begin);
+      },
+      [&](chunk values) { return evaluate_chunk(values.first, values.second); },
+      write);
+  }
+
+  // Splits text in memory into chunks of about chunk_size bytes that end at whitespace,
+  // evaluate_chunk(first, last) returns results of a chunk and consume(results) takes them in the order of text
+  template<typename TEvaluate, typename TConsume>
+  void evaluate_text_chunks(const char* first, const char* last,
+    unsigned thread_count, size_t chunk_size, const TEvaluate& evaluate_chunk, const TConsume& consume) {
+    using chunk = std::pair<const char*, const char*>;
+    auto position = first;
+    mathlab::run_ordered(thread_count,
+      [&]() -> std::optional<chunk> {
+        if (position == last)
+          return std::nullopt;
+        const auto begin = position;
+        position = std::find_if(begin + std::min<size_t>(chunk_size, static_cast<size_t>(last - begin)), last, mathlab::is_separator);
+        return chunk(begin, position);
+      },
+      [&](chunk text) { return evaluate_chunk(text.first, text.second); },
+      consume);
+  }
+
+  // Same for chunks read from stream, at most 2 * thread_count chunks are held in memory
+  template<typename TEvaluate, typename TConsume>
+  void evaluate_text_chunks(std::istream& input,
+    unsigned thread_count, size_t chunk_size, const TEvaluate& evaluate_chunk, const TConsume& consume) {
+    // Text after the last whitespace of a chunk is carried to the next one
+    std::vector<char> carry;
+    mathlab::run_ordered(thread_count,
+      [&]() -> std::optional<std::vector<char>> {
+        auto text = std::move(carry);
+        carry.clear();
+        auto cut = std::string::npos;
+        while (input && cut == std::string::npos) {
+          const auto used = text.size();
+          text.resize(used + chunk_size);
+          input.read(text.data() + used, static_cast<std::streamsize>(chunk_size));
+          text.resize(used + static_cast<size_t>(input.gcount()));
+          const auto last_space = std::find_if(text.rbegin(), text.rend() - used, mathlab::is_separator);
+          if (input && last_space != text.rend() - used)
+            cut = static_cast<size_t>(last_space.base() - text.begin());
+        }
+        if (cut != std::string::npos) {
+          carry.assign(text.begin() + cut, text.end());
+          text.resize(cut);
+        }
+        if (text.empty())
+          return std::nullopt;
+        return text;
+      },
+      [&](std::vector<char> text) { return evaluate_chunk(text.data(), text.data() + text.size()); },
+      consume);
+  }
+
+  // Consumer of evaluate_text_chunks that writes text of results to output and counts values
+  class text_chunk_writer {
+    std::ostream& output_;
+    size_t& evaluated_;
+  public:
+    text_chunk_writer(std::ostream& output, size_t& evaluated) : output_(output), evaluated_(evaluated) {}
+    void operator()(const std::pair<std::string, size_t>& text) const {
+      output_.write(text.first.data(), static_cast<std::streamsize>(text.first.size()));
+      evaluated_ += text.second;
+    }
+  };
+
+  // Parses and evaluates one chunk of text into a summary of its results
+  mathlab::result_summary summarize_chunk(const mathlab::sequence_version& sequence, const char* first, const char* last) {
+    mathlab::result_summary summary;
+    std::vector<double> values(mathlab::sequence_version::tile_size);
+    mathlab::text_reader reader(first, last);
+    while (auto count = reader.read(values.data(), values.size())) {
+      sequence.eval_batch(values.data(), values.data(), count);
+      summary.add(values.data(), count);
+    }
+    return summary;
+  }
+
+  // Evaluates count binary values in tiles into a summary, in place when they are aligned, little-endian doubles
+  mathlab::result_summary summarize_binary_chunk(const mathlab::sequence_version& sequence, const char* data, mathlab::precision type, size_t count) {
+    mathlab::result_summary summary;
+    std::vector<double> values(std::min(count, mathlab::sequence_version::tile_size));
+    const auto in_place = mathlab::binary_values_in_place<double>(data, type);
+    for (size_t offset = 0; offset < count; offset += values.size()) {
+      const auto tile = std::min(values.size(), count - offset);
+      if (in_place != nullptr) {
+        sequence.eval_batch(in_place + offset, values.data(), tile);
+      }
+      else {
+        mathlab::load_binary_values(data + offset * mathlab::binary_value_size(type), type, values.data(), tile);
+        sequence.eval_batch(values.data(), values.data(), tile);
+      }
+      summary.add(values.data(), tile);
+    }
+    return summary;
+  }
+}
+
+namespace mathlab {
+
+  template<typename TValue>
+  size_t evaluate_text(const block_sequence& sequence, const char* first, const char* last, std::ostream& output,
+    unsigned thread_count, size_t chunk_size) {
+    const auto version = sequence.current();
+    size_t evaluated = 0;
+    evaluate_text_chunks(first, last, thread_count, chunk_size,
+      [&version](const char* begin, const char* end) { return evaluate_chunk<TValue>(*version, begin, end); },
+      text_chunk_writer(output, evaluated));
+    return evaluated;
+  }
+
+  template<typename TValue>
+  size_t evaluate_text(const block_sequence& sequence, std::istream& input, std::ostream& output,
+    unsigned thread_count, size_t chunk_size) {
+    const auto version = sequence.current();
+    size_t evaluated = 0;
+    evaluate_text_chunks(input, thread_count, chunk_size,
+      [&version](const char* begin, const char* end) { return evaluate_chunk<TValue>(*version, begin, end); },
+      text_chunk_writer(output, evaluated));
+    return evaluated;
+  }
+
+  template<typename TValue>
+  size_t evaluate_binary(const block_sequence& sequence, const char* first, const char* last, std::ostream& output,
+    unsigned thread_count, size_t chunk_values) {
+    const auto version = sequence.current();
+    size_t evaluated = 0;
+    const auto values = parse_binary(first, last);
+    binary_writer writer(output, precision_of<TValue>());
+    // Offset and count of values in chunk
+    using chunk = std::pair<size_t, size_t>;
+    size_t offset = 0;
+    run_ordered(thread_count,
+      [&]() -> std::optional<chunk> {
+        if (offset == values.count)
+          return std::nullopt;
+        const auto begin = offset;
+        offset += std::min(chunk_values, values.count - offset);
+        return chunk(begin, offset - begin);
+      },
+      [&](chunk range) {
+        std::vector<TValue> results(range.second);
+        const auto data = values.data + range.first * binary_value_size(values.type);
+        if (auto in_place = binary_values_in_place<TValue>(data, values.type)) {
+          version->eval_batch(in_place, results.data(), results.size());
+        }
+        else {
+          load_binary_values(data, values.type, results.data(), results.size());
+          version->eval_batch(results.data(), results.data(), results.size());
+        }
+        return results;
+      },
+      [&](const std::vector<TValue>& results) {
+        writer.write(results.data(), results.size());
+        evaluated += results.size();
+      });
+    writer.finish();
+    return evaluated;
+  }
+
+  template<typename TValue>
+  size_t evaluate_binary(const block_sequence& sequence, std::istream& input, std::ostream& output,
+    unsigned thread_count, size_t chunk_values) {
+    const auto version = sequence.current();
+    size_t evaluated = 0;
+    binary_reader reader(input);
+    binary_writer writer(output, precision_of<TValue>());
+    run_ordered(thread_count,
+      [&]() -> std::optional<std::vector<TValue>> {
+        std::vector<TValue> values(chunk_values);
+        values.resize(reader.read(values.data(), values.size()));
+        if (values.empty())
+          return std::nullopt;
+        return values;
+      },
+      [&](std::vector<TValue> values) {
+        version->eval_batch(values.data(), values.data(), values.size());
+        return values;
+      },
+      [&](const std::vector<TValue>& results) {
+        writer.write(results.data(), results.size());
+        evaluated += results.size();
+      });
+    writer.finish();
+    return evaluated;
+  }
+
+  template<typename TValue>
+  size_t evaluate_text(const block_sequence& sequence, const sweep_range& range, std::ostream& output,
+    unsigned thread_count, size_t chunk_values) {
+    const auto version = sequence.current();
+    evaluate_range_chunks(range, thread_count, chunk_values,
+      [&](size_t first, size_t count) {
+        std::vector<TValue> values(std::min(count, sequence_version::tile_size));
+        std::string text(count * max_formatted_size, '\0');
+        auto to = &text[0];
+        for (size_t offset = 0; offset < count; offset += values.size()) {
+          const auto tile = std::min(values.size(), count - offset);
+          fill_range(range, first + offset, values.data(), tile);
+          version->eval_batch(values.data(), values.data(), tile);
+          for (size_t i = 0; i < tile; ++i)
+            to = format_value(values[i], to);
+        }
+        text.resize(static_cast<size_t>(to - text.data()));
+        return text;
+      },
+      [&](const std::string& text) { output.write(text.data(), static_cast<std::streamsize>(text.size())); });
+    return range.count;
+  }
+
+  template<typename TValue>
+  size_t evaluate_binary(const block_sequence& sequence, const sweep_range& range, std::ostream& output,
+    unsigned thread_count, size_t chunk_values) {
+    const auto version = sequence.current();
+    binary_writer writer(output, precision_of<TValue>());
+    evaluate_range_chunks(range, thread_count, chunk_values,
+      [&](size_t first, size_t count) {
+        std::vector<TValue> values(count);
+        fill_range(range, first, values.data(), count);
+        version->eval_batch(values.data(), values.data(), count);
+        return values;
+      },
+      [&](const std::vector<TValue>& results) { writer.write(results.data(), results.size()); });
+    writer.finish();
+    return range.count;
+  }
+
+  result_summary summarize_text(const block_sequence& sequence, const char* first, const char* last,
+    unsigned thread_count, size_t chunk_size) {
+    const auto version = sequence.current();
+    result_summary summary;
+    evaluate_text_chunks(first, last, thread_count, chunk_size,
+      [&version](const char* begin, const char* end) { return summarize_chunk(*version, begin, end); },
+      [&summary](const result_summary& chunk) { summary.merge(chunk); });
+    return summary;
+  }
+
+  result_summary summarize_text(const block_sequence& sequence, std::istream& input,
+    unsigned thread_count, size_t chunk_size) {
+    const auto version = sequence.current();
+    result_summary summary;
+    evaluate_text_chunks(input, thread_count, chunk_size,
+      [&version](const char* begin, const char* end) { return summarize_chunk(*version, begin, end); },
+      [&summary](const result_summary& chunk) { summary.merge(chunk); });
+    return summary;
+  }
+
+  result_summary summarize_binary(const block_sequence& sequence, const char* first, const char* last,
+    unsigned thread_count, size_t chunk_values) {
+    const auto version = sequence.current();
+    const auto values = parse_binary(first, last);
+    result_summary summary;
+    using chunk = std::pair<size_t, size_t>;
+    size_t offset = 0;
+    run_ordered(thread_count,
+      [&]() -> std::optional<chunk> {
+        if (offset == values.count)
+          return std::nullopt;
+        const auto begin = offset;
+        offset += std::min(chunk_values, values.count - offset);
+        return chunk(begin, offset - begin);
+      },
+      [&](chunk range) {
+        return summarize_binary_chunk(*version, values.data + range.first * binary_value_size(values.type), values.type, range.second);
+      },
+      [&summary](const result_summary& chunk) { summary.merge(chunk); });
+    return summary;
+  }
+
+  result_summary summarize_binary(const block_sequence& sequence, std::istream& input,
+    unsigned thread_count, size_t chunk_values) {
+    const auto version = sequence.current();
+    binary_reader reader(input);
+    result_summary summary;
+    run_ordered(thread_count,
+      [&]() -> std::optional<std::vector<double>> {
+        std::vector<double> values(chunk_values);
+        values.resize(reader.read(values.data(), values.size()));
+        if (values.empty())
+          return std::nullopt;
+        return values;
+      },
+      [&](std::vector<double> values) {
+        version->eval_batch(values.data(), values.data(), values.size());
+        result_summary chunk;
+        chunk.add(values.data(), values.size());
+        return chunk;
+      },
+      [&summary](const result_summary& chunk) { summary.merge(chunk); });
+    return summary;
+  }
+
+  result_summary summarize_range(const block_sequence& sequence, const sweep_range& range,
+    unsigned thread_count, size_t chunk_values) {
+    const auto version = sequence.current();
+    result_summary summary;
+    evaluate_range_chunks(range, thread_count, chunk_values,
+      [&](size_t first, size_t count) {
+        result_summary chunk;
+        std::vector<double> values(std::min(count, sequence_version::tile_size));
+        for (size_t offset = 0; offset < count; offset += values.size()) {
+          const auto tile = std::min(values.size(), count - offset);
+          fill_range(range, first + offset, values.data(), tile);
+          version->eval_batch(values.data(), values.data(), tile);
+          chunk.add(values.data(), tile);
+        }
+        return chunk;
+      },
+      [&summary](const result_summary& chunk) { summary.merge(chunk); });
+    return summary;
+  }
+
+  size_t evaluate_text(const sequence_trie& sequences, const char* first, const char* last, std::ostream& output,
+    unsigned thread_count, size_t chunk_size) {
+    size_t evaluated = 0;
+    evaluate_text_chunks(first, last, thread_count, chunk_size,
+      [&sequences](const char* begin, const char* end) { return evaluate_chunk(sequences, begin, end); },
+      text_chunk_writer(output, evaluated));
+    return evaluated;
+  }
+
+  size_t evaluate_text(const sequence_trie& sequences, std::istream& input, std::ostream& output,
+    unsigned thread_count, size_t chunk_size) {
+    size_t evaluated = 0;
+    evaluate_text_chunks(input, thread_count, chunk_size,
+      [&sequences](const char* begin, const char* end) { return evaluate_chunk(sequences, begin, end); },
+      text_chunk_writer(output, evaluated));
+    return evaluated;
+  }
+
+  size_t evaluate_binary(const sequence_trie& sequences, const char* first, const char* last, const std::vector<std::ostream*>& outputs,
+    unsigned thread_count, size_t chunk_values) {
+    size_t evaluated = 0;
+    const auto values = parse_binary(first, last);
+    std::vector<std::unique_ptr<binary_writer>> writers;
+    for (auto output : outputs)
+      writers.push_back(std::make_unique<binary_writer>(*output));
+    using chunk = std::pair<size_t, size_t>;
+    size_t offset = 0;
+    run_ordered(thread_count,
+      [&]() -> std::optional<chunk> {
+        if (offset == values.count)
+          return std::nullopt;
+        const auto begin = offset;
+        offset += std::min(chunk_values, values.count - offset);
+        return chunk(begin, offset - begin);
+      },
+      [&](chunk range) {
+        const auto data = values.data + range.first * binary_value_size(values.type);
+        if (auto in_place = binary_values_in_place<double>(data, values.type))
+          return evaluate_columns(sequences, in_place, range.second);
+        std::vector<double> loaded(range.second);
+        load_binary_values(data, values.type, loaded.data(), loaded.size());
+        return evaluate_columns(sequences, loaded.data(), loaded.size());
+      },
+      [&](const column_results& results) {
+        for (size_t i = 0; i < writers.size(); ++i)
+          writers[i]->write(results.columns[i].data(), results.count);
+        evaluated += results.count;
+      });
+    for (auto& writer : writers)
+      writer->finish();
+    return evaluated;
+  }
+
+  size_t evaluate_binary(const sequence_trie& sequences, std::istream& input, const std::vector<std::ostream*>& outputs,
+    unsigned thread_count, size_t chunk_values) {
+    size_t evaluated = 0;
+    binary_reader reader(input);
+    std::vector<std::unique_ptr<binary_writer>> writers;
+    for (auto output : outputs)
+      writers.push_back(std::make_unique<binary_writer>(*output));
+    run_ordered(thread_count,
+      [&]() -> std::optional<std::vector<double>> {
+        std::vector<double> values(chunk_values);
+        values.resize(reader.read(values.data(), values.size()));
+        if (values.empty())
+          return std::nullopt;
+        return values;
+      },
+      [&](std::vector<double> values) { return evaluate_columns(sequences, values.data(), values.size()); },
+      [&](const column_results& results) {
+        for (size_t i = 0; i < writers.size(); ++i)
+          writers[i]->write(results.columns[i].data(), results.count);
+        evaluated += results.count;
+      });
+    for (auto& writer : writers)
+      writer->finish();
+    return evaluated;
+  }
+
+  template size_t evaluate_text<float>(const block_sequence&, const char*, const char*, std::ostream&, unsigned, size_t);
+  template size_t evaluate_text<float>(const block_sequence&, std::istream&, std::ostream&, unsigned, size_t);
+  template size_t evaluate_binary<float>(const block_sequence&, const char*, const char*, std::ostream&, unsigned, size_t);
+  template size_t evaluate_binary<float>(const block_sequence&, std::istream&, std::ostream&, unsigned, size_t);
+  template size_t evaluate_text<double>(const block_sequence&, const char*, const char*, std::ostream&, unsigned, size_t);
+  template size_t evaluate_text<double>(const block_sequence&, std::istream&, std::ostream&, unsigned, size_t);
+  template size_t evaluate_binary<double>(const block_sequence&, const char*, const char*, std::ostream&, unsigned, size_t);
+  template size_t evaluate_binary<double>(const block_sequence&, std::istream&, std::ostream&, unsigned, size_t);
+  template size_t evaluate_text<long double>(const block_sequence&, const char*, const char*, std::ostream&, unsigned, size_t);
+  template size_t evaluate_text<long double>(const block_sequence&, std::istream&, std::ostream&, unsigned, size_t);
+  template size_t evaluate_binary<long double>(const block_sequence&, const char*, const char*, std::ostream&, unsigned, size_t);
+  template size_t evaluate_binary<long double>(const block_sequence&, std::istream&, std::ostream&, unsigned, size_t);
+  template size_t evaluate_text<float>(const block_sequence&, const sweep_range&, std::ostream&, unsigned, size_t);
+  template size_t evaluate_binary<float>(const block_sequence&, const sweep_range&, std::ostream&, unsigned, size_t);
+  template size_t evaluate_text<double>(const block_sequence&, const sweep_range&, std::ostream&, unsigned, size_t);
+  template size_t evaluate_binary<double>(const block_sequence&, const sweep_range&, std::ostream&, unsigned, size_t);
+  template size_t evaluate_text<long double>(const block_sequence&, const sweep_range&, std::ostream&, unsigned, size_t);
+  template size_t evaluate_binary<long double>(const block_sequence&, const sweep_range&, std::ostream&, unsigned, size_t);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "block_sequence.h"
+#include "result_summary.h"
+#include "sequence_trie.h"
+#include "value_io.h"
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace mathlab {
+
+  // Size of text chunks evaluated by one task
+  constexpr size_t evaluation_chunk_size = 1 << 20;
+
+  // Evaluates whitespace separated numbers and writes results one per line, in the order of input
+  // Text is split into chunks of about chunk_size bytes that end at whitespace; chunks are parsed, evaluated and
+  // formatted on thread_count threads, all from the version of sequence current at the start
+  // Returns number of evaluated values
+  // Throws invalid_argument on text that is not a number, after writing results of all chunks before it
+  // Values are parsed, evaluated and formatted as TValue, which is float, double or long double
+  template<typename TValue = double>
+  size_t evaluate_text(const block_sequence& sequence, const char* first, const char* last, std::ostream& output,
+    unsigned thread_count, size_t chunk_size = evaluation_chunk_size);
+  // Reads chunks from stream, at most 2 * thread_count chunks are held in memory
+  template<typename TValue = double>
+  size_t evaluate_text(const block_sequence& sequence, std::istream& input, std::ostream& output,
+    unsigned thread_count, size_t chunk_size = evaluation_chunk_size);
+
+  // Same for binary format, input includes header, chunks have chunk_values values
+  // Values in memory are evaluated in place when they are aligned, little-endian and of TValue's precision,
+  // input of other precision is converted and results are written in TValue's precision
+  // Throws invalid_argument if input is not in binary format
+  template<typename TValue = double>
+  size_t evaluate_binary(const block_sequence& sequence, const char* first, const char* last, std::ostream& output,
+    unsigned thread_count, size_t chunk_values = evaluation_chunk_size / sizeof(double));
+  template<typename TValue = double>
+  size_t evaluate_binary(const block_sequence& sequence, std::istream& input, std::ostream& output,
+    unsigned thread_count, size_t chunk_values = evaluation_chunk_size / sizeof(double));
+
+  // Same for values of range generated on the threads instead of read, chunks have chunk_values values
+  template<typename TValue = double>
+  size_t evaluate_text(const block_sequence& sequence, const sweep_range& range, std::ostream& output,
+    unsigned thread_count, size_t chunk_values = evaluation_chunk_size / sizeof(double));
+  template<typename TValue = double>
+  size_t evaluate_binary(const block_sequence& sequence, const sweep_range& range, std::ostream& output,
+    unsigned thread_count, size_t chunk_values = evaluation_chunk_size / sizeof(double));
+
+  // Evaluates input like evaluate_text, evaluate_binary and the range overloads in double precision, but instead of
+  // writing results adds them to a summary; every chunk is summarized on its thread and the summaries are merged
+  result_summary summarize_text(const block_sequence& sequence, const char* first, const char* last,
+    unsigned thread_count, size_t chunk_size = evaluation_chunk_size);
+  result_summary summarize_text(const block_sequence& sequence, std::istream& input,
+    unsigned thread_count, size_t chunk_size = evaluation_chunk_size);
+  result_summary summarize_binary(const block_sequence& sequence, const char* first, const char* last,
+    unsigned thread_count, size_t chunk_values = evaluation_chunk_size / sizeof(double));
+  result_summary summarize_binary(const block_sequence& sequence, std::istream& input,
+    unsigned thread_count, size_t chunk_values = evaluation_chunk_size / sizeof(double));
+  result_summary summarize_range(const block_sequence& sequence, const sweep_range& range,
+    unsigned thread_count, size_t chunk_values = evaluation_chunk_size / sizeof(double));
+
+  // Same for all sequences of a trie over one pass of input
+  // Every line of text results has the results of all sequences separated by spaces, in the order of sequences
+  size_t evaluate_text(const sequence_trie& sequences, const char* first, const char* last, std::ostream& output,
+    unsigned thread_count, size_t chunk_size = evaluation_chunk_size);
+  size_t evaluate_text(const sequence_trie& sequences, std::istream& input, std::ostream& output,
+    unsigned thread_count, size_t chunk_size = evaluation_chunk_size);
+  // Binary results of every sequence are written to its own output, in the order of sequences
+  size_t evaluate_binary(const sequence_trie& sequences, const char* first, const char* last, const std::vector<std::ostream*>& outputs,
+    unsigned thread_count, size_t chunk_values = evaluation_chunk_size / sizeof(double));
+  size_t evaluate_binary(const sequence_trie& sequences, std::istream& input, const std::vector<std::ostream*>& outputs,
+    unsigned thread_count, size_t chunk_values = evaluation_chunk_size / sizeof(double));
+}
@@ -0,0 +1,143 @@
+#include "prefix_cache.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+  uint64_t hash_of(const double* values, size_t count) {
+    auto hash = 14695981039346656037ull ^ count;
+    for (size_t i = 0; i < count; ++i) {
+      uint64_t bits;
+      std::memcpy(&bits, values + i, sizeof(bits));
+      hash = (hash ^ bits) * 0x9E3779B97F4A7C15ull;
+      hash ^= hash >> 29;
+    }
+    return hash;
+  }
+}
+
+namespace mathlab {
+
+  struct prefix_cache::entry {
+    uint64_t hash;
+    std::vector<double> input;
+    // Sorted by position
+    std::vector<std::pair<size_t, std::shared_ptr<const std::vector<double>>>> checkpoints;
+    // Cleared batches are not extended by evaluations still holding them
+    bool kept = true;
+  };
+
+  prefix_cache::prefix_cache(size_t budget) : budget_(budget) {}
+
+  void prefix_cache::begin_input(const std::string& source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (source == source_)
+      return;
+    clear();
+    source_ = source;
+  }
+
+  prefix_cache::match prefix_cache::find(const double* input, size_t count, uint64_t generation) {
+    const auto hash = hash_of(input, count);
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto range = entries_.equal_range(hash);
+    for (auto found = range.first; found != range.second; ++found) {
+      const auto& batch = found->second;
+      if (batch->input.size() != count || !std::equal(input, input + count, batch->input.begin(),
+        [](double left, double right) { return std::memcmp(&left, &right, sizeof(double)) == 0; }))
+        continue;
+      if (batch->checkpoints.empty() || generation != generation_) {
+        ++misses_;
+        return { batch, 0, nullptr };
+      }
+      ++hits_;
+      return { batch, batch->checkpoints.back().first, batch->checkpoints.back().second };
+    }
+    ++misses_;
+    return {};
+  }
+
+  std::shared_ptr<prefix_cache::entry> prefix_cache::insert(const double* input, size_t count) {
+    const auto size = count * sizeof(double);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (used_ + size > budget_)
+      return nullptr;
+    auto batch = std::make_shared<entry>();
+    batch->hash = hash_of(input, count);
+    batch->input.assign(input, input + count);
+    entries_.emplace(batch->hash, batch);
+    used_ += size;
+    return batch;
+  }
+
+  void prefix_cache::add_checkpoint(const std::shared_ptr<entry>& batch, size_t position, const double* values, uint64_t generation) {
+    const auto count = batch->input.size();
+    const auto size = count * sizeof(double);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!batch->kept || generation != generation_ || used_ + size > budget_)
+        return;
+      used_ += size;
+    }
+    // Values are copied without the lock, clearing the batch meanwhile also drops the reserved size
+    auto checkpoint = std::make_shared<const std::vector<double>>(values, values + count);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!batch->kept || generation != generation_) {
+      used_ -= batch->kept ? size : 0;
+      return;
+    }
+    auto& checkpoints = batch->checkpoints;
+    const auto at = std::lower_bound(checkpoints.begin(), checkpoints.end(), position,
+      [](const auto& checkpoint, size_t value) { return checkpoint.first < value; });
+    if (at != checkpoints.end() && at->first == position)
+      used_ -= size;
+    else
+      checkpoints.emplace(at, position, std::move(checkpoint));
+  }
+
+  uint64_t prefix_cache::invalidate_from(size_t first_changed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& pair : entries_) {
+      auto& checkpoints = pair.second->checkpoints;
+      while (!checkpoints.empty() && checkpoints.back().first > first_changed) {
+        used_ -= checkpoints.back().second->size() * sizeof(double);
+        checkpoints.pop_back();
+      }
+    }
+    return ++generation_;
+  }
+
+  uint64_t prefix_cache::generation() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return generation_;
+  }
+
+  std::vector<size_t> prefix_cache::checkpoint_positions(size_t block_count) {
+    std::vector<size_t> positions;
+    for (size_t distance = 1; distance < block_count && positions.size() < max_checkpoints; distance *= 2)
+      positions.push_back(block_count - distance);
+    std::reverse(positions.begin(), positions.end());
+    return positions;
+  }
+
+  uint64_t prefix_cache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+  }
+
+  uint64_t prefix_cache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+  }
+
+  size_t prefix_cache::used() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return used_;
+  }
+
+  void prefix_cache::clear() {
+    for (auto& pair : entries_)
+      pair.second->kept = false;
+    entries_.clear();
+    used_ = 0;
+  }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mathlab {
+
+  // Outputs of the first blocks of a sequence for batches evaluated before, so that evaluation after an edit of later
+  // blocks resumes from the longest unchanged prefix
+  // A batch is found by its input values, its checkpoints are outputs after a number of blocks (position)
+  // Batches of one input source are kept until budget is used, later batches are evaluated without being kept
+  class prefix_cache {
+  public:
+    struct entry;
+    struct match {
+      // nullptr if batch is not kept
+      std::shared_ptr<entry> batch;
+      // Number of blocks evaluated in values, values are nullptr if there is no checkpoint
+      size_t position = 0;
+      std::shared_ptr<const std::vector<double>> values;
+    };
+    static constexpr size_t default_budget = size_t(256) << 20;
+    static constexpr size_t max_checkpoints = 4;
+
+    explicit prefix_cache(size_t budget = default_budget);
+    // Drops kept batches if source differs from source of previous call, like another input file
+    void begin_input(const std::string& source);
+    // Kept batch with the same input values and its checkpoint with the largest position
+    // Evaluation of generation before the last invalidation finds no checkpoint
+    match find(const double* input, size_t count, uint64_t generation);
+    // Keeps copy of input, returns nullptr if it does not fit budget
+    std::shared_ptr<entry> insert(const double* input, size_t count);
+    // Keeps output after position blocks for input of batch, unless it does not fit budget or generation is out of date
+    void add_checkpoint(const std::shared_ptr<entry>& batch, size_t position, const double* values, uint64_t generation);
+    // Drops checkpoints after first_changed blocks, they were computed with blocks that changed
+    // Returns the next generation, evaluation of blocks after the change passes it to find and add_checkpoint
+    uint64_t invalidate_from(size_t first_changed);
+    uint64_t generation() const;
+    // Ascending positions worth a checkpoint in a sequence of block_count blocks:
+    // before the last block, which is the one usually tuned, and at doubling distances before it
+    static std::vector<size_t> checkpoint_positions(size_t block_count);
+
+    uint64_t hits() const;
+    uint64_t misses() const;
+    // Bytes of kept inputs and checkpoints
+    size_t used() const;
+  private:
+    const size_t budget_;
+    mutable std::mutex mutex_;
+    std::string source_;
+    std::unordered_multimap<uint64_t, std::shared_ptr<entry>> entries_;
+    size_t used_ = 0;
+    uint64_t generation_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+
+    void clear();
+  };
+}
@@ -0,0 +1,59 @@
+#include "result_cache.h"
+
+namespace {
+  // Identifies caches in tables of threads, never reused
+  std::atomic<uint64_t> next_cache_id{ 1 };
+
+  unsigned log2_ceil(size_t value) {
+    unsigned bits = 0;
+    while ((size_t(1) << bits) < value)
+      ++bits;
+    return bits;
+  }
+}
+
+namespace mathlab {
+
+  result_table::result_table(size_t capacity, double result_of_zero)
+    : entries_(size_t(1) << log2_ceil(std::max<size_t>(capacity, 2)), entry{ 0, result_of_zero }),
+    shift_(64 - log2_ceil(std::max<size_t>(capacity, 2))) {}
+
+  result_cache::result_cache(size_t capacity) : id_(next_cache_id++), capacity_(capacity) {}
+
+  // Table of a thread and the cache that owns it
+  struct result_cache::thread_slot {
+    uint64_t cache_id = 0;
+    std::unique_ptr<thread_state> state;
+  };
+
+  result_cache::thread_slot& result_cache::this_thread() {
+    thread_local thread_slot slot;
+    return slot;
+  }
+
+  result_cache::thread_state* result_cache::local_state() const {
+    auto& local = this_thread();
+    return local.cache_id == id_ ? local.state.get() : nullptr;
+  }
+
+  result_cache::thread_state& result_cache::reset_local_state(double result_of_zero) const {
+    auto& local = this_thread();
+    local.cache_id = id_;
+    local.state = std::make_unique<thread_state>(capacity_, result_of_zero);
+    return *local.state;
+  }
+
+  void result_cache::record(uint64_t hits, uint64_t lookups) {
+    hits_.fetch_add(hits, std::memory_order_relaxed);
+    misses_.fetch_add(lookups - hits, std::memory_order_relaxed);
+    const auto window_hits = window_hits_.fetch_add(hits, std::memory_order_relaxed) + hits;
+    const auto window_lookups = window_lookups_.fetch_add(lookups, std::memory_order_relaxed) + lookups;
+    if (window_lookups < check_interval)
+      return;
+    // Concurrent batches may be counted in the next window, which does not change the decision much
+    window_hits_.store(0, std::memory_order_relaxed);
+    window_lookups_.store(0, std::memory_order_relaxed);
+    if (window_hits < min_hit_rate * window_lookups)
+      active_.store(false, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace mathlab {
+
+  // Direct mapped table of results keyed by bit pattern of input, the last insert into a slot wins
+  class result_table {
+    struct entry {
+      uint64_t key;
+      double result;
+    };
+    std::vector<entry> entries_;
+    unsigned shift_;
+  public:
+    // Capacity is rounded up to a power of two
+    // Every slot starts with the result of +0, so a lookup never finds an empty slot
+    result_table(size_t capacity, double result_of_zero);
+    // Returns nullptr if input is not in table
+    const double* find(double input) const {
+      const auto& entry = entries_[slot(bits_of(input))];
+      return entry.key == bits_of(input) ? &entry.result : nullptr;
+    }
+    void insert(double input, double result) {
+      const auto key = bits_of(input);
+      entries_[slot(key)] = { key, result };
+    }
+    size_t capacity() const { return entries_.size(); }
+  private:
+    static uint64_t bits_of(double value) {
+      uint64_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      return bits;
+    }
+    // Fibonacci hashing spreads nearby inputs, which differ only in low bits of mantissa
+    size_t slot(uint64_t key) const { return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> shift_); }
+  };
+
+  // Cache of results in front of batch evaluation
+  // Every evaluating thread has its own table, so lookups take no lock; a table is cleared when the thread
+  // evaluates through another cache, so a new cache is created to invalidate results after a change of sequence
+  // Switches itself off when less than min_hit_rate of the last check_interval lookups hit
+  class result_cache {
+    struct thread_state;
+    struct thread_slot;
+    const uint64_t id_;
+    const size_t capacity_;
+    std::atomic<uint64_t> hits_{ 0 };
+    std::atomic<uint64_t> misses_{ 0 };
+    std::atomic<uint64_t> window_hits_{ 0 };
+    std::atomic<uint64_t> window_lookups_{ 0 };
+    std::atomic<bool> active_{ true };
+  public:
+    static constexpr size_t default_capacity = 1 << 16;
+    static constexpr uint64_t check_interval = 1 << 16;
+    static constexpr double min_hit_rate = .5;
+    // Lookups and evaluation of misses run over tiles of this size
+    static constexpr size_t tile_size = 2048;
+
+    explicit result_cache(size_t capacity = default_capacity);
+    // False after the cache switched itself off, evaluation should then bypass it
+    bool active() const { return active_.load(std::memory_order_relaxed); }
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+    // Looks up count values in the table of calling thread and evaluates misses of each tile
+    // with one call of evaluate(const double* input, double* output, size_t count)
+    // Input and output may point to the same buffer
+    template<typename TEvaluate>
+    void eval_batch(const double* input, double* output, size_t count, const TEvaluate& evaluate);
+  private:
+    static thread_slot& this_thread();
+    // Table of calling thread, nullptr if it belongs to another cache
+    thread_state* local_state() const;
+    thread_state& reset_local_state(double result_of_zero) const;
+    void record(uint64_t hits, uint64_t lookups);
+  };
+
+  struct result_cache::thread_state {
+    result_table table;
+    std::vector<double> miss_inputs;
+    std::vector<double> miss_outputs;
+    std::vector<size_t> miss_positions;
+
+    thread_state(size_t capacity, double result_of_zero) : table(capacity, result_of_zero),
+      miss_inputs(tile_size), miss_outputs(tile_size), miss_positions(tile_size) {}
+  };
+
+  template<typename TEvaluate>
+  void result_cache::eval_batch(const double* input, double* output, size_t count, const TEvaluate& evaluate) {
+    auto state = local_state();
+    if (state == nullptr) {
+      const double zero = 0.;
+      double result_of_zero;
+      evaluate(&zero, &result_of_zero, 1);
+      state = &reset_local_state(result_of_zero);
+    }
+    uint64_t hits = 0;
+    for (size_t offset = 0; offset < count; offset += tile_size) {
+      const auto tile = std::min(tile_size, count - offset);
+      size_t missed = 0;
+      for (size_t i = offset; i < offset + tile; ++i) {
+        const auto value = input[i];
+        if (auto cached = state->table.find(value)) {
+          output[i] = *cached;
+        }
+        else {
+          state->miss_inputs[missed] = value;
+          state->miss_positions[missed++] = i;
+        }
+      }
+      hits += tile - missed;
+      if (missed == 0)
+        continue;
+      evaluate(state->miss_inputs.data(), state->miss_outputs.data(), missed);
+      for (size_t j = 0; j < missed; ++j) {
+        output[state->miss_positions[j]] = state->miss_outputs[j];
+        state->table.insert(state->miss_inputs[j], state->miss_outputs[j]);
+      }
+    }
+    record(hits, count);
+  }
+}
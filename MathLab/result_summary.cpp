@@ -0,0 +1,307 @@
+#include "result_summary.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+  constexpr int mantissa_bits = 52;
+
+  // Shortest representation that reads back to the same value, JSON has no infinity and NaN
+  void write_json_number(std::ostream& to_stream, double value) {
+    if (!std::isfinite(value)) {
+      to_stream << "null";
+      return;
+    }
+    char text[32];
+    const auto result = std::to_chars(text, text + sizeof(text), value);
+    to_stream.write(text, result.ptr - text);
+  }
+
+  // Bucket of the magnitude of value that is not NaN
+  uint32_t bucket_of(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return static_cast<uint32_t>((bits & ~(uint64_t(1) << 63)) >> (mantissa_bits - mathlab::result_summary::sketch_bits));
+  }
+
+  double bucket_start(uint64_t bucket) {
+    const auto bits = bucket << (mantissa_bits - mathlab::result_summary::sketch_bits);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  // Middle of the magnitudes in bucket, infinity for the bucket of infinity
+  double bucket_middle(uint32_t bucket) {
+    const auto lower = bucket_start(bucket);
+    if (std::isinf(lower))
+      return lower;
+    const auto upper = std::min(bucket_start(uint64_t(bucket) + 1), std::numeric_limits<double>::max());
+    return lower + (upper - lower) / 2;
+  }
+
+  // Adds count values with mean and sum of squared differences from it, after Chan et al.
+  void merge_moments(uint64_t& count, double& mean, double& squares, uint64_t other_count, double other_mean, double other_squares) {
+    if (other_count == 0)
+      return;
+    const auto total = count + other_count;
+    const auto delta = other_mean - mean;
+    mean += delta * (static_cast<double>(other_count) / total);
+    squares += other_squares + delta * delta * (static_cast<double>(count) * other_count / total);
+    count = total;
+  }
+}
+
+namespace mathlab {
+
+  std::vector<double> parse_quantiles(const std::string& text) {
+    std::vector<double> quantiles;
+    size_t start = 0;
+    while (start <= text.size()) {
+      const auto end = std::min(text.find(',', start), text.size());
+      const auto item = text.substr(start, end - start);
+      size_t parsed = 0;
+      double quantile = -1.;
+      try {
+        quantile = std::stod(item, &parsed);
+      }
+      catch (std::exception&) {
+        // Deliberately empty - reported below
+      }
+      if (parsed == 0 || parsed != item.size() || !(quantile >= 0. && quantile <= 1.))
+        throw std::invalid_argument("Invalid quantiles " + text);
+      quantiles.push_back(quantile);
+      start = end + 1;
+    }
+    return quantiles;
+  }
+
+  void result_summary::bucket_store::add(uint32_t bucket, uint64_t count) {
+    if (counts.empty()) {
+      first = bucket;
+      counts.assign(1, 0);
+    }
+    else if (bucket < first) {
+      // Room for as many buckets again, so that descending values do not move counts every time
+      const auto grow = std::min<uint32_t>(first, std::max<uint32_t>(first - bucket, static_cast<uint32_t>(counts.size())));
+      counts.insert(counts.begin(), grow, 0);
+      first -= grow;
+    }
+    else if (bucket - first >= counts.size()) {
+      counts.resize(std::max<size_t>(bucket - first + 1, 2 * counts.size()));
+    }
+    counts[bucket - first] += count;
+  }
+
+  void result_summary::bucket_store::merge(const bucket_store& other) {
+    if (other.counts.empty())
+      return;
+    // Both ends first, so that counts are not moved while they are added
+    add(other.first, 0);
+    add(other.first + static_cast<uint32_t>(other.counts.size()) - 1, 0);
+    for (size_t i = 0; i < other.counts.size(); ++i)
+      counts[other.first - first + i] += other.counts[i];
+  }
+
+  void result_summary::add(const double* values, size_t count) {
+    count_ += count;
+    auto low = min_;
+    auto high = max_;
+    uint64_t nan = 0;
+    uint64_t zeros = 0;
+    uint64_t finite = 0;
+    double sum = 0.;
+    for (size_t i = 0; i < count; ++i) {
+      const auto value = values[i];
+      // Comparisons are false for NaN
+      if (value != value) {
+        ++nan;
+        continue;
+      }
+      low = value < low ? value : low;
+      high = value > high ? value : high;
+      if (std::isfinite(value)) {
+        ++finite;
+        sum += value;
+      }
+      if (value == 0.) {
+        ++zeros;
+        continue;
+      }
+      auto& store = value > 0. ? positive_ : negative_;
+      // Buckets below first wrap around to large offsets
+      const auto offset = bucket_of(value) - store.first;
+      if (offset < store.counts.size())
+        ++store.counts[offset];
+      else
+        store.add(store.first + offset, 1);
+    }
+    min_ = low;
+    max_ = high;
+    nan_values_ += nan;
+    zeros_ += zeros;
+    if (finite == 0)
+      return;
+    // Squares around the mean of this batch, then merged, which keeps them accurate for values far from zero
+    const auto mean = sum / finite;
+    double squares = 0.;
+    for (size_t i = 0; i < count; ++i) {
+      const auto difference = values[i] - mean;
+      if (std::isfinite(values[i]))
+        squares += difference * difference;
+    }
+    merge_moments(finite_values_, mean_, squares_, finite, mean, squares);
+  }
+
+  void result_summary::merge(const result_summary& other) {
+    count_ += other.count_;
+    nan_values_ += other.nan_values_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    merge_moments(finite_values_, mean_, squares_, other.finite_values_, other.mean_, other.squares_);
+    positive_.merge(other.positive_);
+    negative_.merge(other.negative_);
+    zeros_ += other.zeros_;
+  }
+
+  double result_summary::min() const {
+    return min_ <= max_ ? min_ : std::nan("");
+  }
+
+  double result_summary::max() const {
+    return min_ <= max_ ? max_ : std::nan("");
+  }
+
+  double result_summary::mean() const {
+    return finite_values_ == 0 ? std::nan("") : mean_;
+  }
+
+  double result_summary::variance() const {
+    return finite_values_ == 0 ? std::nan("") : squares_ / finite_values_;
+  }
+
+  template<typename TVisit>
+  void result_summary::visit_buckets(const TVisit& visit) const {
+    for (auto i = negative_.counts.size(); i-- > 0;) {
+      if (negative_.counts[i] != 0)
+        visit(-bucket_middle(negative_.first + static_cast<uint32_t>(i)), negative_.counts[i]);
+    }
+    if (zeros_ != 0)
+      visit(0., zeros_);
+    for (size_t i = 0; i < positive_.counts.size(); ++i) {
+      if (positive_.counts[i] != 0)
+        visit(bucket_middle(positive_.first + static_cast<uint32_t>(i)), positive_.counts[i]);
+    }
+  }
+
+  double result_summary::quantile(double q) const {
+    const auto values = count_ - nan_values_;
+    if (values == 0 || q != q)
+      return std::nan("");
+    if (q <= 0.)
+      return min_;
+    if (q >= 1.)
+      return max_;
+    // Nearest rank, counted from 0
+    const auto rank = static_cast<uint64_t>(q * static_cast<double>(values - 1) + .5);
+    uint64_t seen = 0;
+    auto result = max_;
+    visit_buckets([&](double value, uint64_t count) {
+      if (seen <= rank && seen + count > rank)
+        result = value;
+      seen += count;
+    });
+    // Middle of the bucket of the smallest or largest value may be beyond it
+    return std::min(std::max(result, min_), max_);
+  }
+
+  std::vector<result_summary::histogram_bin> result_summary::histogram(size_t bins) const {
+    std::vector<histogram_bin> result;
+    if (bins == 0 || finite_values_ == 0)
+      return result;
+    // Infinite end of the range is replaced by the middle of the bucket of the smallest or largest finite value
+    auto lower = std::numeric_limits<double>::infinity();
+    auto upper = -lower;
+    if (!std::isfinite(min_) || !std::isfinite(max_)) {
+      visit_buckets([&](double value, uint64_t) {
+        if (std::isfinite(value)) {
+          lower = std::min(lower, value);
+          upper = std::max(upper, value);
+        }
+      });
+    }
+    lower = std::isfinite(min_) ? min_ : lower;
+    upper = std::isfinite(max_) ? max_ : upper;
+    // Middle of a bucket may be beyond the exact end
+    lower = std::min(lower, upper);
+    if (lower == upper)
+      return { { lower, upper, finite_values_ } };
+    // Divided before subtraction, which would overflow for values of opposite signs near the largest double
+    const auto width = upper / bins - lower / bins;
+    for (size_t i = 0; i < bins; ++i)
+      result.push_back({ lower + width * i, i + 1 == bins ? upper : lower + width * (i + 1), 0 });
+    visit_buckets([&](double value, uint64_t count) {
+      if (!std::isfinite(value))
+        return;
+      const auto position = (std::min(std::max(value, lower), upper) / bins - lower / bins) / width * bins;
+      result[std::min(bins - 1, static_cast<size_t>(position))].count += count;
+    });
+    return result;
+  }
+
+  std::ostream& result_summary::dump(std::ostream& to_stream, const summary_settings& settings) const {
+    to_stream << "Values: " << count_ << ", NaN: " << nan_values_ << std::endl;
+    if (count_ == nan_values_)
+      return to_stream;
+    to_stream << "Min: " << min() << ", max: " << max() << std::endl;
+    to_stream << "Mean: " << mean() << ", variance: " << variance() << ", standard deviation: " << std::sqrt(variance()) << std::endl;
+    if (!settings.quantiles.empty()) {
+      to_stream << "Quantiles, within " << relative_error * 100 << "%:" << std::endl;
+      for (auto q : settings.quantiles)
+        to_stream << "  " << q << ": " << quantile(q) << std::endl;
+    }
+    const auto bins = histogram(settings.histogram_bins);
+    if (!bins.empty()) {
+      to_stream << "Histogram of finite values:" << std::endl;
+      for (size_t i = 0; i < bins.size(); ++i)
+        to_stream << "  [" << bins[i].lower << ", " << bins[i].upper << (i + 1 == bins.size() ? "]: " : "): ") << bins[i].count << std::endl;
+    }
+    return to_stream;
+  }
+
+  std::ostream& result_summary::dump_json(std::ostream& to_stream, const summary_settings& settings) const {
+    to_stream << "{\"values\": " << count_ << ", \"nan_values\": " << nan_values_ << ", \"min\": ";
+    write_json_number(to_stream, min());
+    to_stream << ", \"max\": ";
+    write_json_number(to_stream, max());
+    to_stream << ", \"mean\": ";
+    write_json_number(to_stream, mean());
+    to_stream << ", \"variance\": ";
+    write_json_number(to_stream, variance());
+    to_stream << ", \"relative_error\": ";
+    write_json_number(to_stream, relative_error);
+    to_stream << ", \"quantiles\": [";
+    const char* separator = "";
+    for (auto q : settings.quantiles) {
+      to_stream << separator << "{\"q\": ";
+      write_json_number(to_stream, q);
+      to_stream << ", \"value\": ";
+      write_json_number(to_stream, quantile(q));
+      to_stream << '}';
+      separator = ", ";
+    }
+    to_stream << "], \"histogram\": [";
+    separator = "";
+    for (const auto& bin : histogram(settings.histogram_bins)) {
+      to_stream << separator << "{\"lower\": ";
+      write_json_number(to_stream, bin.lower);
+      to_stream << ", \"upper\": ";
+      write_json_number(to_stream, bin.upper);
+      to_stream << ", \"count\": " << bin.count << '}';
+      separator = ", ";
+    }
+    return to_stream << "]}\n";
+  }
+}
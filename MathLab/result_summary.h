@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace mathlab {
+
+  // Quantiles and histogram bins reported by a summary
+  struct summary_settings {
+    // Quantiles in [0, 1]
+    std::vector<double> quantiles = { .5, .9, .99 };
+    size_t histogram_bins = 10;
+  };
+
+  // Parses comma separated quantiles, e.g. 0.5,0.99
+  // Throws invalid_argument if one is not a number in [0, 1]
+  std::vector<double> parse_quantiles(const std::string& text);
+
+  // Summary of values collected in one streaming pass: count, range, mean and variance, and a sketch of
+  // their distribution from which quantiles and a histogram are estimated
+  // Summaries of parts of the values, e.g. of chunks evaluated on other threads, are merged into one
+  class result_summary {
+  public:
+    // Buckets of the sketch split every power of two into 2^sketch_bits buckets of equal width, a bucket is
+    // the exponent and the first sketch_bits bits of the mantissa of the magnitude of its values
+    static constexpr int sketch_bits = 7;
+    // Largest error of quantiles of normal numbers, relative to their magnitude
+    static constexpr double relative_error = 1. / (2 << sketch_bits);
+
+    struct histogram_bin {
+      double lower;
+      double upper;
+      uint64_t count;
+    };
+  private:
+    // Counts of consecutive buckets from bucket first
+    struct bucket_store {
+      uint32_t first = 0;
+      std::vector<uint64_t> counts;
+
+      void add(uint32_t bucket, uint64_t count);
+      void merge(const bucket_store& other);
+    };
+    uint64_t count_ = 0;
+    uint64_t nan_values_ = 0;
+    // Range of values that are not NaN, min is above max while there are none
+    double min_ = std::numeric_limits<double>::infinity();
+    double max_ = -std::numeric_limits<double>::infinity();
+    // Mean and sum of squared differences from the mean of finite values
+    uint64_t finite_values_ = 0;
+    double mean_ = 0.;
+    double squares_ = 0.;
+    // Sketch by magnitude, zeros of both signs are counted apart
+    bucket_store positive_;
+    bucket_store negative_;
+    uint64_t zeros_ = 0;
+  public:
+    void add(const double* values, size_t count);
+    void merge(const result_summary& other);
+
+    // Number of all values, including NaN
+    uint64_t count() const { return count_; }
+    uint64_t nan_values() const { return nan_values_; }
+    // Range of values that are not NaN, NaN if there are none
+    double min() const;
+    double max() const;
+    // Mean and population variance of finite values, NaN if there are none
+    double mean() const;
+    double variance() const;
+    // Value at quantile q in [0, 1] of values that are not NaN, within relative_error of the exact one
+    // Quantiles 0 and 1 are exactly min and max, NaN if there are no values
+    double quantile(double q) const;
+    // Counts of finite values in bins of equal width from the smallest to the largest finite value,
+    // values are binned by the middle of their sketch bucket, empty if there are no finite values
+    std::vector<histogram_bin> histogram(size_t bins) const;
+
+    std::ostream& dump(std::ostream& to_stream, const summary_settings& settings) const;
+    std::ostream& dump_json(std::ostream& to_stream, const summary_settings& settings) const;
+  private:
+    // Calls visit(value, count) with the middle of every bucket that is not empty, from the smallest value
+    template<typename TVisit>
+    void visit_buckets(const TVisit& visit) const;
+  };
+}
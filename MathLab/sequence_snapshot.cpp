@@ -0,0 +1,156 @@
+#include "sequence_snapshot.h"
+#include "little_endian.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace {
+  using namespace mathlab;
+
+  const char magic[4] = { 'M', 'L', 'S', 'Q' };
+
+  size_t padded(size_t size) {
+    return (size + 7) / 8 * 8;
+  }
+
+  uint64_t bits_of(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  double value_of(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+}
+
+namespace mathlab {
+
+  std::optional<snapshot_source> source_of(const std::filesystem::path& text_path) {
+    std::error_code error;
+    const auto size = std::filesystem::file_size(text_path, error);
+    if (error)
+      return std::nullopt;
+    const auto time = std::filesystem::last_write_time(text_path, error);
+    if (error)
+      return std::nullopt;
+    return snapshot_source{ size, static_cast<int64_t>(time.time_since_epoch().count()) };
+  }
+
+  std::filesystem::path snapshot_path(const std::filesystem::path& text_path) {
+    auto path = text_path;
+    return path += ".snapshot";
+  }
+
+  void write_snapshot(std::ostream& to_stream, const block_sequence& sequence, const snapshot_source& source) {
+    const auto names = sequence.type_names();
+    const auto descriptions = sequence.describe();
+    // Few types are registered, so a linear search finds the index of a name
+    std::vector<std::string_view> types;
+    std::vector<uint32_t> type_indices;
+    type_indices.reserve(names.size());
+    for (auto name : names) {
+      auto found = std::find(types.begin(), types.end(), name);
+      if (found == types.end())
+        found = types.insert(types.end(), name);
+      type_indices.push_back(static_cast<uint32_t>(found - types.begin()));
+    }
+    size_t size = snapshot_header_size + names.size() * snapshot_block_size;
+    for (auto type : types)
+      size += 4 + padded(type.size());
+
+    std::vector<char> data(size, 0);
+    std::memcpy(data.data(), magic, sizeof(magic));
+    store_little_endian(snapshot_format_version, data.data() + 4);
+    store_little_endian(source.size, data.data() + 8);
+    store_little_endian(static_cast<uint64_t>(source.last_write_time), data.data() + 16);
+    store_little_endian(static_cast<uint32_t>(types.size()), data.data() + 24);
+    store_little_endian(static_cast<uint64_t>(names.size()), data.data() + 32);
+    auto to = data.data() + snapshot_header_size;
+    for (auto type : types) {
+      store_little_endian(static_cast<uint32_t>(type.size()), to);
+      std::memcpy(to + 4, type.data(), type.size());
+      to += 4 + padded(type.size());
+    }
+    for (size_t i = 0; i < descriptions.size(); ++i, to += snapshot_block_size) {
+      store_little_endian(type_indices[i], to);
+      store_little_endian(bits_of(descriptions[i].constants[0]), to + 8);
+      store_little_endian(bits_of(descriptions[i].constants[1]), to + 16);
+    }
+    to_stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+  }
+
+  bool load_snapshot(block_sequence& sequence, const factory& factory, const char* data, size_t size, const snapshot_source& source) {
+    if (size < snapshot_header_size || std::memcmp(data, magic, sizeof(magic)) != 0)
+      return false;
+    const snapshot_source stored = { load_little_endian<uint64_t>(data + 8), static_cast<int64_t>(load_little_endian<uint64_t>(data + 16)) };
+    if (load_little_endian<uint32_t>(data + 4) != snapshot_format_version || stored != source)
+      return false;
+    const auto type_count = load_little_endian<uint32_t>(data + 24);
+    const auto block_count = load_little_endian<uint64_t>(data + 32);
+
+    // Every type name is looked up once, blocks are then created by index
+    std::vector<factory::type_id> types;
+    auto from = data + snapshot_header_size;
+    const auto end = data + size;
+    for (uint32_t i = 0; i < type_count; ++i) {
+      if (end - from < 4)
+        return false;
+      const auto length = load_little_endian<uint32_t>(from);
+      if (static_cast<size_t>(end - from - 4) < padded(length))
+        return false;
+      types.push_back(factory.find_type(std::string_view(from + 4, length)));
+      if (types.back() == factory::no_type)
+        return false;
+      from += 4 + padded(length);
+    }
+    if (static_cast<uint64_t>(end - from) / snapshot_block_size != block_count || static_cast<size_t>(end - from) % snapshot_block_size != 0)
+      return false;
+
+    std::vector<compact_block> blocks;
+    blocks.reserve(static_cast<size_t>(block_count));
+    for (; from != end; from += snapshot_block_size) {
+      const auto type = load_little_endian<uint32_t>(from);
+      if (type >= type_count)
+        return false;
+      const double constants[2] = { value_of(load_little_endian<uint64_t>(from + 8)), value_of(load_little_endian<uint64_t>(from + 16)) };
+      blocks.push_back(factory.create_compact(types[type], constants));
+    }
+    sequence.assign(std::move(blocks));
+    return true;
+  }
+
+  bool load_snapshot_file(block_sequence& sequence, const factory& factory, const std::filesystem::path& text_path) {
+    const auto source = source_of(text_path);
+    if (!source)
+      return false;
+    const mapped_file file(snapshot_path(text_path));
+    return file.is_open() && load_snapshot(sequence, factory, file.data(), file.size(), *source);
+  }
+
+  bool save_snapshot_file(const block_sequence& sequence, const std::filesystem::path& text_path, const snapshot_source& source) {
+    const auto path = snapshot_path(text_path);
+    auto temporary_path = path;
+    temporary_path += ".tmp";
+    {
+      std::ofstream file_stream(temporary_path, std::ios::binary);
+      write_snapshot(file_stream, sequence, source);
+      if (!file_stream.flush())
+        return false;
+    }
+    // Readers see either the old or the new snapshot, never a partial one
+    std::error_code error;
+    std::filesystem::rename(temporary_path, path, error);
+    if (!error)
+      return true;
+    std::filesystem::remove(temporary_path, error);
+    return false;
+  }
+}
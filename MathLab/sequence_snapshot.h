@@ -0,0 +1,54 @@
+#pragma once
+#include "block_sequence.h"
+#include "factory.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+
+namespace mathlab {
+
+  // Binary snapshot of a sequence, kept next to its text file so that loading needs no parsing
+  // All numbers little-endian:
+  //  4 bytes - magic "MLSQ"
+  //  uint32 - format version
+  //  uint64 - size of text file the snapshot was taken from
+  //  int64 - last write time of that text file, in ticks of file clock
+  //  uint32 - number of type names
+  //  uint32 - reserved, zero
+  //  uint64 - number of blocks
+  //  type names - uint32 length and characters, each name padded to a multiple of 8 bytes
+  //  blocks - uint32 index of type name, uint32 reserved, two float64 constants as listed by block_description
+  constexpr size_t snapshot_header_size = 40;
+  constexpr size_t snapshot_block_size = 24;
+  constexpr uint32_t snapshot_format_version = 1;
+
+  // Version of text file a snapshot was taken from, a snapshot of another version is stale
+  struct snapshot_source {
+    uint64_t size = 0;
+    int64_t last_write_time = 0;
+
+    bool operator==(const snapshot_source& other) const { return size == other.size && last_write_time == other.last_write_time; }
+    bool operator!=(const snapshot_source& other) const { return !(*this == other); }
+  };
+
+  // nullopt if file does not exist
+  std::optional<snapshot_source> source_of(const std::filesystem::path& text_path);
+  // Snapshot of text file is stored next to it, with extension .snapshot appended
+  std::filesystem::path snapshot_path(const std::filesystem::path& text_path);
+
+  void write_snapshot(std::ostream& to_stream, const block_sequence& sequence, const snapshot_source& source);
+  // Replaces blocks of sequence with blocks of snapshot in memory
+  // Returns false and leaves sequence unchanged if data is not a snapshot of source in this version or has unknown block types
+  // factory is the one sequence was created with
+  bool load_snapshot(block_sequence& sequence, const factory& factory, const char* data, size_t size, const snapshot_source& source);
+
+  // Maps snapshot of text file and loads sequence from it
+  // Returns false if text file or snapshot does not exist, or snapshot is stale
+  bool load_snapshot_file(block_sequence& sequence, const factory& factory, const std::filesystem::path& text_path);
+  // Writes snapshot of sequence loaded from text file, through a temporary file renamed over the old snapshot
+  // source must be taken before the text is read, so that a change while it is read leaves the snapshot stale
+  // Returns false if snapshot can not be written
+  bool save_snapshot_file(const block_sequence& sequence, const std::filesystem::path& text_path, const snapshot_source& source);
+}
@@ -0,0 +1,241 @@
+#include "sequence_stats.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <iomanip>
+
+namespace {
+  // Shortest representation that reads back to the same value, JSON has no infinity and NaN
+  void write_json_number(std::ostream& to_stream, double value) {
+    if (!std::isfinite(value)) {
+      to_stream << "null";
+      return;
+    }
+    char text[32];
+    const auto result = std::to_chars(text, text + sizeof(text), value);
+    to_stream.write(text, result.ptr - text);
+  }
+
+  void write_json_string(std::ostream& to_stream, const std::string& text) {
+    to_stream << '"';
+    for (auto character : text) {
+      if (character == '"' || character == '\\')
+        to_stream << '\\' << character;
+      else if (static_cast<unsigned char>(character) < 0x20)
+        to_stream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(character) << std::dec << std::setfill(' ');
+      else
+        to_stream << character;
+    }
+    to_stream << '"';
+  }
+
+  void write_json_histogram(std::ostream& to_stream, const mathlab::latency_histogram& histogram) {
+    to_stream << "{\"count\": " << histogram.count() << ", \"mean_ns\": ";
+    write_json_number(to_stream, histogram.mean());
+    to_stream << ", \"p50_ns\": ";
+    write_json_number(to_stream, histogram.quantile(.5));
+    to_stream << ", \"p99_ns\": ";
+    write_json_number(to_stream, histogram.quantile(.99));
+    // Only buckets that are not empty
+    to_stream << ", \"buckets\": [";
+    const char* separator = "";
+    for (size_t i = 0; i < histogram.buckets().size(); ++i) {
+      if (histogram.buckets()[i] == 0)
+        continue;
+      to_stream << separator << "{\"below_ns\": ";
+      write_json_number(to_stream, mathlab::latency_histogram::upper_bound(i));
+      to_stream << ", \"count\": " << histogram.buckets()[i] << '}';
+      separator = ", ";
+    }
+    to_stream << "]}";
+  }
+
+  void dump_histogram(std::ostream& to_stream, const char* title, const mathlab::latency_histogram& histogram) {
+    to_stream << title << ": ";
+    if (histogram.count() == 0) {
+      to_stream << "none" << std::endl;
+      return;
+    }
+    to_stream << histogram.count() << " calls, mean " << histogram.mean() << " ns, p50 < " << histogram.quantile(.5)
+      << " ns, p99 < " << histogram.quantile(.99) << " ns" << std::endl;
+  }
+}
+
+namespace mathlab {
+
+  void block_stats::add_outputs(const double* outputs, size_t count) {
+    values += count;
+    auto low = min;
+    auto high = max;
+    uint64_t nan = 0;
+    for (size_t i = 0; i < count; ++i) {
+      const auto value = outputs[i];
+      // Comparisons are false for NaN
+      nan += value != value;
+      low = value < low ? value : low;
+      high = value > high ? value : high;
+    }
+    min = low;
+    max = high;
+    nan_values += nan;
+  }
+
+  void block_stats::add_time(size_t count, stats_clock::duration time) {
+    timed_values += count;
+    seconds += std::chrono::duration<double>(time).count();
+  }
+
+  void block_stats::merge(const block_stats& other) {
+    values += other.values;
+    timed_values += other.timed_values;
+    seconds += other.seconds;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    nan_values += other.nan_values;
+  }
+
+  double block_stats::nanoseconds_per_value() const {
+    return timed_values == 0 ? 0. : seconds * 1e9 / timed_values;
+  }
+
+  void latency_histogram::add(double nanoseconds) {
+    size_t bucket = 0;
+    while (bucket + 1 < bucket_count && nanoseconds >= upper_bound(bucket))
+      ++bucket;
+    ++buckets_[bucket];
+    ++count_;
+    total_ += nanoseconds;
+  }
+
+  void latency_histogram::merge(const latency_histogram& other) {
+    for (size_t i = 0; i < bucket_count; ++i)
+      buckets_[i] += other.buckets_[i];
+    count_ += other.count_;
+    total_ += other.total_;
+  }
+
+  double latency_histogram::quantile(double q) const {
+    if (count_ == 0)
+      return 0.;
+    const auto rank = static_cast<uint64_t>(std::ceil(q * count_));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucket_count; ++i) {
+      seen += buckets_[i];
+      if (seen >= std::max<uint64_t>(rank, 1))
+        return upper_bound(i);
+    }
+    return upper_bound(bucket_count - 1);
+  }
+
+  double latency_histogram::upper_bound(size_t bucket) {
+    return std::ldexp(1., static_cast<int>(bucket));
+  }
+
+  sequence_stats::sequence_stats(std::vector<std::string> block_names) : names_(std::move(block_names)), blocks_(names_.size()) {}
+
+  bool sequence_stats::sample() {
+    return eval_calls_.fetch_add(1, std::memory_order_relaxed) % sampling_period == 0;
+  }
+
+  void sequence_stats::record_eval(const std::vector<block_stats>& blocks, std::optional<double> nanoseconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < blocks.size() && i < blocks_.size(); ++i)
+      blocks_[i].merge(blocks[i]);
+    if (nanoseconds)
+      eval_latency_.add(*nanoseconds);
+  }
+
+  void sequence_stats::record_batch(const std::vector<block_stats>& blocks, double nanoseconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < blocks.size() && i < blocks_.size(); ++i)
+      blocks_[i].merge(blocks[i]);
+    batch_latency_.add(nanoseconds);
+  }
+
+  void sequence_stats::record_file(uint64_t bytes, uint64_t values, double seconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++files_.files;
+    files_.bytes += bytes;
+    files_.values += values;
+    files_.seconds += seconds;
+  }
+
+  std::vector<block_stats> sequence_stats::blocks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return blocks_;
+  }
+
+  latency_histogram sequence_stats::eval_latency() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return eval_latency_;
+  }
+
+  latency_histogram sequence_stats::batch_latency() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return batch_latency_;
+  }
+
+  file_stats sequence_stats::files() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return files_;
+  }
+
+  std::ostream& sequence_stats::dump(std::ostream& to_stream) const {
+    const auto blocks = this->blocks();
+    to_stream << std::left << std::setw(4) << "#" << std::setw(24) << "block" << std::right << std::setw(12) << "values"
+      << std::setw(12) << "ns/value" << std::setw(14) << "min" << std::setw(14) << "max" << std::setw(10) << "NaN" << std::endl;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      const auto& block = blocks[i];
+      const auto has_range = block.min <= block.max;
+      to_stream << std::left << std::setw(4) << i + 1 << std::setw(24) << names_[i] << std::right << std::setw(12) << block.values
+        << std::setw(12) << block.nanoseconds_per_value();
+      if (has_range)
+        to_stream << std::setw(14) << block.min << std::setw(14) << block.max;
+      else
+        to_stream << std::setw(14) << "-" << std::setw(14) << "-";
+      to_stream << std::setw(10) << block.nan_values << std::endl;
+    }
+    dump_histogram(to_stream, "Single evaluation latency", eval_latency());
+    dump_histogram(to_stream, "Batch latency", batch_latency());
+    const auto files = this->files();
+    to_stream << "Files: " << files.files << ", " << files.values << " values, " << files.bytes << " bytes in " << files.seconds << " s";
+    if (files.seconds > 0)
+      to_stream << ", " << files.values / files.seconds << " values/s, " << files.bytes / files.seconds / (1 << 20) << " MiB/s";
+    return to_stream << std::endl;
+  }
+
+  std::ostream& sequence_stats::dump_json(std::ostream& to_stream) const {
+    const auto blocks = this->blocks();
+    to_stream << "{\n  \"sampling_period\": " << sampling_period << ",\n  \"blocks\": [";
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      const auto& block = blocks[i];
+      to_stream << (i == 0 ? "\n" : ",\n") << "    {\"position\": " << i + 1 << ", \"name\": ";
+      write_json_string(to_stream, names_[i]);
+      to_stream << ", \"values\": " << block.values << ", \"timed_values\": " << block.timed_values << ", \"seconds\": ";
+      write_json_number(to_stream, block.seconds);
+      to_stream << ", \"ns_per_value\": ";
+      write_json_number(to_stream, block.nanoseconds_per_value());
+      to_stream << ", \"min\": ";
+      write_json_number(to_stream, block.min <= block.max ? block.min : std::nan(""));
+      to_stream << ", \"max\": ";
+      write_json_number(to_stream, block.min <= block.max ? block.max : std::nan(""));
+      to_stream << ", \"nan\": " << block.nan_values << '}';
+    }
+    to_stream << (blocks.empty() ? "],\n" : "\n  ],\n") << "  \"eval_latency\": ";
+    write_json_histogram(to_stream, eval_latency());
+    to_stream << ",\n  \"batch_latency\": ";
+    write_json_histogram(to_stream, batch_latency());
+    const auto files = this->files();
+    to_stream << ",\n  \"files\": {\"count\": " << files.files << ", \"bytes\": " << files.bytes << ", \"values\": " << files.values << ", \"seconds\": ";
+    write_json_number(to_stream, files.seconds);
+    to_stream << ", \"values_per_second\": ";
+    write_json_number(to_stream, files.seconds > 0 ? files.values / files.seconds : 0.);
+    to_stream << ", \"bytes_per_second\": ";
+    write_json_number(to_stream, files.seconds > 0 ? files.bytes / files.seconds : 0.);
+    return to_stream << "}\n}\n";
+  }
+
+  double to_nanoseconds(stats_clock::duration time) {
+    return std::chrono::duration<double, std::nano>(time).count();
+  }
+}
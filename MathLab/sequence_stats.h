@@ -0,0 +1,101 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace mathlab {
+
+  using stats_clock = std::chrono::steady_clock;
+
+  // Outputs and time of one block
+  struct block_stats {
+    // Number of values evaluated by block
+    uint64_t values = 0;
+    // Values evaluated while time was measured and the time they took
+    uint64_t timed_values = 0;
+    double seconds = 0;
+    // Range of outputs that are not NaN, min is above max while there are none
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    uint64_t nan_values = 0;
+
+    // Counts outputs and updates their range
+    void add_outputs(const double* outputs, size_t count);
+    void add_time(size_t count, stats_clock::duration time);
+    void merge(const block_stats& other);
+    // Average time per value in nanoseconds, 0 if no time was measured
+    double nanoseconds_per_value() const;
+  };
+
+  // Latencies in power of two buckets, bucket i counts latencies below 2^i nanoseconds and not in previous buckets
+  class latency_histogram {
+  public:
+    static constexpr size_t bucket_count = 48;
+  private:
+    std::array<uint64_t, bucket_count> buckets_{};
+    uint64_t count_ = 0;
+    double total_ = 0;
+  public:
+    void add(double nanoseconds);
+    void merge(const latency_histogram& other);
+    uint64_t count() const { return count_; }
+    double mean() const { return count_ == 0 ? 0. : total_ / count_; }
+    // Upper bound of the bucket that holds quantile q of latencies, 0 if histogram is empty
+    double quantile(double q) const;
+    const std::array<uint64_t, bucket_count>& buckets() const { return buckets_; }
+    static double upper_bound(size_t bucket);
+  };
+
+  // Totals of files evaluated with ef or in batch mode
+  struct file_stats {
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+    uint64_t values = 0;
+    double seconds = 0;
+  };
+
+  // Statistics of a block sequence, collected while instrumentation is enabled
+  // Evaluation threads record whole batches, so the lock is taken once per call
+  class sequence_stats {
+    mutable std::mutex mutex_;
+    std::vector<std::string> names_;
+    std::vector<block_stats> blocks_;
+    latency_histogram eval_latency_;
+    latency_histogram batch_latency_;
+    file_stats files_;
+    std::atomic<uint64_t> eval_calls_{ 0 };
+  public:
+    // Single evaluations measure time once in sampling_period calls, batches always do
+    static constexpr uint64_t sampling_period = 16;
+
+    // Names of blocks in sequence order
+    explicit sequence_stats(std::vector<std::string> block_names);
+    // True if time of the next single evaluation should be measured
+    bool sample();
+    // Adds statistics of one evaluation, with one entry per block; latency is missing when not sampled
+    void record_eval(const std::vector<block_stats>& blocks, std::optional<double> nanoseconds);
+    void record_batch(const std::vector<block_stats>& blocks, double nanoseconds);
+    void record_file(uint64_t bytes, uint64_t values, double seconds);
+
+    const std::vector<std::string>& names() const { return names_; }
+    // Copies taken under lock, safe while other threads evaluate
+    std::vector<block_stats> blocks() const;
+    latency_histogram eval_latency() const;
+    latency_histogram batch_latency() const;
+    file_stats files() const;
+
+    // Table of blocks followed by latency and throughput summaries
+    std::ostream& dump(std::ostream& to_stream) const;
+    // Same data including all histogram buckets, values that are not finite are written as null
+    std::ostream& dump_json(std::ostream& to_stream) const;
+  };
+
+  double to_nanoseconds(stats_clock::duration time);
+}
@@ -0,0 +1,94 @@
+#include "sequence_trie.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+  bool same_block(const mathlab::block_description& left, const mathlab::block_description& right) {
+    return left.kind == right.kind && std::memcmp(left.constants, right.constants, sizeof(left.constants)) == 0;
+  }
+}
+
+namespace mathlab {
+
+  struct sequence_trie::node {
+    // Blocks after parent node
+    std::vector<block_description> blocks;
+    std::unique_ptr<execution_plan> plan;
+    std::unique_ptr<jit_program> jit;
+    // Sequences that end after blocks of this node
+    std::vector<size_t> sequences;
+    std::vector<std::unique_ptr<node>> children;
+
+    void eval_batch(const double* input, double* output, size_t count) const {
+      if (jit != nullptr)
+        jit->eval_batch(input, output, count);
+      else
+        plan->eval_batch(input, output, count);
+    }
+  };
+
+  sequence_trie::sequence_trie(const std::vector<std::vector<block_description>>& sequences, optimization_level level, bool jit)
+    : root_(std::make_unique<node>()), sequence_count_(sequences.size()) {
+    // Trie with one block per node
+    for (size_t i = 0; i < sequences.size(); ++i) {
+      auto current = root_.get();
+      for (const auto& block : sequences[i]) {
+        const auto found = std::find_if(current->children.begin(), current->children.end(),
+          [&block](const std::unique_ptr<node>& child) { return same_block(child->blocks[0], block); });
+        if (found != current->children.end()) {
+          current = found->get();
+        }
+        else {
+          current->children.push_back(std::make_unique<node>());
+          current = current->children.back().get();
+          current->blocks.push_back(block);
+        }
+      }
+      current->sequences.push_back(i);
+    }
+    // Runs of nodes without branches are merged, so every node evaluates as many blocks as possible with one plan
+    // and the root takes over the prefix common to all sequences
+    std::vector<std::pair<node*, size_t>> pending = { { root_.get(), 1 } };
+    while (!pending.empty()) {
+      const auto current = pending.back();
+      pending.pop_back();
+      auto& run = *current.first;
+      while (run.children.size() == 1 && run.sequences.empty()) {
+        auto child = std::move(run.children[0]);
+        run.blocks.insert(run.blocks.end(), child->blocks.begin(), child->blocks.end());
+        run.sequences = std::move(child->sequences);
+        run.children = std::move(child->children);
+      }
+      run.plan = std::make_unique<execution_plan>(run.blocks, level);
+      if (jit && !run.blocks.empty())
+        run.jit = jit_program::compile(*run.plan);
+      ++node_count_;
+      block_count_ += run.blocks.size();
+      depth_ = std::max(depth_, current.second);
+      for (auto& child : run.children)
+        pending.emplace_back(child.get(), current.second + 1);
+    }
+  }
+
+  sequence_trie::~sequence_trie() = default;
+
+  void sequence_trie::eval_batch(const double* input, double* const* outputs, size_t count) const {
+    // Output of a node stays in the buffer of its depth while its children are evaluated
+    std::vector<double> buffers(depth_ * tile_size);
+    for (size_t offset = 0; offset < count; offset += tile_size)
+      eval_tile(*root_, input + offset, outputs, offset, std::min(tile_size, count - offset), buffers.data());
+  }
+
+  void sequence_trie::eval_tile(const node& node, const double* input, double* const* outputs, size_t offset, size_t count, double* buffers) const {
+    // A leaf of one sequence is evaluated straight into its output
+    if (node.children.empty() && node.sequences.size() == 1) {
+      node.eval_batch(input, outputs[node.sequences[0]] + offset, count);
+      return;
+    }
+    node.eval_batch(input, buffers, count);
+    for (auto sequence : node.sequences)
+      std::copy(buffers, buffers + count, outputs[sequence] + offset);
+    for (const auto& child : node.children)
+      eval_tile(*child, buffers, outputs, offset, count, buffers + tile_size);
+  }
+}
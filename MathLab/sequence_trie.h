@@ -0,0 +1,38 @@
+#pragma once
+#include "execution_plan.h"
+#include "jit_compiler.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace mathlab {
+
+  // Several sequences evaluated together, blocks of a common prefix are evaluated once per value
+  // Sequences are merged into a trie whose nodes hold runs of blocks without branches, every node has its own plan
+  class sequence_trie {
+    struct node;
+    std::unique_ptr<node> root_;
+    size_t sequence_count_;
+    size_t node_count_ = 0;
+    size_t block_count_ = 0;
+    size_t depth_ = 0;
+  public:
+    static constexpr size_t tile_size = execution_plan::tile_size;
+
+    // Node plans are compiled to native code when jit is set and supported
+    sequence_trie(const std::vector<std::vector<block_description>>& sequences, optimization_level level, bool jit = false);
+    ~sequence_trie();
+    sequence_trie(const sequence_trie&) = delete;
+    sequence_trie& operator=(const sequence_trie&) = delete;
+
+    // Evaluates count values from input, results of sequence i are written to outputs[i]
+    // Outputs must not overlap input
+    void eval_batch(const double* input, double* const* outputs, size_t count) const;
+    size_t sequence_count() const { return sequence_count_; }
+    size_t node_count() const { return node_count_; }
+    // Blocks evaluated per value, blocks of common prefixes are counted once
+    size_t block_count() const { return block_count_; }
+  private:
+    void eval_tile(const node& node, const double* input, double* const* outputs, size_t offset, size_t count, double* buffers) const;
+  };
+}
@@ -0,0 +1,171 @@
+#include "simd_kernels_impl.h"
+#include <stdexcept>
+
+#if MATHLAB_SIMD_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+  using mathlab::simd::instruction_set;
+
+  // Reference kernels, same results as evaluating blocks one value at a time
+  template<typename TValue>
+  struct scalar {
+    static void add(const TValue* input, TValue* output, size_t count, TValue constant) {
+      for (size_t i = 0; i < count; ++i)
+        output[i] = input[i] + constant;
+    }
+    static void multiply(const TValue* input, TValue* output, size_t count, TValue constant) {
+      for (size_t i = 0; i < count; ++i)
+        output[i] = input[i] * constant;
+    }
+    static void multiply_add(const TValue* input, TValue* output, size_t count, TValue factor, TValue addend) {
+      for (size_t i = 0; i < count; ++i)
+        output[i] = input[i] * factor + addend;
+    }
+    static void power(const TValue* input, TValue* output, size_t count, TValue exponent) {
+      for (size_t i = 0; i < count; ++i)
+        output[i] = std::pow(input[i], exponent);
+    }
+    static void integer_power(const TValue* input, TValue* output, size_t count, unsigned exponent) {
+      for (size_t i = 0; i < count; ++i)
+        output[i] = mathlab::simd::integer_power(input[i], exponent);
+    }
+    static void condition(const TValue* input, TValue* output, size_t count, TValue constant) {
+      for (size_t i = 0; i < count; ++i)
+        output[i] = input[i] < constant ? TValue(-1) : TValue(input[i] == constant ? 0 : 1);
+    }
+    static void select(const TValue* input, TValue* output, size_t count, TValue constant, TValue below, TValue equal, TValue above) {
+      for (size_t i = 0; i < count; ++i)
+        output[i] = input[i] < constant ? below : (input[i] == constant ? equal : above);
+    }
+    static void limit(const TValue* input, TValue* output, size_t count, TValue lower, TValue upper) {
+      for (size_t i = 0; i < count; ++i)
+        output[i] = std::clamp(input[i], lower, upper);
+    }
+    static void copy(const TValue* input, TValue* output, size_t count) {
+      if (input != output)
+        std::copy(input, input + count, output);
+    }
+  };
+
+#if MATHLAB_SIMD_X86
+#if defined(_MSC_VER)
+  bool cpu_supports(instruction_set set) {
+    int info[4];
+    __cpuid(info, 0);
+    const auto max_leaf = info[0];
+    __cpuid(info, 1);
+    const bool sse2 = (info[3] & (1 << 26)) != 0;
+    const bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    if (set == instruction_set::sse2)
+      return sse2;
+    if (max_leaf < 7 || !os_saves_ymm)
+      return false;
+    __cpuidex(info, 7, 0);
+    if (set == instruction_set::avx2)
+      return (info[1] & (1 << 5)) != 0;
+    // AVX-512 additionally requires OS support for opmask and upper zmm state
+    return (info[1] & (1 << 16)) != 0 && (_xgetbv(0) & 0xe6) == 0xe6;
+  }
+#else
+  bool cpu_supports(instruction_set set) {
+    __builtin_cpu_init();
+    switch (set) {
+    case instruction_set::sse2: return __builtin_cpu_supports("sse2");
+    case instruction_set::avx2: return __builtin_cpu_supports("avx2");
+    case instruction_set::avx512: return __builtin_cpu_supports("avx512f");
+    default: return false;
+    }
+  }
+#endif
+#endif
+}
+
+namespace mathlab {
+  namespace simd {
+    namespace detail {
+      template<typename TValue>
+      basic_kernel_table<TValue> scalar_table() {
+        using kernels = scalar<TValue>;
+        return { instruction_set::scalar, &kernels::copy, &kernels::add, &kernels::multiply, &kernels::multiply_add, &kernels::power,
+          &kernels::integer_power, &kernels::condition, &kernels::select, &kernels::limit };
+      }
+
+      const kernel_table& scalar_kernels() {
+        static const auto table = scalar_table<double>();
+        return table;
+      }
+
+      const float_kernel_table& scalar_float_kernels() {
+        static const auto table = scalar_table<float>();
+        return table;
+      }
+    }
+
+    bool is_supported(instruction_set set) {
+      if (set == instruction_set::scalar)
+        return true;
+#if MATHLAB_SIMD_X86
+      return cpu_supports(set);
+#else
+      return false;
+#endif
+    }
+
+    const kernel_table& kernels(instruction_set set) {
+      if (!is_supported(set))
+        throw std::invalid_argument(std::string("Instruction set is not supported: ") + name(set));
+      switch (set) {
+#if MATHLAB_SIMD_X86
+      case instruction_set::sse2: return detail::sse2_kernels();
+      case instruction_set::avx2: return detail::avx2_kernels();
+      case instruction_set::avx512: return detail::avx512_kernels();
+#endif
+      default: return detail::scalar_kernels();
+      }
+    }
+
+    const kernel_table& kernels() {
+      static const kernel_table& best = []() -> const kernel_table& {
+        for (auto set : { instruction_set::avx512, instruction_set::avx2, instruction_set::sse2 })
+          if (is_supported(set))
+            return kernels(set);
+        return detail::scalar_kernels();
+      }();
+      return best;
+    }
+
+    const float_kernel_table& float_kernels(instruction_set set) {
+      if (!is_supported(set))
+        throw std::invalid_argument(std::string("Instruction set is not supported: ") + name(set));
+      switch (set) {
+#if MATHLAB_SIMD_X86
+      case instruction_set::sse2: return detail::sse2_float_kernels();
+      case instruction_set::avx2: return detail::avx2_float_kernels();
+      case instruction_set::avx512: return detail::avx512_float_kernels();
+#endif
+      default: return detail::scalar_float_kernels();
+      }
+    }
+
+    const float_kernel_table& float_kernels() {
+      static const float_kernel_table& best = float_kernels(kernels().set);
+      return best;
+    }
+
+    const basic_kernel_table<long double>& long_double_kernels() {
+      static const auto table = detail::scalar_table<long double>();
+      return table;
+    }
+
+    const char* name(instruction_set set) {
+      switch (set) {
+      case instruction_set::sse2: return "sse2";
+      case instruction_set::avx2: return "avx2";
+      case instruction_set::avx512: return "avx512";
+      default: return "scalar";
+      }
+    }
+  }
+}
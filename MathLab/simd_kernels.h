@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MATHLAB_SIMD_X86 1
+#endif
+
+namespace mathlab {
+  namespace simd {
+    enum class instruction_set { scalar, sse2, avx2, avx512 };
+
+    // Batch kernels for supported block types over values of type TValue
+    // All kernels accept input and output pointing to the same buffer
+    template<typename TValue>
+    struct basic_kernel_table {
+      instruction_set set;
+      void (*copy)(const TValue* input, TValue* output, size_t count);
+      void (*add)(const TValue* input, TValue* output, size_t count, TValue constant);
+      void (*multiply)(const TValue* input, TValue* output, size_t count, TValue constant);
+      // input * factor + addend, rounded after multiplication and after addition (not fused)
+      void (*multiply_add)(const TValue* input, TValue* output, size_t count, TValue factor, TValue addend);
+      // Same results as std::pow, exponents 0 and 1 do not call it
+      void (*power)(const TValue* input, TValue* output, size_t count, TValue exponent);
+      // Exponent from 1 to 16 by repeated squaring, in the order of simd::integer_power in every table,
+      // which may differ from std::pow in the last bits
+      void (*integer_power)(const TValue* input, TValue* output, size_t count, unsigned exponent);
+      void (*condition)(const TValue* input, TValue* output, size_t count, TValue constant);
+      // below, equal or above where input is less than, equal to or greater than constant, NaN counts as greater
+      void (*select)(const TValue* input, TValue* output, size_t count, TValue constant, TValue below, TValue equal, TValue above);
+      void (*limit)(const TValue* input, TValue* output, size_t count, TValue lower, TValue upper);
+    };
+    using kernel_table = basic_kernel_table<double>;
+
+    // Power by repeated squaring, multiplications of vector kernels are done in this order
+    template<typename TValue>
+    TValue integer_power(TValue input, unsigned exponent) {
+      auto result = input;
+      auto base = input;
+      bool first = true;
+      for (unsigned bits = exponent; bits != 0; bits >>= 1) {
+        if (bits & 1u) {
+          result = first ? base : result * base;
+          first = false;
+        }
+        if (bits > 1)
+          base = base * base;
+      }
+      return result;
+    }
+    // Vectors hold twice as many floats as doubles
+    using float_kernel_table = basic_kernel_table<float>;
+
+    // Returns true if running CPU and OS support given instruction set
+    bool is_supported(instruction_set set);
+    // Returns kernels for given instruction set
+    // Throws invalid_argument if instruction set is not supported
+    const kernel_table& kernels(instruction_set set);
+    // Returns kernels for the best instruction set supported by running CPU, selected once
+    const kernel_table& kernels();
+    // Same for floats
+    const float_kernel_table& float_kernels(instruction_set set);
+    const float_kernel_table& float_kernels();
+    // Scalar kernels for long double, which has no vector instructions
+    const basic_kernel_table<long double>& long_double_kernels();
+    // Kernels of the best instruction set by value type, for code templated on it
+    template<typename TValue>
+    const basic_kernel_table<TValue>& kernels_of();
+    template<>
+    inline const kernel_table& kernels_of<double>() { return kernels(); }
+    template<>
+    inline const float_kernel_table& kernels_of<float>() { return float_kernels(); }
+    template<>
+    inline const basic_kernel_table<long double>& kernels_of<long double>() { return long_double_kernels(); }
+    const char* name(instruction_set set);
+  }
+}
@@ -0,0 +1,69 @@
+#include "simd_kernels.h"
+
+#if MATHLAB_SIMD_X86
+// Standard headers are included before target options change, so that their inline functions
+// are not compiled for the wider instruction set and then shared with the rest of the program
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <immintrin.h>
+// Kernels in this file are only called after runtime check for AVX2 support
+#if defined(__GNUC__) && !defined(__AVX2__)
+#pragma GCC target("avx2")
+#endif
+#include "simd_kernels_impl.h"
+
+namespace mathlab {
+  namespace simd {
+    namespace detail {
+      namespace {
+        struct avx2_vector {
+          using value = double;
+          using type = __m256d;
+          using mask = __m256d;
+          static constexpr size_t width = 4;
+          static type load(const double* from) { return _mm256_loadu_pd(from); }
+          static void store(double* to, type value) { _mm256_storeu_pd(to, value); }
+          static type broadcast(double value) { return _mm256_set1_pd(value); }
+          static type add(type a, type b) { return _mm256_add_pd(a, b); }
+          static type mul(type a, type b) { return _mm256_mul_pd(a, b); }
+          static type div(type a, type b) { return _mm256_div_pd(a, b); }
+          static type min(type a, type b) { return _mm256_min_pd(a, b); }
+          static type max(type a, type b) { return _mm256_max_pd(a, b); }
+          static mask less(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+          static mask equal(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+          static type select(mask m, type if_true, type if_false) { return _mm256_blendv_pd(if_false, if_true, m); }
+        };
+
+        struct avx2_float_vector {
+          using value = float;
+          using type = __m256;
+          using mask = __m256;
+          static constexpr size_t width = 8;
+          static type load(const float* from) { return _mm256_loadu_ps(from); }
+          static void store(float* to, type value) { _mm256_storeu_ps(to, value); }
+          static type broadcast(float value) { return _mm256_set1_ps(value); }
+          static type add(type a, type b) { return _mm256_add_ps(a, b); }
+          static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+          static type div(type a, type b) { return _mm256_div_ps(a, b); }
+          static type min(type a, type b) { return _mm256_min_ps(a, b); }
+          static type max(type a, type b) { return _mm256_max_ps(a, b); }
+          static mask less(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+          static mask equal(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+          static type select(mask m, type if_true, type if_false) { return _mm256_blendv_ps(if_false, if_true, m); }
+        };
+      }
+
+      const kernel_table& avx2_kernels() {
+        static const auto table = vector_kernels<avx2_vector>::table(instruction_set::avx2);
+        return table;
+      }
+
+      const float_kernel_table& avx2_float_kernels() {
+        static const auto table = vector_kernels<avx2_float_vector>::table(instruction_set::avx2);
+        return table;
+      }
+    }
+  }
+}
+#endif
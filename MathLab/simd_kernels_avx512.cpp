@@ -0,0 +1,73 @@
+#include "simd_kernels.h"
+
+#if MATHLAB_SIMD_X86
+// Standard headers are included before target options change, so that their inline functions
+// are not compiled for the wider instruction set and then shared with the rest of the program
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <immintrin.h>
+// Kernels in this file are only called after runtime check for AVX-512F support
+#if defined(__GNUC__) && !defined(__AVX512F__)
+#pragma GCC target("avx512f")
+#endif
+#if defined(__GNUC__) && !defined(__clang__)
+// _mm512_undefined_pd in GCC headers trips a false positive
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include "simd_kernels_impl.h"
+
+namespace mathlab {
+  namespace simd {
+    namespace detail {
+      namespace {
+        struct avx512_vector {
+          using value = double;
+          using type = __m512d;
+          using mask = __mmask8;
+          static constexpr size_t width = 8;
+          static type load(const double* from) { return _mm512_loadu_pd(from); }
+          static void store(double* to, type value) { _mm512_storeu_pd(to, value); }
+          static type broadcast(double value) { return _mm512_set1_pd(value); }
+          static type add(type a, type b) { return _mm512_add_pd(a, b); }
+          static type mul(type a, type b) { return _mm512_mul_pd(a, b); }
+          static type div(type a, type b) { return _mm512_div_pd(a, b); }
+          static type min(type a, type b) { return _mm512_min_pd(a, b); }
+          static type max(type a, type b) { return _mm512_max_pd(a, b); }
+          static mask less(type a, type b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+          static mask equal(type a, type b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+          static type select(mask m, type if_true, type if_false) { return _mm512_mask_blend_pd(m, if_false, if_true); }
+        };
+
+        struct avx512_float_vector {
+          using value = float;
+          using type = __m512;
+          using mask = __mmask16;
+          static constexpr size_t width = 16;
+          static type load(const float* from) { return _mm512_loadu_ps(from); }
+          static void store(float* to, type value) { _mm512_storeu_ps(to, value); }
+          static type broadcast(float value) { return _mm512_set1_ps(value); }
+          static type add(type a, type b) { return _mm512_add_ps(a, b); }
+          static type mul(type a, type b) { return _mm512_mul_ps(a, b); }
+          static type div(type a, type b) { return _mm512_div_ps(a, b); }
+          static type min(type a, type b) { return _mm512_min_ps(a, b); }
+          static type max(type a, type b) { return _mm512_max_ps(a, b); }
+          static mask less(type a, type b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+          static mask equal(type a, type b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+          static type select(mask m, type if_true, type if_false) { return _mm512_mask_blend_ps(m, if_false, if_true); }
+        };
+      }
+
+      const kernel_table& avx512_kernels() {
+        static const auto table = vector_kernels<avx512_vector>::table(instruction_set::avx512);
+        return table;
+      }
+
+      const float_kernel_table& avx512_float_kernels() {
+        static const auto table = vector_kernels<avx512_float_vector>::table(instruction_set::avx512);
+        return table;
+      }
+    }
+  }
+}
+#endif
@@ -0,0 +1,138 @@
+#pragma once
+#include "simd_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Kernel bodies shared by all vector instruction sets
+// Must be included after the instruction set is enabled for the including translation unit,
+// so that kernels are compiled with matching target options
+
+namespace mathlab {
+  namespace simd {
+    namespace detail {
+
+      // TVector wraps vectors of one value type for one instruction set and provides:
+      //  value, type, mask, width, load, store, broadcast, add, mul, div, min, max, less, equal, select
+      template<typename TVector>
+      struct vector_kernels {
+        using value = typename TVector::value;
+        using vector = typename TVector::type;
+
+        // Applies operation to whole vectors, the remainder is padded into one more vector
+        template<typename TOperation>
+        static void transform(const value* input, value* output, size_t count, TOperation operation) {
+          size_t i = 0;
+          for (; i + TVector::width <= count; i += TVector::width)
+            TVector::store(output + i, operation(TVector::load(input + i)));
+          if (i < count) {
+            value tail[TVector::width] = {};
+            std::copy(input + i, input + count, tail);
+            TVector::store(tail, operation(TVector::load(tail)));
+            std::copy(tail, tail + (count - i), output + i);
+          }
+        }
+
+        static void add(const value* input, value* output, size_t count, value constant) {
+          const auto c = TVector::broadcast(constant);
+          transform(input, output, count, [c](vector v) { return TVector::add(v, c); });
+        }
+
+        static void multiply(const value* input, value* output, size_t count, value constant) {
+          const auto c = TVector::broadcast(constant);
+          transform(input, output, count, [c](vector v) { return TVector::mul(v, c); });
+        }
+
+        static void multiply_add(const value* input, value* output, size_t count, value factor, value addend) {
+          const auto f = TVector::broadcast(factor);
+          const auto a = TVector::broadcast(addend);
+          transform(input, output, count, [&](vector v) { return TVector::add(TVector::mul(v, f), a); });
+        }
+
+        // Same results as std::clamp, given that lower <= upper
+        static void limit(const value* input, value* output, size_t count, value lower, value upper) {
+          if (!(lower <= upper)) {
+            for (size_t i = 0; i < count; ++i)
+              output[i] = std::clamp(input[i], lower, upper);
+            return;
+          }
+          const auto l = TVector::broadcast(lower);
+          const auto u = TVector::broadcast(upper);
+          // max and min return their second operand when one of them is NaN, so NaN input is passed through
+          transform(input, output, count, [l, u](vector v) { return TVector::min(u, TVector::max(l, v)); });
+        }
+
+        static void condition(const value* input, value* output, size_t count, value constant) {
+          const auto c = TVector::broadcast(constant);
+          const auto minus_one = TVector::broadcast(value(-1));
+          const auto zero = TVector::broadcast(value(0));
+          const auto one = TVector::broadcast(value(1));
+          transform(input, output, count, [&](vector v) {
+            return TVector::select(TVector::less(v, c), minus_one, TVector::select(TVector::equal(v, c), zero, one));
+          });
+        }
+
+        static void select(const value* input, value* output, size_t count, value constant, value below, value equal, value above) {
+          const auto c = TVector::broadcast(constant);
+          const auto b = TVector::broadcast(below);
+          const auto e = TVector::broadcast(equal);
+          const auto a = TVector::broadcast(above);
+          transform(input, output, count, [&](vector v) {
+            return TVector::select(TVector::less(v, c), b, TVector::select(TVector::equal(v, c), e, a));
+          });
+        }
+
+        static void power(const value* input, value* output, size_t count, value exponent) {
+          if (exponent == 0.) {
+            std::fill(output, output + count, value(1));
+          }
+          else if (exponent == 1.) {
+            std::copy(input, input + count, output);
+          }
+          // sqrt and repeated squaring are not always the results of std::pow, which blocks evaluate one by one
+          else {
+            for (size_t i = 0; i < count; ++i)
+              output[i] = std::pow(input[i], exponent);
+          }
+        }
+
+        static void integer_power(const value* input, value* output, size_t count, unsigned exponent) {
+          transform(input, output, count, [exponent](vector v) {
+            auto result = v;
+            auto base = v;
+            bool first = true;
+            for (unsigned bits = exponent; bits != 0; bits >>= 1) {
+              if (bits & 1u) {
+                result = first ? base : TVector::mul(result, base);
+                first = false;
+              }
+              if (bits > 1)
+                base = TVector::mul(base, base);
+            }
+            return result;
+          });
+        }
+
+        static void copy(const value* input, value* output, size_t count) {
+          if (input != output)
+            std::copy(input, input + count, output);
+        }
+
+        static basic_kernel_table<value> table(instruction_set set) {
+          return { set, &copy, &add, &multiply, &multiply_add, &power, &integer_power, &condition, &select, &limit };
+        }
+      };
+
+      const kernel_table& scalar_kernels();
+      const float_kernel_table& scalar_float_kernels();
+#if MATHLAB_SIMD_X86
+      const kernel_table& sse2_kernels();
+      const kernel_table& avx2_kernels();
+      const kernel_table& avx512_kernels();
+      const float_kernel_table& sse2_float_kernels();
+      const float_kernel_table& avx2_float_kernels();
+      const float_kernel_table& avx512_float_kernels();
+#endif
+    }
+  }
+}
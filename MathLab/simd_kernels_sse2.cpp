@@ -0,0 +1,60 @@
+#include "simd_kernels_impl.h"
+
+#if MATHLAB_SIMD_X86
+#include <emmintrin.h>
+
+namespace mathlab {
+  namespace simd {
+    namespace detail {
+      namespace {
+        struct sse2_vector {
+          using value = double;
+          using type = __m128d;
+          using mask = __m128d;
+          static constexpr size_t width = 2;
+          static type load(const double* from) { return _mm_loadu_pd(from); }
+          static void store(double* to, type value) { _mm_storeu_pd(to, value); }
+          static type broadcast(double value) { return _mm_set1_pd(value); }
+          static type add(type a, type b) { return _mm_add_pd(a, b); }
+          static type mul(type a, type b) { return _mm_mul_pd(a, b); }
+          static type div(type a, type b) { return _mm_div_pd(a, b); }
+          static type min(type a, type b) { return _mm_min_pd(a, b); }
+          static type max(type a, type b) { return _mm_max_pd(a, b); }
+          static mask less(type a, type b) { return _mm_cmplt_pd(a, b); }
+          static mask equal(type a, type b) { return _mm_cmpeq_pd(a, b); }
+          // SSE2 has no blend instruction
+          static type select(mask m, type if_true, type if_false) { return _mm_or_pd(_mm_and_pd(m, if_true), _mm_andnot_pd(m, if_false)); }
+        };
+
+        struct sse2_float_vector {
+          using value = float;
+          using type = __m128;
+          using mask = __m128;
+          static constexpr size_t width = 4;
+          static type load(const float* from) { return _mm_loadu_ps(from); }
+          static void store(float* to, type value) { _mm_storeu_ps(to, value); }
+          static type broadcast(float value) { return _mm_set1_ps(value); }
+          static type add(type a, type b) { return _mm_add_ps(a, b); }
+          static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+          static type div(type a, type b) { return _mm_div_ps(a, b); }
+          static type min(type a, type b) { return _mm_min_ps(a, b); }
+          static type max(type a, type b) { return _mm_max_ps(a, b); }
+          static mask less(type a, type b) { return _mm_cmplt_ps(a, b); }
+          static mask equal(type a, type b) { return _mm_cmpeq_ps(a, b); }
+          static type select(mask m, type if_true, type if_false) { return _mm_or_ps(_mm_and_ps(m, if_true), _mm_andnot_ps(m, if_false)); }
+        };
+      }
+
+      const kernel_table& sse2_kernels() {
+        static const auto table = vector_kernels<sse2_vector>::table(instruction_set::sse2);
+        return table;
+      }
+
+      const float_kernel_table& sse2_float_kernels() {
+        static const auto table = vector_kernels<sse2_float_vector>::table(instruction_set::sse2);
+        return table;
+      }
+    }
+  }
+}
+#endif
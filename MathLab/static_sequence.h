@@ -0,0 +1,118 @@
+#pragma once
+#include "blocks.h"
+#include <array>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace mathlab {
+
+  // Sequence of blocks fixed at compile time, e.g. static_sequence<addition, multiplication, limit>
+  // Holds only constants of blocks and evaluates them without virtual calls, so the whole sequence can be inlined
+  // Text format is the same as for block_sequence with blocks registered by register_all_blocks
+  // Values have the value type of the blocks, e.g. static_sequence<basic_addition<float>, basic_limit<float>> evaluates floats
+  template<typename ...TBlocks>
+  class static_sequence {
+  public:
+    // double for a sequence without blocks
+    using value_type = typename std::tuple_element_t<0, std::tuple<TBlocks..., identity>>::value_type;
+    static_assert((std::is_same_v<typename TBlocks::value_type, value_type> && ...), "Blocks must have the same value type");
+  private:
+    std::tuple<typename TBlocks::constants_type...> constants_;
+    using blocks = std::tuple<TBlocks...>;
+    using constants_tuple = std::tuple<typename TBlocks::constants_type...>;
+    using indices = std::index_sequence_for<TBlocks...>;
+  public:
+    static_sequence() = default;
+    explicit static_sequence(typename TBlocks::constants_type... constants) : constants_(std::move(constants)...) {}
+
+    value_type eval(value_type input) const {
+      return eval(input, indices());
+    }
+
+    // Input and output may point to the same buffer
+    void eval_batch(const value_type* input, value_type* output, size_t count) const {
+      for (size_t i = 0; i < count; ++i)
+        output[i] = eval(input[i], indices());
+    }
+
+    // Loads constants of all blocks from stream, one block per line, empty lines are skipped
+    // Lines are parsed like block_sequence::load_from does; constants are left unchanged if loading fails
+    // Throws invalid_argument with the invalid lines, those with another block type, with constants that are not
+    // whole numbers or past the last block, or naming the first block that is missing
+    void load_from(std::istream& input_stream) {
+      std::ostringstream text;
+      text << input_stream.rdbuf();
+      load_from(text.str());
+    }
+
+    void load_from(std::string_view text) {
+      constants_tuple loaded;
+      std::string invalid_lines;
+      size_t position = 0;
+      while (!text.empty()) {
+        const auto end = std::min(text.find('\n'), text.size());
+        const auto line = text.substr(0, end);
+        text.remove_prefix(std::min(end + 1, text.size()));
+        auto constants = line;
+        const auto block_type = next_token(constants);
+        if (block_type.empty())
+          continue;
+        if (!load_block(position++, block_type, constants, loaded, indices()))
+          invalid_lines.append(line).append("\n");
+      }
+      if (!invalid_lines.empty())
+        throw std::invalid_argument("Invalid lines:\n" + invalid_lines);
+      if (position < sizeof...(TBlocks))
+        throw std::invalid_argument(std::string("Expected block ") + type_names[position] + " at position " + std::to_string(position + 1));
+      constants_ = std::move(loaded);
+    }
+
+    // Same output as block_sequence::dump without line numbers
+    std::ostream& dump(std::ostream& to_stream) const {
+      dump(to_stream, indices());
+      return to_stream;
+    }
+
+    template<size_t I>
+    const auto& constants() const { return std::get<I>(constants_); }
+
+  private:
+    template<size_t I>
+    using block_at = std::tuple_element_t<I, blocks>;
+    static constexpr std::array<const char*, sizeof...(TBlocks)> type_names = { TBlocks::type_name... };
+
+    template<size_t I>
+    value_type eval_block(value_type input) const {
+      return std::apply([input](const auto&... constants) {
+        return typename block_at<I>::function_type()(input, constants...);
+      }, std::get<I>(constants_));
+    }
+
+    template<size_t ...I>
+    value_type eval(value_type input, std::index_sequence<I...>) const {
+      ((input = eval_block<I>(input)), ...);
+      return input;
+    }
+
+    // False if block at position has another type, its constants can not be parsed or there is no block at position
+    template<size_t ...I>
+    static bool load_block(size_t position, std::string_view block_type, std::string_view constants, constants_tuple& to, std::index_sequence<I...>) {
+      bool loaded = false;
+      ((loaded = loaded || (I == position && block_type == block_at<I>::type_name
+        && tuple_serialization_of<typename block_at<I>::constants_type>::parse(constants, std::get<I>(to)))), ...);
+      return loaded;
+    }
+
+    template<size_t ...I>
+    void dump(std::ostream& to_stream, std::index_sequence<I...>) const {
+      ((to_stream << block_at<I>::type_name << ' ', tuple_serialization_of<typename block_at<I>::constants_type>::serialize(to_stream, std::get<I>(constants_)), to_stream << std::endl), ...);
+    }
+  };
+}
@@ -0,0 +1,40 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace mathlab {
+
+  thread_pool::thread_pool(unsigned thread_count) {
+    threads_.reserve(thread_count);
+    for (unsigned i = 0; i < thread_count; ++i)
+      threads_.emplace_back([this]() { run(); });
+  }
+
+  thread_pool::~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    task_available_.notify_all();
+    for (auto& thread : threads_)
+      thread.join();
+  }
+
+  void thread_pool::run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        task_available_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+        if (tasks_.empty())
+          return;
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  unsigned default_thread_count() {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mathlab {
+
+  // Fixed number of threads running submitted tasks in submission order
+  class thread_pool {
+    std::vector<std::thread> threads_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable task_available_;
+    bool stopping_ = false;
+  public:
+    explicit thread_pool(unsigned thread_count);
+    // Runs all queued tasks and joins threads
+    ~thread_pool();
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // Returned future holds result or exception of the function
+    template<typename TFunction>
+    auto submit(TFunction function) -> std::future<decltype(function())> {
+      auto task = std::make_shared<std::packaged_task<decltype(function())()>>(std::move(function));
+      auto result = task->get_future();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.emplace_back([task]() { (*task)(); });
+      }
+      task_available_.notify_one();
+      return result;
+    }
+
+    size_t size() const { return threads_.size(); }
+  private:
+    void run();
+  };
+
+  // Number of threads used when none is configured, at least 1
+  unsigned default_thread_count();
+
+  // Processes a stream of chunks on thread_count threads and consumes results in the order of chunks
+  //  produce() - returns std::optional chunk, empty at the end, called on the calling thread
+  //  process(chunk) - called on worker threads
+  //  consume(result) - called on the calling thread in the order in which chunks were produced
+  // At most 2 * thread_count chunks are in flight, with 1 thread everything runs on the calling thread
+  // Exception from process is rethrown after results of all previous chunks are consumed
+  template<typename TProduce, typename TProcess, typename TConsume>
+  void run_ordered(unsigned thread_count, TProduce produce, TProcess process, TConsume consume) {
+    if (thread_count <= 1) {
+      while (auto chunk = produce())
+        consume(process(std::move(*chunk)));
+      return;
+    }
+    using chunk_type = typename decltype(produce())::value_type;
+    using result_type = decltype(process(std::declval<chunk_type>()));
+    thread_pool pool(thread_count);
+    std::deque<std::future<result_type>> in_flight;
+    while (auto chunk = produce()) {
+      in_flight.push_back(pool.submit([&process, chunk = std::move(*chunk)]() mutable { return process(std::move(chunk)); }));
+      if (in_flight.size() >= 2 * size_t(thread_count)) {
+        consume(in_flight.front().get());
+        in_flight.pop_front();
+      }
+    }
+    for (; !in_flight.empty(); in_flight.pop_front())
+      consume(in_flight.front().get());
+  }
+}
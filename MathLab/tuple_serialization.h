@@ -1,9 +1,59 @@
 #pragma once
+#include <charconv>
 #include <stdexcept>
 #include <typeinfo>
+#include <istream>
 #include <ostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 
 namespace mathlab {
+
+  inline bool is_space(char character) {
+    return character == ' ' || character == '\t' || character == '\r' || character == '\n' || character == '\v' || character == '\f';
+  }
+
+  // Removes leading whitespace and returns the following token, empty if there is none
+  inline std::string_view next_token(std::string_view& text) {
+    size_t begin = 0;
+    while (begin < text.size() && is_space(text[begin]))
+      ++begin;
+    auto end = begin;
+    while (end < text.size() && !is_space(text[end]))
+      ++end;
+    const auto token = text.substr(begin, end - begin);
+    text.remove_prefix(end);
+    return token;
+  }
+
+  // Parses next token of text as a whole number, optionally preceded by '+' as accepted by streams
+  // Returns false if the token is missing, is not a number or is out of range
+  template<typename T>
+  bool parse_token(std::string_view& text, T& value) {
+    auto token = next_token(text);
+    if (token.size() > 1 && token[0] == '+' && token[1] != '-' && token[1] != '+')
+      token.remove_prefix(1);
+    const auto last = token.data() + token.size();
+    const auto result = std::from_chars(token.data(), last, value);
+    return !token.empty() && result.ec == std::errc() && result.ptr == last;
+  }
+
+  // Writes value followed by a space, numbers in the shortest text that parse_token reads back to the same value
+  // (streams would round them to 6 digits)
+  template<typename T>
+  void write_token(std::ostream& to, const T& value) {
+    if constexpr (std::is_arithmetic_v<T>) {
+      char text[64];
+      const auto result = std::to_chars(text, text + sizeof(text), value);
+      to.write(text, result.ptr - text);
+    }
+    else {
+      to << value;
+    }
+    to << ' ';
+  }
   
   // Tuple serialization / de-serialization
   // Type arguments:
@@ -12,11 +62,11 @@ namespace mathlab {
   template<size_t N, typename ...TArgs>
   struct tuple_serialization {
 
-    // Serializes first N tuple members to output stream
+    // Serializes first N tuple members to output stream by write_token
     // A space is added after each member
     static void serialize(std::ostream& to, const std::tuple<TArgs...>& from) {
       tuple_serialization<N - 1, TArgs...>::serialize(to, from);
-      to << std::get<N - 1>(from) << ' ';
+      write_token(to, std::get<N - 1>(from));
     }
 
     // De-serializes first N tuple members from input stream
@@ -30,15 +80,29 @@ namespace mathlab {
         throw std::invalid_argument(std::string("Unable to read object from stream. Object type: ") + typeid(type_n).name());
       std::get<N - 1>(to) = object;
     }
+
+    // Parses first N tuple members from whitespace separated tokens at the beginning of text and advances text past them
+    // Returns false without throwing when a token is missing or is not a whole number
+    static bool parse(std::string_view& from, std::tuple<TArgs...>& to) {
+      return tuple_serialization<N - 1, TArgs...>::parse(from, to) && parse_token(from, std::get<N - 1>(to));
+    }
   };
 
   // Specialization for empty tuple, doing nothing
   template<typename ...TArgs>
   struct tuple_serialization<0, TArgs...> {
-    static void serialize(std::ostream& to, const std::tuple<TArgs...>& from) {}
-    static void deserialize(std::istream& from, std::tuple<TArgs...>& to) {}
+    static void serialize(std::ostream&, const std::tuple<TArgs...>&) {}
+    static void deserialize(std::istream&, std::tuple<TArgs...>&) {}
+    static bool parse(std::string_view&, std::tuple<TArgs...>&) { return true; }
   };
 
+  // Serialization of std::tuple type, e.g. tuple_serialization_of<std::tuple<double, int>>
+  template<typename TTuple>
+  struct tuple_serialization_of;
+
+  template<typename ...TArgs>
+  struct tuple_serialization_of<std::tuple<TArgs...>> : tuple_serialization<sizeof...(TArgs), TArgs...> {};
+
   // Helper function for constructing an object of type TBlock, using variable constructor arguments
   template<typename T, typename ...TArgs>
   T* create(TArgs ...args) {
@@ -0,0 +1,167 @@
+#include "value_io.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace {
+  // Parses number that starts at first and ends at last or at a separator, returns position after the number
+  template<typename TValue>
+  const char* parse_number(const char* first, const char* last, TValue& value) {
+    auto number = first;
+    // from_chars does not accept leading plus
+    if (last - number > 1 && *number == '+' && number[1] != '-')
+      ++number;
+    const auto result = std::from_chars(number, last, value);
+    if ((result.ec != std::errc() && result.ec != std::errc::result_out_of_range) || (result.ptr != last && !mathlab::is_separator(*result.ptr)))
+      throw std::invalid_argument("Invalid number " + std::string(first, std::find_if(first, last, mathlab::is_separator)));
+    // Overflow and underflow give infinity and zero as with strtod
+    if (result.ec == std::errc::result_out_of_range) {
+      const auto text = std::string(first, result.ptr);
+      if constexpr (std::is_same_v<TValue, float>)
+        value = std::strtof(text.c_str(), nullptr);
+      else if constexpr (std::is_same_v<TValue, double>)
+        value = std::strtod(text.c_str(), nullptr);
+      else
+        value = std::strtold(text.c_str(), nullptr);
+    }
+    return result.ptr;
+  }
+}
+
+namespace mathlab {
+
+  std::optional<precision> parse_precision(std::string_view name) {
+    for (auto value : { precision::f32, precision::f64, precision::f80 })
+      if (name == mathlab::name(value))
+        return value;
+    return std::nullopt;
+  }
+
+  const char* name(precision value) {
+    switch (value) {
+    case precision::f32: return "f32";
+    case precision::f80: return "f80";
+    default: return "f64";
+    }
+  }
+
+  sweep_range make_sweep_range(double start, double stop, double step) {
+    const auto steps = (stop - start) / step;
+    if (!std::isfinite(start) || !std::isfinite(stop) || !std::isfinite(step) || step == 0. || !(steps >= 0.))
+      throw std::invalid_argument("Invalid range, values must be finite and step must lead from start to stop");
+    // Quotient may be an ulp below a whole number of steps, e.g. 0.3 / 0.1
+    const auto whole_steps = std::floor(steps + (steps + 1.) * 64 * std::numeric_limits<double>::epsilon());
+    if (whole_steps >= std::ldexp(1., 53))
+      throw std::invalid_argument("Too many values in range");
+    return { start, step, static_cast<size_t>(whole_steps) + 1 };
+  }
+
+  template<typename TValue>
+  void fill_range(const sweep_range& range, size_t first, TValue* values, size_t count) {
+    // Float is computed in double, so that indices above 2^24 stay distinct
+    using compute_type = std::conditional_t<(sizeof(TValue) > sizeof(double)), TValue, double>;
+    const auto start = static_cast<compute_type>(range.start);
+    const auto step = static_cast<compute_type>(range.step);
+    for (size_t i = 0; i < count; ++i)
+      values[i] = static_cast<TValue>(start + static_cast<compute_type>(first + i) * step);
+  }
+
+  template<typename TValue>
+  text_parse_result parse_text(const char* first, const char* last, bool at_end, TValue* values, size_t capacity) {
+    // Number after the last separator may continue in the next chunk
+    auto end = last;
+    if (!at_end) {
+      while (end != first && !is_separator(end[-1]))
+        --end;
+    }
+    size_t count = 0;
+    auto position = first;
+    while (count < capacity) {
+      while (position != end && is_separator(*position))
+        ++position;
+      if (position == end)
+        break;
+      position = parse_number(position, end, values[count++]);
+    }
+    return { position, count };
+  }
+
+  template<typename TValue>
+  char* format_value(TValue value, char* to) {
+    const auto result = std::to_chars(to, to + max_formatted_size - 1, value);
+    *result.ptr = '\n';
+    return result.ptr + 1;
+  }
+
+  text_reader::text_reader(std::istream& input, size_t buffer_size)
+    : input_(&input), buffer_(buffer_size), position_(buffer_.data()), end_(buffer_.data()), at_end_(false) {}
+
+  text_reader::text_reader(const char* first, const char* last) : position_(first), end_(last), at_end_(true) {}
+
+  template<typename TValue>
+  size_t text_reader::read(TValue* values, size_t capacity) {
+    size_t count = 0;
+    while (count < capacity) {
+      const auto result = parse_text(position_, end_, at_end_, values + count, capacity - count);
+      count += result.count;
+      position_ = result.next;
+      if (count == capacity || at_end_)
+        break;
+      fill();
+    }
+    return count;
+  }
+
+  // Moves unparsed text to the beginning of the buffer and reads the next chunk after it
+  void text_reader::fill() {
+    const auto remaining = static_cast<size_t>(end_ - position_);
+    if (remaining == buffer_.size())
+      throw std::invalid_argument("Invalid number " + std::string(position_, std::min<size_t>(remaining, 64)) + "...");
+    std::copy(position_, end_, buffer_.data());
+    input_->read(buffer_.data() + remaining, static_cast<std::streamsize>(buffer_.size() - remaining));
+    position_ = buffer_.data();
+    end_ = buffer_.data() + remaining + input_->gcount();
+    at_end_ = !*input_;
+  }
+
+  text_writer::text_writer(std::ostream& output, size_t buffer_size) : output_(output), buffer_(std::max(buffer_size, max_formatted_size)) {}
+
+  text_writer::~text_writer() {
+    flush();
+  }
+
+  template<typename TValue>
+  void text_writer::write(const TValue* values, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      if (buffer_.size() - used_ < max_formatted_size)
+        flush();
+      used_ = static_cast<size_t>(format_value(values[i], buffer_.data() + used_) - buffer_.data());
+    }
+  }
+
+  void text_writer::flush() {
+    output_.write(buffer_.data(), static_cast<std::streamsize>(used_));
+    used_ = 0;
+  }
+
+  template text_parse_result parse_text(const char* first, const char* last, bool at_end, float* values, size_t capacity);
+  template text_parse_result parse_text(const char* first, const char* last, bool at_end, double* values, size_t capacity);
+  template text_parse_result parse_text(const char* first, const char* last, bool at_end, long double* values, size_t capacity);
+  template char* format_value(float value, char* to);
+  template char* format_value(double value, char* to);
+  template char* format_value(long double value, char* to);
+  template size_t text_reader::read(float* values, size_t capacity);
+  template size_t text_reader::read(double* values, size_t capacity);
+  template size_t text_reader::read(long double* values, size_t capacity);
+  template void text_writer::write(const float* values, size_t count);
+  template void text_writer::write(const double* values, size_t count);
+  template void text_writer::write(const long double* values, size_t count);
+  template void fill_range(const sweep_range& range, size_t first, float* values, size_t count);
+  template void fill_range(const sweep_range& range, size_t first, double* values, size_t count);
+  template void fill_range(const sweep_range& range, size_t first, long double* values, size_t count);
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace mathlab {
+
+  // Type of values in files and in evaluation
+  //  f32 - float, f64 - double, f80 - long double, x87 extended precision with GCC and Clang on x86, double with MSVC
+  enum class precision { f32, f64, f80 };
+
+  template<typename TValue>
+  constexpr precision precision_of();
+  template<>
+  constexpr precision precision_of<float>() { return precision::f32; }
+  template<>
+  constexpr precision precision_of<double>() { return precision::f64; }
+  template<>
+  constexpr precision precision_of<long double>() { return precision::f80; }
+
+  // Name as accepted by --precision, nullopt for other names
+  std::optional<precision> parse_precision(std::string_view name);
+  const char* name(precision value);
+
+  // Size of chunks read from and written to streams
+  constexpr size_t text_buffer_size = 1 << 20;
+  // Longest text of one value written by format_value, including newline
+  constexpr size_t max_formatted_size = 32;
+
+  // Characters that separate numbers in text
+  inline bool is_separator(char character) {
+    return character == ' ' || character == '\n' || character == '\r' || character == '\t' || character == '\v' || character == '\f';
+  }
+
+  struct text_parse_result {
+    // Position after the last parsed value
+    const char* next;
+    size_t count;
+  };
+
+  // Parses up to capacity whitespace separated numbers from [first, last) with std::from_chars, independent of locale
+  // A number that ends at last is left unparsed unless at_end is set, because it may continue in the next chunk
+  // Throws invalid_argument on text that is not a number
+  // Functions templated on TValue are defined for float, double and long double
+  template<typename TValue>
+  text_parse_result parse_text(const char* first, const char* last, bool at_end, TValue* values, size_t capacity);
+
+  // Writes the shortest text that parses back to the same value and a newline, returns position after the newline
+  // to must have room for max_formatted_size characters
+  template<typename TValue>
+  char* format_value(TValue value, char* to);
+
+  // Regular grid of count values start, start + step, ..., generated instead of read from input
+  struct sweep_range {
+    double start;
+    double step;
+    size_t count;
+  };
+
+  // Range from start to stop, stop is included when it is within rounding error of a step
+  // Throws invalid_argument if a value is not finite, step is zero or leads away from stop, or there are more than 2^53 values
+  sweep_range make_sweep_range(double start, double stop, double step);
+  // Writes count values of range from index first, each computed from its index so that rounding errors do not add up
+  template<typename TValue>
+  void fill_range(const sweep_range& range, size_t first, TValue* values, size_t count);
+
+  // Reads numbers from text in a stream or in memory
+  class text_reader {
+    std::istream* input_ = nullptr;
+    std::vector<char> buffer_;
+    const char* position_;
+    const char* end_;
+    bool at_end_;
+  public:
+    // Reads stream in chunks of buffer_size bytes, numbers must be shorter than a chunk
+    explicit text_reader(std::istream& input, size_t buffer_size = text_buffer_size);
+    // Reads text in memory, e.g. from a mapped_file
+    text_reader(const char* first, const char* last);
+    text_reader(const text_reader&) = delete;
+    text_reader& operator=(const text_reader&) = delete;
+
+    // Parses up to capacity numbers, returns number of parsed values or 0 at the end of input
+    // Throws invalid_argument on text that is not a number
+    template<typename TValue>
+    size_t read(TValue* values, size_t capacity);
+  private:
+    void fill();
+  };
+
+  // Writes values one per line through a buffer of buffer_size bytes
+  class text_writer {
+    std::ostream& output_;
+    std::vector<char> buffer_;
+    size_t used_ = 0;
+  public:
+    explicit text_writer(std::ostream& output, size_t buffer_size = text_buffer_size);
+    ~text_writer();
+    text_writer(const text_writer&) = delete;
+    text_writer& operator=(const text_writer&) = delete;
+
+    template<typename TValue>
+    void write(const TValue* values, size_t count);
+    // Writes buffered text to the stream
+    void flush();
+  };
+}
@@ -0,0 +1,277 @@
+// Benchmarks of the evaluation engine, results are written as JSON
+// Usage: MathLabBench [--filter text] [--min-time seconds] [--out file]
+#include "block_sequence.h"
+#include "factory.h"
+#include "mapped_file.h"
+#include "parallel_evaluation.h"
+#include "simd_kernels.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+  using clock_type = std::chrono::steady_clock;
+
+  struct result {
+    std::string name;
+    size_t iterations;
+    double seconds_per_iteration;
+    // Values, lines or bytes processed by one iteration
+    double items_per_iteration;
+    std::string item_name;
+  };
+
+  struct settings {
+    std::string filter;
+    double min_time = 0.5;
+    std::string output_path;
+  };
+
+  // Keeps results of benchmarked code alive
+  volatile double sink;
+
+  class benchmark_runner {
+    const settings& settings_;
+    std::vector<result> results_;
+  public:
+    explicit benchmark_runner(const settings& settings) : settings_(settings) {}
+
+    // Runs function in batches of doubling size until min_time is reached, reports the fastest of 3 repetitions
+    void run(const std::string& name, double items_per_iteration, const std::string& item_name, const std::function<void()>& function) {
+      if (name.find(settings_.filter) == std::string::npos)
+        return;
+      function();
+      size_t iterations = 1;
+      double seconds = 0;
+      while ((seconds = measure(function, iterations)) < settings_.min_time / 3 && iterations < (size_t(1) << 40))
+        iterations *= 2;
+      for (int repetition = 0; repetition < 2; ++repetition)
+        seconds = std::min(seconds, measure(function, iterations));
+      results_.push_back({ name, iterations, seconds / iterations, items_per_iteration, item_name });
+      std::cerr << name << ": " << results_.back().seconds_per_iteration * 1e9 / items_per_iteration << " ns per " << item_name << std::endl;
+    }
+
+    std::ostream& dump_json(std::ostream& to_stream) const {
+      to_stream << "{\n  \"context\": {\n";
+      to_stream << "    \"instruction_set\": \"" << mathlab::simd::name(mathlab::simd::kernels().set) << "\",\n";
+      to_stream << "    \"hardware_threads\": " << mathlab::default_thread_count() << ",\n";
+      to_stream << "    \"min_time\": " << settings_.min_time << "\n  },\n";
+      to_stream << "  \"benchmarks\": [";
+      for (size_t i = 0; i < results_.size(); ++i) {
+        const auto& entry = results_[i];
+        to_stream << (i == 0 ? "\n" : ",\n");
+        to_stream << "    { \"name\": \"" << entry.name << "\", \"iterations\": " << entry.iterations
+          << ", \"ns_per_iteration\": " << entry.seconds_per_iteration * 1e9
+          << ", \"ns_per_item\": " << entry.seconds_per_iteration * 1e9 / entry.items_per_iteration
+          << ", \"items_per_second\": " << entry.items_per_iteration / entry.seconds_per_iteration
+          << ", \"item\": \"" << entry.item_name << "\" }";
+      }
+      to_stream << "\n  ]\n}\n";
+      return to_stream;
+    }
+
+  private:
+    static double measure(const std::function<void()>& function, size_t iterations) {
+      const auto start = clock_type::now();
+      for (size_t i = 0; i < iterations; ++i)
+        function();
+      return std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+  };
+
+  std::vector<double> random_values(size_t count, double lower, double upper) {
+    std::mt19937_64 generator(42);
+    std::uniform_real_distribution<double> distribution(lower, upper);
+    std::vector<double> values(count);
+    for (auto& value : values)
+      value = distribution(generator);
+    return values;
+  }
+
+  // Sequence text with depth blocks that keep values in a moderate range
+  std::string sequence_text(size_t depth) {
+    static const char* const lines[] = { "addition 0.5", "multiplication 0.999", "limit -100 100", "addition -0.25", "multiplication 1.001", "identity" };
+    std::string text;
+    for (size_t i = 0; i < depth; ++i)
+      text += std::string(lines[i % 6]) + "\n";
+    return text;
+  }
+
+  void load(mathlab::block_sequence& sequence, const std::string& text) {
+    std::istringstream input(text);
+    sequence.load_from(input);
+  }
+
+  void block_benchmarks(benchmark_runner& runner, mathlab::factory& factory) {
+    static const char* const blocks[] = { "identity", "addition 2.5", "multiplication 1.5", "power 3", "condition 0.5", "limit -0.5 0.5" };
+    const auto values = random_values(4096, -1., 1.);
+    std::vector<double> output(values.size());
+    for (auto text : blocks) {
+      std::istringstream line(text);
+      std::string type;
+      line >> type;
+      auto block = factory.create(type, line);
+      runner.run("block/eval/" + type, static_cast<double>(values.size()), "value", [&]() {
+        double sum = 0;
+        for (auto value : values)
+          sum += block->eval(value);
+        sink = sum;
+      });
+      runner.run("block/eval_batch/" + type, static_cast<double>(values.size()), "value", [&]() {
+        block->eval_batch(values.data(), output.data(), output.size());
+        sink = output[0];
+      });
+    }
+  }
+
+  void depth_benchmarks(benchmark_runner& runner, mathlab::factory& factory) {
+    const auto values = random_values(4096, -10., 10.);
+    std::vector<double> output(values.size());
+    for (size_t depth : { 1, 10, 100, 1000 }) {
+      const auto suffix = "/depth:" + std::to_string(depth);
+      mathlab::block_sequence sequence(factory);
+      load(sequence, sequence_text(depth));
+      const auto items = static_cast<double>(values.size());
+      runner.run("sequence/eval" + suffix, items, "value", [&]() {
+        double sum = 0;
+        for (auto value : values)
+          sum += sequence.eval(value);
+        sink = sum;
+      });
+      runner.run("sequence/eval_batch" + suffix, items, "value", [&]() {
+        sequence.eval_batch(values.data(), output.data(), output.size());
+        sink = output[0];
+      });
+      sequence.set_optimization(mathlab::optimization_level::none);
+      runner.run("sequence/eval_batch_unoptimized" + suffix, items, "value", [&]() {
+        sequence.eval_batch(values.data(), output.data(), output.size());
+        sink = output[0];
+      });
+      sequence.set_optimization(mathlab::optimization_level::exact);
+      sequence.set_jit(true);
+      if (sequence.jit() != nullptr) {
+        runner.run("sequence/eval_batch_jit" + suffix, items, "value", [&]() {
+          sequence.eval_batch(values.data(), output.data(), output.size());
+          sink = output[0];
+        });
+      }
+    }
+  }
+
+  // Inputs quantized to a few thousand distinct values, as read from sensors
+  void cache_benchmarks(benchmark_runner& runner, mathlab::factory& factory) {
+    auto values = random_values(1 << 16, 0., 100.);
+    for (auto& value : values)
+      value = std::round(value * 40.) / 40.;
+    std::vector<double> output(values.size());
+    mathlab::block_sequence sequence(factory);
+    load(sequence, "addition 1\npower 1.7\nmultiplication 0.5\npower 0.3\n");
+    const auto items = static_cast<double>(values.size());
+    for (bool cached : { false, true }) {
+      sequence.set_cache(cached);
+      runner.run(cached ? "sequence/eval_batch_cached/distinct:4001" : "sequence/eval_batch/distinct:4001", items, "value", [&]() {
+        sequence.eval_batch(values.data(), output.data(), output.size());
+        sink = output[0];
+      });
+    }
+  }
+
+  void parse_benchmarks(benchmark_runner& runner, mathlab::factory& factory) {
+    const size_t lines = 1000;
+    const auto text = sequence_text(lines);
+    runner.run("parse/load_from", static_cast<double>(lines), "line", [&]() {
+      mathlab::block_sequence sequence(factory);
+      load(sequence, text);
+    });
+    mathlab::block_sequence sequence(factory);
+    runner.run("parse/append_from", static_cast<double>(lines), "line", [&]() {
+      // Appends one line at a time as the a command does, sequence is reset every lines appends
+      std::istringstream line;
+      for (size_t i = 0; i < lines; ++i) {
+        line.clear();
+        line.str(i % 2 ? "addition 1.5" : "limit -1 1");
+        sequence.append_from(line);
+      }
+      load(sequence, "");
+    });
+  }
+
+  void file_benchmarks(benchmark_runner& runner, mathlab::factory& factory) {
+    const auto directory = std::filesystem::temp_directory_path();
+    const auto input_path = directory / "mathlab_bench_input.txt";
+    const auto output_path = directory / "mathlab_bench_output.txt";
+    const size_t count = 1 << 20;
+    {
+      std::ofstream input(input_path);
+      input.precision(17);
+      for (auto value : random_values(count, -1000., 1000.))
+        input << value << '\n';
+    }
+    mathlab::block_sequence sequence(factory);
+    load(sequence, sequence_text(10));
+    const auto threads = mathlab::default_thread_count();
+    for (unsigned thread_count : { 1u, threads }) {
+      runner.run("ef/text/threads:" + std::to_string(thread_count), static_cast<double>(count), "value", [&]() {
+        mathlab::mapped_file input(input_path);
+        std::ofstream output(output_path);
+        mathlab::evaluate_text(sequence, input.data(), input.data() + input.size(), output, thread_count);
+      });
+      if (threads == 1)
+        break;
+    }
+    std::filesystem::remove(input_path);
+    std::filesystem::remove(output_path);
+  }
+
+  settings parse_settings(int argc, char* argv[]) {
+    settings result;
+    for (int i = 1; i + 1 < argc; i += 2) {
+      const std::string option = argv[i];
+      if (option == "--filter")
+        result.filter = argv[i + 1];
+      else if (option == "--min-time")
+        result.min_time = std::stod(argv[i + 1]);
+      else if (option == "--out")
+        result.output_path = argv[i + 1];
+      else
+        throw std::invalid_argument("Unknown option " + option);
+    }
+    return result;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  settings settings;
+  try {
+    settings = parse_settings(argc, argv);
+  }
+  catch (std::exception& exception) {
+    std::cerr << exception.what() << std::endl << "Usage: MathLabBench [--filter text] [--min-time seconds] [--out file]" << std::endl;
+    return 2;
+  }
+  auto factory = mathlab::factory();
+  mathlab::register_all_blocks(factory);
+  benchmark_runner runner(settings);
+  block_benchmarks(runner, factory);
+  depth_benchmarks(runner, factory);
+  cache_benchmarks(runner, factory);
+  parse_benchmarks(runner, factory);
+  file_benchmarks(runner, factory);
+  if (settings.output_path.empty()) {
+    runner.dump_json(std::cout);
+  }
+  else {
+    std::ofstream output(settings.output_path);
+    runner.dump_json(output);
+  }
+}
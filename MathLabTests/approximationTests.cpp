@@ -0,0 +1,138 @@
+#include "CppUnitTest.h"
+#include "../MathLab/approximation.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  namespace {
+    using mathlab::block_kind;
+
+    std::vector<double> samples(double lower, double upper, size_t count) {
+      std::vector<double> values;
+      for (size_t i = 0; i <= count; ++i)
+        values.push_back(lower + (upper - lower) * i / count);
+      return values;
+    }
+
+    // Largest error of batch evaluation against the exact plan on count + 1 values in [lower, upper]
+    double max_error(const mathlab::piecewise_approximation& approximation, const mathlab::execution_plan& exact,
+      double lower, double upper, size_t count, bool relative) {
+      const auto input = samples(lower, upper, count);
+      std::vector<double> approximate(input.size());
+      approximation.eval_batch(input.data(), approximate.data(), input.size());
+      double error = 0.;
+      for (size_t i = 0; i < input.size(); ++i) {
+        const auto expected = exact.eval(input[i]);
+        error = std::max(error, std::fabs(approximate[i] - expected) / (relative ? std::fabs(expected) : 1.));
+      }
+      return error;
+    }
+  }
+
+  TEST_CLASS(approximation_tests)
+  {
+  public:
+    TEST_METHOD(power_chain_is_within_absolute_tolerance)
+    {
+      const std::vector<mathlab::block_description> blocks = {
+        { block_kind::addition, { 1., 0. } }, { block_kind::power, { 1.7, 0. } }, { block_kind::multiplication, { .5, 0. } } };
+      const mathlab::approximation_settings settings = { 0., 10., { 1e-9, false } };
+      const mathlab::piecewise_approximation approximation(blocks, mathlab::optimization_level::exact, settings);
+      const mathlab::execution_plan exact(blocks, mathlab::optimization_level::exact);
+      Assert::IsTrue(approximation.max_error() <= 1e-9);
+      Assert::IsTrue(max_error(approximation, exact, 0., 10., 100003, false) <= 1e-9);
+      Assert::AreEqual(size_t(0), approximation.exact_piece_count());
+      Assert::IsTrue(approximation.piece_count() < 100);
+    }
+
+    TEST_METHOD(relative_tolerance_follows_magnitude_of_results)
+    {
+      const std::vector<mathlab::block_description> blocks = { { block_kind::power, { 2.5, 0. } } };
+      const mathlab::approximation_settings settings = { 1., 1000., { 1e-12, true } };
+      const mathlab::piecewise_approximation approximation(blocks, mathlab::optimization_level::exact, settings);
+      const mathlab::execution_plan exact(blocks, mathlab::optimization_level::exact);
+      Assert::IsTrue(max_error(approximation, exact, 1., 1000., 100003, true) <= 1e-12);
+    }
+
+    TEST_METHOD(condition_and_limit_split_pieces_at_their_crossings)
+    {
+      // Condition of input - 1 is 0 only at 1, limit kinks at inputs -1 and 4
+      const std::vector<mathlab::block_description> blocks = {
+        { block_kind::addition, { -1., 0. } }, { block_kind::limit, { -2., 3. } }, { block_kind::condition, { 0., 0. } } };
+      const mathlab::piecewise_approximation approximation(blocks, mathlab::optimization_level::exact, { -5., 5., { 1e-9, false } });
+      Assert::AreEqual(0., approximation.eval(1.));
+      Assert::AreEqual(-1., approximation.eval(std::nextafter(1., 0.)), 1e-9);
+      Assert::AreEqual(1., approximation.eval(std::nextafter(1., 2.)), 1e-9);
+      Assert::AreEqual(-1., approximation.eval(-5.), 1e-9);
+      Assert::AreEqual(1., approximation.eval(5.), 1e-9);
+
+      const std::vector<mathlab::block_description> limit = { { block_kind::power, { 3., 0. } }, { block_kind::limit, { -1., 8. } } };
+      const mathlab::piecewise_approximation limited(limit, mathlab::optimization_level::exact, { -4., 4., { 1e-10, false } });
+      const mathlab::execution_plan exact(limit, mathlab::optimization_level::exact);
+      Assert::IsTrue(max_error(limited, exact, -4., 4., 100003, false) <= 1e-10);
+      // Cube is a polynomial, so pieces between the kinks need no splitting
+      Assert::IsTrue(limited.piece_count() < 10);
+    }
+
+    TEST_METHOD(narrow_double_crossing_is_found)
+    {
+      // Square is below 1e-10 only for inputs within 1e-5 of zero, far narrower than a uniform sample of the domain
+      const std::vector<mathlab::block_description> blocks = { { block_kind::power, { 2., 0. } }, { block_kind::condition, { 1e-10, 0. } } };
+      const mathlab::piecewise_approximation approximation(blocks, mathlab::optimization_level::exact, { -1., 1.1, { 1e-6, false } });
+      const mathlab::execution_plan exact(blocks, mathlab::optimization_level::exact);
+      Assert::AreEqual(-1., approximation.eval(0.));
+      Assert::AreEqual(1., approximation.eval(.5), 1e-6);
+      Assert::IsTrue(max_error(approximation, exact, -2e-5, 2e-5, 40001, false) <= 1e-6);
+      Assert::IsTrue(max_error(approximation, exact, -1., 1.1, 100003, false) <= 1e-6);
+    }
+
+    TEST_METHOD(pole_and_inputs_outside_domain_are_evaluated_exactly)
+    {
+      const std::vector<mathlab::block_description> blocks = { { block_kind::power, { -1., 0. } } };
+      const mathlab::piecewise_approximation approximation(blocks, mathlab::optimization_level::exact, { -1., 1., { 1e-9, false } });
+      Assert::IsTrue(approximation.exact_piece_count() > 0);
+      Assert::AreEqual(std::numeric_limits<double>::infinity(), approximation.eval(0.));
+      Assert::AreEqual(-std::numeric_limits<double>::infinity(), approximation.eval(-0.));
+      Assert::AreEqual(1e-300, approximation.eval(1e300));
+      Assert::IsTrue(std::isnan(approximation.eval(std::nan(""))));
+      const double input[] = { 1e300, 0., .5, std::nan("") };
+      double output[4];
+      approximation.eval_batch(input, output, 4);
+      Assert::AreEqual(1e-300, output[0]);
+      Assert::AreEqual(std::numeric_limits<double>::infinity(), output[1]);
+      Assert::AreEqual(2., output[2], 1e-9);
+      Assert::IsTrue(std::isnan(output[3]));
+    }
+
+    TEST_METHOD(unfittable_domain_is_evaluated_exactly)
+    {
+      // Square root is NaN below zero, tolerance is below rounding error of any fit
+      const std::vector<mathlab::block_description> blocks = { { block_kind::power, { .5, 0. } } };
+      const mathlab::piecewise_approximation approximation(blocks, mathlab::optimization_level::exact, { -1000., 1000., { 1e-300, false } });
+      Assert::IsTrue(approximation.piece_count() <= 2 * mathlab::piecewise_approximation::max_pieces);
+      const mathlab::execution_plan exact(blocks, mathlab::optimization_level::exact);
+      const auto input = samples(-1000., 1000., 9973);
+      std::vector<double> output(input.size());
+      std::vector<double> expected(input.size());
+      approximation.eval_batch(input.data(), output.data(), input.size());
+      exact.eval_batch(input.data(), expected.data(), input.size());
+      for (size_t i = 0; i < input.size(); ++i)
+        Assert::IsTrue(input[i] < 0. ? std::isnan(output[i]) : output[i] == expected[i]);
+    }
+
+    TEST_METHOD(invalid_settings_throw)
+    {
+      const std::vector<mathlab::block_description> blocks = { { block_kind::power, { .5, 0. } } };
+      Assert::ExpectException<std::invalid_argument>([&]() {
+        mathlab::piecewise_approximation(blocks, mathlab::optimization_level::exact, { 1., 0., { 1e-9, false } }); });
+      Assert::ExpectException<std::invalid_argument>([&]() {
+        mathlab::piecewise_approximation(blocks, mathlab::optimization_level::exact, { 0., std::numeric_limits<double>::infinity(), { 1e-9, false } }); });
+      Assert::ExpectException<std::invalid_argument>([&]() {
+        mathlab::piecewise_approximation(blocks, mathlab::optimization_level::exact, { 0., 1., { 0., false } }); });
+    }
+  };
+}
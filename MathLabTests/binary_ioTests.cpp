@@ -0,0 +1,131 @@
+#include "CppUnitTest.h"
+#include "../MathLab/binary_io.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  namespace {
+    std::string write_values(const std::vector<double>& values) {
+      std::stringstream output;
+      mathlab::binary_writer writer(output);
+      writer.write(values.data(), values.size());
+      writer.finish();
+      return output.str();
+    }
+  }
+
+  TEST_CLASS(binary_io_tests)
+  {
+  public:
+    TEST_METHOD(writer_writes_header_and_little_endian_values)
+    {
+      const auto data = write_values({ 1., -2.5 });
+      Assert::AreEqual(mathlab::binary_header_size + 2 * sizeof(double), data.size());
+      Assert::AreEqual(std::string("MLVF\x01\0\0\0\x02\0\0\0\0\0\0\0", 16), data.substr(0, 16));
+      // 1.0 is 0x3FF0000000000000
+      Assert::AreEqual(std::string("\0\0\0\0\0\0\xF0\x3F", 8), data.substr(16, 8));
+    }
+
+    TEST_METHOD(reader_reads_written_values_from_memory_and_stream)
+    {
+      const std::vector<double> values = { 0.1, -0., 1e300, 3. };
+      const auto data = write_values(values);
+      mathlab::binary_reader memory_reader(mathlab::parse_binary(data.data(), data.data() + data.size()));
+      std::istringstream input(data);
+      mathlab::binary_reader stream_reader(input);
+      for (auto reader : { &memory_reader, &stream_reader }) {
+        Assert::AreEqual(uint64_t(4), reader->count());
+        double read[3];
+        Assert::AreEqual(size_t(3), reader->read(read, 3));
+        Assert::AreEqual(0.1, read[0]);
+        Assert::AreEqual(1e300, read[2]);
+        Assert::AreEqual(size_t(1), reader->read(read, 3));
+        Assert::AreEqual(3., read[0]);
+        Assert::AreEqual(size_t(0), reader->read(read, 3));
+      }
+    }
+
+    TEST_METHOD(reader_reads_values_until_end_when_count_is_unknown)
+    {
+      auto data = write_values({ 1., 2., 3. });
+      data.replace(8, 8, 8, '\xFF');
+      const auto values = mathlab::parse_binary(data.data(), data.data() + data.size());
+      Assert::AreEqual(size_t(3), values.count);
+      std::istringstream input(data);
+      mathlab::binary_reader reader(input);
+      Assert::IsTrue(reader.count() == mathlab::unknown_value_count);
+      double read[2];
+      Assert::AreEqual(size_t(2), reader.read(read, 2));
+      Assert::AreEqual(size_t(1), reader.read(read, 2));
+      Assert::AreEqual(3., read[0]);
+      Assert::AreEqual(size_t(0), reader.read(read, 2));
+    }
+
+    TEST_METHOD(invalid_input_throws)
+    {
+      Assert::ExpectException<std::invalid_argument>([]()
+      {
+        const std::string data = "1 2 3 4 5 6 7 8 9";
+        mathlab::parse_binary(data.data(), data.data() + data.size());
+      });
+      Assert::ExpectException<std::invalid_argument>([]()
+      {
+        const auto data = write_values({ 1., 2. }).substr(0, 30);
+        mathlab::parse_binary(data.data(), data.data() + data.size());
+      });
+      Assert::ExpectException<std::invalid_argument>([]()
+      {
+        std::istringstream input(write_values({ 1., 2. }).substr(0, 28));
+        mathlab::binary_reader reader(input);
+        double read[2];
+        reader.read(read, 2);
+      });
+    }
+
+    TEST_METHOD(float_and_long_double_values_round_trip)
+    {
+      const std::vector<float> floats = { 1.f, -2.5f, .1f };
+      std::stringstream output;
+      mathlab::binary_writer writer(output, mathlab::precision::f32);
+      writer.write(floats.data(), floats.size());
+      writer.finish();
+      const auto data = output.str();
+      Assert::AreEqual(mathlab::binary_header_v2_size + 3 * sizeof(float), data.size());
+      Assert::AreEqual(std::string("MLVF\x02\0\0\0\x03\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 24), data.substr(0, 24));
+      const auto values = mathlab::parse_binary(data.data(), data.data() + data.size());
+      Assert::IsTrue(values.type == mathlab::precision::f32);
+      // Floats are converted to doubles exactly
+      double read[3];
+      mathlab::binary_reader reader(output);
+      Assert::IsTrue(reader.type() == mathlab::precision::f32);
+      Assert::AreEqual(size_t(3), reader.read(read, 3));
+      Assert::AreEqual(static_cast<double>(.1f), read[2]);
+
+      const std::vector<long double> long_doubles = { 1.L / 3, -1e-4000L, 1e4000L };
+      std::stringstream long_output;
+      mathlab::binary_writer long_writer(long_output, mathlab::precision::f80);
+      long_writer.write(long_doubles.data(), long_doubles.size());
+      long_writer.finish();
+      Assert::AreEqual(mathlab::binary_header_v2_size + 3 * size_t(16), long_output.str().size());
+      long double long_read[3];
+      mathlab::binary_reader long_reader(long_output);
+      Assert::AreEqual(size_t(3), long_reader.read(long_read, 3));
+      for (size_t i = 0; i < 3; ++i)
+        Assert::IsTrue(long_doubles[i] == long_read[i]);
+    }
+
+    TEST_METHOD(converters_round_trip)
+    {
+      std::istringstream text("1.5\n-2\n0.1\n");
+      std::stringstream binary;
+      mathlab::text_to_binary(text, binary);
+      std::ostringstream text_again;
+      mathlab::binary_to_text(binary, text_again);
+      Assert::AreEqual(std::string("1.5\n-2\n0.1\n"), text_again.str());
+    }
+  };
+}
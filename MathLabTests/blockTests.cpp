@@ -1,5 +1,8 @@
 #include "CppUnitTest.h"
 #include "../MathLab/blocks.h"
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
 #include <ostream>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -68,6 +71,60 @@ namespace MathLabTests
       auto limit = mathlab::limit(1., 100.);
       Assert::AreEqual(100., limit.eval(200.));
     }
+
+    TEST_METHOD(eval_batch_evaluates_each_value)
+    {
+      auto limit = mathlab::limit(1., 100.);
+      const double input[] = { -50., 50., 200. };
+      double output[3] = {};
+      limit.eval_batch(input, output, 3);
+      Assert::AreEqual(1., output[0]);
+      Assert::AreEqual(50., output[1]);
+      Assert::AreEqual(100., output[2]);
+    }
+
+    TEST_METHOD(eval_batch_works_in_place)
+    {
+      auto addition = mathlab::addition(1.);
+      double values[] = { 1., 2. };
+      addition.eval_batch(values, values, 2);
+      Assert::AreEqual(2., values[0]);
+      Assert::AreEqual(3., values[1]);
+    }
+
+    TEST_METHOD(blocks_evaluate_in_their_value_type)
+    {
+      auto power = mathlab::basic_power<float>(.5f);
+      float values[] = { 2.f, 16.f };
+      power.eval_batch(values, values, 2);
+      Assert::AreEqual(std::sqrt(2.f), values[0]);
+      Assert::AreEqual(4.f, values[1]);
+      auto addition = mathlab::basic_addition<long double>(1.L);
+      Assert::IsTrue(addition.eval(1e-18L) == 1.L + 1e-18L);
+    }
+
+    TEST_METHOD(described_blocks_evaluate_like_blocks)
+    {
+      const mathlab::addition addition(1.5);
+      const mathlab::multiplication multiplication(-2.);
+      const mathlab::power power(.37);
+      const mathlab::condition condition(1.);
+      const mathlab::limit limit(-1., 2.);
+      const mathlab::identity identity;
+      const double input[] = { -3., 0., 1., 2.5, 7. };
+      for (const mathlab::block* block : std::initializer_list<const mathlab::block*>{ &addition, &multiplication, &power, &condition, &limit, &identity }) {
+        double expected[5];
+        double actual[5];
+        block->eval_batch(input, expected, 5);
+        mathlab::eval_batch_described(block->describe(), input, actual, 5);
+        for (size_t i = 0; i < 5; ++i) {
+          Assert::IsTrue(std::memcmp(&expected[i], &actual[i], sizeof(double)) == 0);
+          const auto single = mathlab::eval_described(block->describe(), input[i]);
+          const auto single_expected = block->eval(input[i]);
+          Assert::IsTrue(std::memcmp(&single_expected, &single, sizeof(double)) == 0);
+        }
+      }
+    }
 	};
 
   TEST_CLASS(blocks_can_be_created_from_stream_and_dumped_to_stream)
@@ -1,5 +1,10 @@
 #include "CppUnitTest.h"
 #include "../MathLab/block_sequence.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
@@ -54,6 +59,19 @@ namespace MathLabTests
       Assert::AreEqual(400., sequence.eval(100.));
     }
 
+    TEST_METHOD(append_from_text_reports_invalid_lines)
+    {
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence sequence(factory);
+      const auto invalid = sequence.append_from(std::string_view("addition 1\r\n\n  \nunknown 2\nlimit 1\nmultiplication 3"));
+      Assert::AreEqual(std::string("unknown 2\nlimit 1\n"), invalid);
+      Assert::AreEqual(6., sequence.eval(1.));
+      std::ostringstream output;
+      sequence.dump(output, false);
+      Assert::AreEqual(std::string("addition 1 \nmultiplication 3 \n"), output.str());
+    }
+
     TEST_METHOD(load_clears_sequence_and_appends)
     {
       mathlab::factory factory;
@@ -83,6 +101,20 @@ namespace MathLabTests
       Assert::AreEqual(std::string("multiplication 2 \n"), output.str());
     }
 
+    TEST_METHOD(remove_past_last_block_keeps_version)
+    {
+      mathlab::factory factory;
+      factory.register_block<mathlab::addition>("addition");
+      mathlab::block_sequence sequence(factory);
+      sequence.append_from(std::string_view("addition 1\n"));
+      sequence.set_stats(true);
+      sequence.eval(1.);
+      const auto version = sequence.current();
+      sequence.remove_at(1);
+      Assert::IsTrue(sequence.current() == version);
+      Assert::AreEqual(uint64_t(1), sequence.stats()->blocks()[0].values);
+    }
+
     TEST_METHOD(move_to_beginning_works)
     {
       mathlab::factory factory;
@@ -98,5 +130,296 @@ namespace MathLabTests
       // ReSharper restore CppExpressionWithoutSideEffects
       Assert::AreEqual(std::string("multiplication 2 \naddition 100 \n"), output.str());
     }
+
+    TEST_METHOD(eval_batch_matches_eval_across_tiles)
+    {
+      mathlab::factory factory;
+      factory.register_block<mathlab::addition>("addition");
+      factory.register_block<mathlab::multiplication>("multiplication");
+      mathlab::block_sequence sequence(factory);
+      std::istringstream input("addition 100.\nmultiplication 2.\n");
+      sequence.append_from(input);
+
+      std::vector<double> values(mathlab::block_sequence::tile_size * 2 + 3);
+      for (size_t i = 0; i < values.size(); ++i)
+        values[i] = static_cast<double>(i);
+      std::vector<double> results(values.size());
+      sequence.eval_batch(values.data(), results.data(), values.size());
+      for (size_t i = 0; i < values.size(); ++i)
+        Assert::AreEqual(sequence.eval(values[i]), results[i]);
+    }
+
+    TEST_METHOD(optimization_keeps_dump_unchanged)
+    {
+      mathlab::factory factory;
+      factory.register_block<mathlab::identity>("identity");
+      factory.register_block<mathlab::limit>("limit");
+      mathlab::block_sequence sequence(factory);
+      std::istringstream input("identity\nlimit 0 10\nlimit 2 8\n");
+      sequence.append_from(input);
+      sequence.set_optimization(mathlab::optimization_level::relaxed);
+      Assert::AreEqual(size_t(1), sequence.plan().steps().size());
+      Assert::AreEqual(2., sequence.eval(-5.));
+
+      std::ostringstream output;
+      sequence.dump(output, false);
+      Assert::AreEqual(std::string("identity \nlimit 0 10 \nlimit 2 8 \n"), output.str());
+    }
+
+    TEST_METHOD(float_and_long_double_match_blocks_at_any_optimization)
+    {
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence sequence(factory);
+      sequence.load_from(std::string_view("addition 0.1\naddition 0.2\nmultiplication 3\npower 2\n"));
+      sequence.set_optimization(mathlab::optimization_level::relaxed);
+      const float inputs[] = { 1.f, 3.7f, -2.3f, 1000.1f, 1e-3f };
+      const long double long_inputs[] = { 1.L, 3.7L, -2.3L, 1000.1L, 1e-3L };
+      float outputs[5];
+      long double long_outputs[5];
+      sequence.eval_batch(inputs, outputs, 5);
+      sequence.eval_batch(long_inputs, long_outputs, 5);
+      for (size_t i = 0; i < 5; ++i) {
+        const auto expected = std::pow((inputs[i] + .1f + .2f) * 3.f, 2.f);
+        Assert::AreEqual(expected, outputs[i]);
+        const auto long_expected = std::pow((long_inputs[i] + static_cast<long double>(.1) + static_cast<long double>(.2)) * 3.L, 2.L);
+        Assert::IsTrue(long_expected == long_outputs[i]);
+      }
+    }
+
+    TEST_METHOD(eval_batch_of_empty_sequence_copies_input)
+    {
+      mathlab::factory factory;
+      mathlab::block_sequence sequence(factory);
+      const double input[] = { 1., 2. };
+      double output[2] = {};
+      sequence.eval_batch(input, output, 2);
+      Assert::AreEqual(1., output[0]);
+      Assert::AreEqual(2., output[1]);
+    }
+
+    TEST_METHOD(stats_count_outputs_of_every_block)
+    {
+      mathlab::factory factory;
+      factory.register_block<mathlab::addition>("addition");
+      factory.register_block<mathlab::power>("power");
+      mathlab::block_sequence sequence(factory);
+      std::istringstream input("addition -1\npower .5\n");
+      sequence.append_from(input);
+      Assert::IsTrue(sequence.stats() == nullptr);
+      sequence.set_stats(true);
+
+      const double values[] = { 0., 5., 10. };
+      double results[3];
+      sequence.eval_batch(values, results, 3);
+      Assert::AreEqual(3., sequence.eval(10.));
+      Assert::AreEqual(2., results[1]);
+
+      const auto stats = sequence.stats();
+      Assert::AreEqual(std::string("power 0.5"), stats->names()[1]);
+      const auto blocks = stats->blocks();
+      Assert::AreEqual(uint64_t(4), blocks[0].values);
+      Assert::AreEqual(-1., blocks[0].min);
+      Assert::AreEqual(9., blocks[0].max);
+      Assert::AreEqual(uint64_t(1), blocks[1].nan_values);
+      Assert::AreEqual(3., blocks[1].max);
+      Assert::AreEqual(uint64_t(1), stats->batch_latency().count());
+      // First single evaluation is sampled
+      Assert::AreEqual(uint64_t(1), stats->eval_latency().count());
+      Assert::AreEqual(uint64_t(4), blocks[1].timed_values);
+    }
+
+    TEST_METHOD(stats_are_reset_after_change)
+    {
+      mathlab::factory factory;
+      factory.register_block<mathlab::addition>("addition");
+      mathlab::block_sequence sequence(factory);
+      std::istringstream input("addition 1\naddition 2\n");
+      sequence.append_from(input);
+      sequence.set_stats(true);
+      sequence.eval(1.);
+      sequence.remove_at(0);
+      Assert::AreEqual(size_t(1), sequence.stats()->names().size());
+      Assert::AreEqual(uint64_t(0), sequence.stats()->blocks()[0].values);
+      sequence.set_stats(false);
+      Assert::IsTrue(sequence.stats() == nullptr);
+      Assert::AreEqual(3., sequence.eval(1.));
+    }
+
+    TEST_METHOD(jit_keeps_stats_and_cache)
+    {
+      mathlab::factory factory;
+      factory.register_block<mathlab::addition>("addition");
+      mathlab::block_sequence sequence(factory);
+      sequence.append_from(std::string_view("addition 1\n"));
+      sequence.set_stats(true);
+      sequence.set_cache(true);
+      sequence.eval(1.);
+      const auto cache = sequence.cache();
+      sequence.set_jit(true);
+      Assert::AreEqual(uint64_t(1), sequence.stats()->blocks()[0].values);
+      Assert::IsTrue(sequence.cache() == cache);
+      sequence.set_approximation(mathlab::approximation_settings{ 0., 10., { 1e-10, false } });
+      Assert::AreEqual(uint64_t(1), sequence.stats()->blocks()[0].values);
+      Assert::IsTrue(sequence.cache() == cache);
+      // Cached results may come from the approximation that is replaced
+      sequence.set_approximation(std::nullopt);
+      Assert::IsTrue(sequence.cache() != cache);
+      Assert::AreEqual(2., sequence.eval(1.));
+    }
+
+    TEST_METHOD(cache_is_invalidated_on_change)
+    {
+      mathlab::factory factory;
+      factory.register_block<mathlab::addition>("addition");
+      mathlab::block_sequence sequence(factory);
+      std::istringstream input("addition 1\naddition 2\n");
+      sequence.append_from(input);
+      sequence.set_cache(true);
+      const double values[] = { 1., 1. };
+      double results[2];
+      sequence.eval_batch(values, results, 2);
+      sequence.eval_batch(values, results, 2);
+      Assert::AreEqual(4., results[1]);
+      Assert::AreEqual(uint64_t(2), sequence.cache()->hits());
+
+      sequence.remove_at(1);
+      sequence.eval_batch(values, results, 2);
+      Assert::AreEqual(2., results[0]);
+      Assert::AreEqual(2., results[1]);
+      Assert::AreEqual(uint64_t(0), sequence.cache()->hits());
+    }
+
+    TEST_METHOD(approximation_is_refitted_after_change)
+    {
+      mathlab::factory factory;
+      factory.register_block<mathlab::addition>("addition");
+      factory.register_block<mathlab::power>("power");
+      mathlab::block_sequence sequence(factory);
+      sequence.append_from(std::string_view("power 0.5\n"));
+      sequence.set_approximation(mathlab::approximation_settings{ 1., 100., { 1e-10, false } });
+      Assert::IsTrue(sequence.approximation() != nullptr);
+      const double values[] = { 4., 50., 1e4 };
+      double results[3];
+      sequence.eval_batch(values, results, 3);
+      Assert::AreEqual(2., results[0], 1e-10);
+      Assert::AreEqual(std::sqrt(50.), results[1], 1e-10);
+      Assert::AreEqual(100., results[2]);
+
+      sequence.append_from(std::string_view("addition 1\n"));
+      sequence.eval_batch(values, results, 3);
+      Assert::AreEqual(3., results[0], 1e-10);
+      Assert::AreEqual(101., results[2]);
+      // Single evaluation is exact
+      Assert::AreEqual(std::sqrt(50.) + 1., sequence.eval(50.));
+
+      sequence.set_approximation(std::nullopt);
+      Assert::IsTrue(sequence.approximation() == nullptr);
+    }
+
+    TEST_METHOD(incremental_evaluation_resumes_after_unchanged_blocks)
+    {
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence sequence(factory);
+      mathlab::block_sequence reference(factory);
+      const std::string text = "addition 1\nmultiplication 3\npower 2\nlimit -100 1000\naddition -5\n";
+      sequence.load_from(std::string_view(text));
+      sequence.set_incremental(true);
+      std::vector<double> values(mathlab::block_sequence::tile_size + 5);
+      for (size_t i = 0; i < values.size(); ++i)
+        values[i] = static_cast<double>(i % 17) - 8.;
+      std::vector<double> results(values.size());
+      std::vector<double> expected(values.size());
+      const auto check = [&]() {
+        std::ostringstream blocks;
+        sequence.dump(blocks, false);
+        reference.load_from(std::string_view(blocks.str()));
+        sequence.eval_batch(values.data(), results.data(), values.size());
+        reference.eval_batch(values.data(), expected.data(), values.size());
+        for (size_t i = 0; i < values.size(); ++i)
+          Assert::AreEqual(expected[i], results[i]);
+      };
+      check();
+      Assert::AreEqual(uint64_t(0), sequence.incremental()->hits());
+      // Tuning the last block resumes from output of the first four
+      sequence.remove_at(4);
+      sequence.append_from(std::string_view("addition 7\n"));
+      check();
+      Assert::AreEqual(uint64_t(1), sequence.incremental()->hits());
+      // Moving a block changes the first one, so nothing is kept
+      sequence.move_to_beginning(2);
+      check();
+      Assert::AreEqual(uint64_t(1), sequence.incremental()->hits());
+      check();
+      Assert::AreEqual(uint64_t(2), sequence.incremental()->hits());
+    }
+
+    TEST_METHOD(incremental_evaluation_in_place)
+    {
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence sequence(factory);
+      sequence.load_from(std::string_view("addition 1\nmultiplication 2\naddition 3\n"));
+      sequence.set_incremental(true);
+      std::vector<double> values = { 1., 2. };
+      sequence.eval_batch(values.data(), values.data(), values.size());
+      Assert::AreEqual(7., values[0]);
+      sequence.remove_at(2);
+      values = { 1., 2. };
+      sequence.eval_batch(values.data(), values.data(), values.size());
+      Assert::AreEqual(4., values[0]);
+      Assert::AreEqual(6., values[1]);
+      Assert::AreEqual(uint64_t(1), sequence.incremental()->hits());
+    }
+
+    TEST_METHOD(held_version_is_not_changed_by_edits)
+    {
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence sequence(factory);
+      sequence.load_from(std::string_view("addition 1\nmultiplication 2\n"));
+      auto held = sequence.current();
+      const std::weak_ptr<const mathlab::sequence_version> watched = held;
+      sequence.remove_at(0);
+      Assert::AreEqual(held->number() + 1, sequence.current()->number());
+      Assert::AreEqual(6., held->eval(2.));
+      Assert::AreEqual(4., sequence.eval(2.));
+      Assert::IsFalse(watched.expired());
+      held = nullptr;
+      Assert::IsTrue(watched.expired());
+    }
+
+    TEST_METHOD(readers_see_whole_versions_while_sequence_is_edited)
+    {
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence sequence(factory);
+      sequence.set_jit(true);
+      std::atomic<bool> editing{ true };
+      std::atomic<bool> consistent{ true };
+      std::vector<std::thread> readers;
+      for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&sequence, &editing, &consistent]() {
+          std::vector<double> values(3000);
+          while (editing) {
+            std::fill(values.begin(), values.end(), 0.);
+            sequence.eval_batch(values.data(), values.data(), values.size());
+            // Every version adds ones, so all values of a batch are the same count of blocks
+            if (std::count(values.begin(), values.end(), values[0]) != static_cast<std::ptrdiff_t>(values.size()) || values[0] > 50.)
+              consistent = false;
+          }
+        });
+      }
+      for (int i = 0; i < 50; ++i)
+        sequence.append_from(std::string_view("addition 1\n"));
+      for (int i = 0; i < 50; i += 2)
+        sequence.remove_at(0);
+      editing = false;
+      for (auto& reader : readers)
+        reader.join();
+      Assert::IsTrue(consistent);
+      Assert::AreEqual(25., sequence.eval(0.));
+    }
   };
 }
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "CppUnitTest.h"
+#include "../MathLab/command_line.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  TEST_CLASS(command_line_tests)
+  {
+  public:
+    TEST_METHOD(defaults_stream_text_with_sequence_from_current_directory)
+    {
+      const auto options = mathlab::parse_command_line({});
+      Assert::AreEqual(std::string("sequence.txt"), options.sequence_path);
+      Assert::AreEqual(std::string("-"), options.input_path);
+      Assert::AreEqual(std::string("-"), options.output_path);
+      Assert::IsTrue(options.format == mathlab::value_format::text);
+      Assert::IsTrue(options.threads > 0);
+      Assert::IsFalse(options.jit);
+      Assert::IsFalse(options.cache);
+      Assert::IsTrue(options.stats_path.empty());
+    }
+
+    TEST_METHOD(parses_all_options)
+    {
+      const auto options = mathlab::parse_command_line({ "--sequence", "seq.txt", "--in", "in.bin", "--out", "-", "--threads", "8",
+        "--format", "binary", "--optimization", "relaxed", "--jit", "--cache", "--stats", "stats.json" });
+      Assert::AreEqual(std::string("seq.txt"), options.sequence_path);
+      Assert::AreEqual(std::string("in.bin"), options.input_path);
+      Assert::AreEqual(8u, options.threads);
+      Assert::IsTrue(options.format == mathlab::value_format::binary);
+      Assert::IsTrue(options.optimization == mathlab::optimization_level::relaxed);
+      Assert::IsTrue(options.jit);
+      Assert::IsTrue(options.cache);
+      Assert::AreEqual(std::string("stats.json"), options.stats_path);
+    }
+
+    TEST_METHOD(throws_on_invalid_arguments)
+    {
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--unknown" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--in" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--threads", "0" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--threads", "4x" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--format", "csv" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--sequence", "a", "--sequence", "b", "--cache" }); });
+      Assert::ExpectException<std::invalid_argument>([]() {
+        mathlab::parse_command_line({ "--sequence", "a", "--sequence", "b", "--format", "binary" }); });
+    }
+
+    TEST_METHOD(parses_precision)
+    {
+      Assert::IsTrue(mathlab::parse_command_line({}).precision == mathlab::precision::f64);
+      Assert::IsTrue(mathlab::parse_command_line({ "--precision", "f32" }).precision == mathlab::precision::f32);
+      Assert::IsTrue(mathlab::parse_command_line({ "--precision", "f80", "--format", "binary" }).precision == mathlab::precision::f80);
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--precision", "f16" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--precision", "f32", "--jit" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--precision", "f80", "--serve", "a" }); });
+    }
+
+    TEST_METHOD(parses_sweep)
+    {
+      Assert::IsFalse(mathlab::parse_command_line({}).sweep.has_value());
+      const auto options = mathlab::parse_command_line({ "--sweep", "-1:1:0.5", "--format", "binary" });
+      Assert::AreEqual(-1., options.sweep->start);
+      Assert::AreEqual(.5, options.sweep->step);
+      Assert::AreEqual(size_t(5), options.sweep->count);
+      for (auto range : { "0:1", "0:1:0", "1:0:1", "a:1:1", "0:1:1:1", "0::1" })
+        Assert::ExpectException<std::invalid_argument>([&]() { mathlab::parse_command_line({ "--sweep", range }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--sweep", "0:1:1", "--in", "a" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--sweep", "0:1:1", "--serve", "a" }); });
+      Assert::ExpectException<std::invalid_argument>([]() {
+        mathlab::parse_command_line({ "--sweep", "0:1:1", "--sequence", "a", "--sequence", "b" }); });
+    }
+
+    TEST_METHOD(parses_approximation)
+    {
+      Assert::IsFalse(mathlab::parse_command_line({}).approximation.has_value());
+      const auto options = mathlab::parse_command_line({ "--approximate", "-2.5:1e3", "--tolerance", "1e-6", "--relative" });
+      Assert::AreEqual(-2.5, options.approximation->lower);
+      Assert::AreEqual(1000., options.approximation->upper);
+      Assert::AreEqual(1e-6, options.approximation->tolerance.value);
+      Assert::IsTrue(options.approximation->tolerance.relative);
+      const auto defaults = mathlab::parse_command_line({ "--approximate", "0:1" });
+      Assert::AreEqual(1e-9, defaults.approximation->tolerance.value);
+      Assert::IsFalse(defaults.approximation->tolerance.relative);
+      for (auto domain : { "1:0", "1:1", "0:inf", "0", "a:1", "0:1x" })
+        Assert::ExpectException<std::invalid_argument>([&]() { mathlab::parse_command_line({ "--approximate", domain }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--approximate", "0:1", "--tolerance", "0" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--tolerance", "1e-6" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--approximate", "0:1", "--precision", "f32" }); });
+      Assert::ExpectException<std::invalid_argument>([]() {
+        mathlab::parse_command_line({ "--approximate", "0:1", "--sequence", "a", "--sequence", "b" }); });
+    }
+
+    TEST_METHOD(parses_summary)
+    {
+      Assert::IsTrue(mathlab::parse_command_line({}).summary == mathlab::summary_format::none);
+      const auto options = mathlab::parse_command_line({ "--summary", "json", "--quantiles", "0.1,0.99", "--histogram", "20" });
+      Assert::IsTrue(options.summary == mathlab::summary_format::json);
+      Assert::AreEqual(size_t(2), options.summary_settings.quantiles.size());
+      Assert::AreEqual(.99, options.summary_settings.quantiles[1]);
+      Assert::AreEqual(size_t(20), options.summary_settings.histogram_bins);
+      Assert::AreEqual(size_t(10), mathlab::parse_command_line({ "--summary", "text" }).summary_settings.histogram_bins);
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--summary", "csv" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--summary", "text", "--quantiles", "2" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--summary", "text", "--histogram", "0" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--histogram", "5" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--summary", "text", "--precision", "f32" }); });
+      Assert::ExpectException<std::invalid_argument>([]() {
+        mathlab::parse_command_line({ "--summary", "text", "--sequence", "a", "--sequence", "b" }); });
+    }
+
+    TEST_METHOD(parses_server_and_load_options)
+    {
+      const auto server = mathlab::parse_command_line({ "--serve", "/tmp/mathlab.sock", "--jit" });
+      Assert::AreEqual(std::string("/tmp/mathlab.sock"), server.serve_path);
+      const auto load = mathlab::parse_command_line({ "--load", "/tmp/mathlab.sock", "--clients", "8", "--requests", "100", "--values", "1" });
+      Assert::AreEqual(std::string("/tmp/mathlab.sock"), load.load_path);
+      Assert::AreEqual(8u, load.load_clients);
+      Assert::AreEqual(size_t(100), load.load_requests);
+      Assert::AreEqual(size_t(1), load.load_values);
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--values", "0" }); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::parse_command_line({ "--serve", "a", "--load", "a" }); });
+    }
+
+    TEST_METHOD(repeated_sequence_adds_sequences)
+    {
+      const auto options = mathlab::parse_command_line({ "--sequence", "a.txt", "--sequence", "b.txt" });
+      Assert::AreEqual(std::string("a.txt"), options.sequence_path);
+      Assert::AreEqual(size_t(2), options.sequence_paths.size());
+      Assert::AreEqual(std::string("b.txt"), options.sequence_paths[1]);
+    }
+  };
+}
@@ -0,0 +1,121 @@
+#include "CppUnitTest.h"
+#include "../MathLab/compressed_stream.h"
+#include <sstream>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  namespace {
+    using mathlab::compression;
+
+    std::string compress(const std::string& text, compression type) {
+      std::ostringstream output;
+      mathlab::compressing_ostream compressed(output, type);
+      compressed.write(text.data(), static_cast<std::streamsize>(text.size()));
+      compressed.finish();
+      Assert::IsTrue(compressed.good());
+      return output.str();
+    }
+
+    std::string decompress(const std::string& data, compression type) {
+      std::istringstream input(data);
+      mathlab::decompressing_istream decompressed(input, type);
+      std::string text;
+      char buffer[4096];
+      while (decompressed.read(buffer, sizeof(buffer)) || decompressed.gcount() > 0)
+        text.append(buffer, static_cast<size_t>(decompressed.gcount()));
+      return text;
+    }
+
+    // Numbers spread over several blocks
+    std::string numbers() {
+      std::ostringstream text;
+      for (int i = 0; i < 200000; ++i)
+        text << i * 7919 % 100003 << '\n';
+      return text.str();
+    }
+  }
+
+  TEST_CLASS(compressed_stream_tests)
+  {
+  public:
+    TEST_METHOD(detects_compression_by_extension_and_magic_bytes)
+    {
+      Assert::IsTrue(mathlab::compression_of_path("data.txt.gz") == compression::gzip);
+      Assert::IsTrue(mathlab::compression_of_path("data.bin.zst") == compression::zstd);
+      Assert::IsTrue(mathlab::compression_of_path("data.txt") == compression::none);
+      Assert::IsTrue(mathlab::compression_of_data("\x1F\x8B\x08", 3) == compression::gzip);
+      Assert::IsTrue(mathlab::compression_of_data("\x28\xB5\x2F\xFD", 4) == compression::zstd);
+      Assert::IsTrue(mathlab::compression_of_data("\x28\xB5", 2) == compression::none);
+      Assert::IsTrue(mathlab::compression_of_data("1 2 3", 5) == compression::none);
+      Assert::AreEqual(std::string(".gz"), std::string(mathlab::extension(compression::gzip)));
+    }
+
+    TEST_METHOD(round_trips_through_every_supported_compression)
+    {
+      const auto text = numbers();
+      for (auto type : { compression::gzip, compression::zstd }) {
+        if (!mathlab::is_supported(type))
+          continue;
+        const auto data = compress(text, type);
+        Assert::IsTrue(mathlab::compression_of_data(data.data(), data.size()) == type);
+        Assert::IsTrue(data.size() < text.size());
+        Assert::IsTrue(decompress(data, type) == text);
+        Assert::AreEqual(std::string(), decompress(compress("", type), type));
+      }
+    }
+
+    TEST_METHOD(concatenated_data_is_read_as_one_stream)
+    {
+      for (auto type : { compression::gzip, compression::zstd }) {
+        if (!mathlab::is_supported(type))
+          continue;
+        Assert::AreEqual(std::string("1 2\n3\n"), decompress(compress("1 2\n", type) + compress("3\n", type), type));
+      }
+    }
+
+    TEST_METHOD(invalid_and_truncated_data_throw)
+    {
+      for (auto type : { compression::gzip, compression::zstd }) {
+        if (!mathlab::is_supported(type))
+          continue;
+        const auto data = compress(numbers(), type);
+        Assert::ExpectException<std::invalid_argument>([&]() { decompress(data.substr(0, data.size() / 2), type); });
+        auto corrupt = data;
+        corrupt[corrupt.size() / 2] ^= 0x55;
+        corrupt[corrupt.size() / 2 + 1] ^= 0x55;
+        Assert::ExpectException<std::invalid_argument>([&]() { decompress(corrupt, type); });
+      }
+      Assert::ExpectException<std::invalid_argument>([]() { decompress("1 2 3", compression::none); });
+    }
+
+    TEST_METHOD(start_can_be_sought_after_reading_header)
+    {
+      if (!mathlab::is_supported(compression::gzip))
+        return;
+      std::istringstream input(compress("MLVF and more", compression::gzip));
+      mathlab::decompressing_istream decompressed(input, compression::gzip);
+      char header[4];
+      decompressed.read(header, 4);
+      decompressed.seekg(0);
+      std::string text;
+      std::getline(decompressed, text);
+      Assert::AreEqual(std::string("MLVF and more"), text);
+    }
+
+    TEST_METHOD(writing_after_finish_fails)
+    {
+      if (!mathlab::is_supported(compression::gzip))
+        return;
+      std::ostringstream output;
+      mathlab::compressing_ostream compressed(output, compression::gzip);
+      compressed << "1\n";
+      compressed.finish();
+      compressed << "2\n";
+      Assert::IsFalse(compressed.good());
+      Assert::AreEqual(std::string("1\n"), decompress(output.str(), compression::gzip));
+    }
+  };
+}
@@ -0,0 +1,141 @@
+#include "CppUnitTest.h"
+#include "../MathLab/evaluation_client.h"
+#include "../MathLab/evaluation_server.h"
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  namespace {
+    // Server of a sequence that adds 1 and halves, running on its own thread
+    struct test_server {
+      mathlab::factory factory;
+      mathlab::block_sequence sequence;
+      std::string path;
+      std::unique_ptr<mathlab::evaluation_server> server;
+      std::thread thread;
+
+      explicit test_server(const char* name) : sequence(factory),
+        path((std::filesystem::temp_directory_path() / name).string()) {
+        mathlab::register_all_blocks(factory);
+        sequence.load_from(std::string_view("addition 1\nmultiplication 0.5\n"));
+        server = std::make_unique<mathlab::evaluation_server>(sequence, path);
+        thread = std::thread([this]() { server->run(); });
+      }
+
+      ~test_server() {
+        server->stop();
+        thread.join();
+      }
+    };
+  }
+
+  TEST_CLASS(evaluation_server_tests)
+  {
+  public:
+    TEST_METHOD(clients_get_results_of_their_requests)
+    {
+      if (!mathlab::evaluation_server::is_supported())
+        return;
+      test_server test("mathlab_server_test.sock");
+      std::vector<std::thread> clients;
+      std::vector<double> results(4);
+      for (size_t c = 0; c < results.size(); ++c) {
+        clients.emplace_back([&test, &results, c]() {
+          mathlab::evaluation_client client(test.path);
+          for (int r = 0; r < 100; ++r) {
+            const double values[] = { static_cast<double>(c), static_cast<double>(r) };
+            double outputs[2];
+            client.eval_batch(values, outputs, 2);
+            results[c] += outputs[0] + outputs[1] - (c + r + 2) * .5;
+          }
+        });
+      }
+      for (auto& client : clients)
+        client.join();
+      for (auto result : results)
+        Assert::AreEqual(0., result);
+      Assert::AreEqual(uint64_t(400), test.server->requests());
+    }
+
+    TEST_METHOD(pipelined_requests_are_evaluated_together)
+    {
+      if (!mathlab::evaluation_server::is_supported())
+        return;
+      std::unique_ptr<test_server> test = std::make_unique<test_server>("mathlab_server_batch_test.sock");
+      {
+        mathlab::evaluation_client client(test->path);
+        const double first[] = { 1., 3. };
+        const double second[] = { 5. };
+        std::vector<double> empty;
+        client.send(first, 2);
+        client.send(empty.data(), 0);
+        client.send(second, 1);
+        double results[2];
+        Assert::AreEqual(size_t(2), client.receive(results, 2));
+        Assert::AreEqual(2., results[1]);
+        Assert::AreEqual(size_t(0), client.receive(results, 2));
+        Assert::AreEqual(size_t(1), client.receive(results, 2));
+        Assert::AreEqual(3., results[0]);
+      }
+      const auto server = test->server.get();
+      Assert::AreEqual(uint64_t(3), server->requests());
+      Assert::AreEqual(uint64_t(1), server->batches());
+      const auto path = test->path;
+      test.reset();
+      Assert::IsFalse(std::filesystem::exists(path));
+    }
+
+    TEST_METHOD(large_requests_are_evaluated_in_bounded_batches)
+    {
+      if (!mathlab::evaluation_server::is_supported())
+        return;
+      test_server test("mathlab_server_large_test.sock");
+      mathlab::evaluation_client client(test.path);
+      std::vector<double> values(mathlab::evaluation_server::max_batch_values * 2 + 3);
+      for (size_t i = 0; i < values.size(); ++i)
+        values[i] = static_cast<double>(i);
+      std::vector<double> results(values.size());
+      client.eval_batch(values.data(), results.data(), values.size());
+      for (size_t i = 0; i < values.size(); ++i)
+        Assert::AreEqual((i + 1) * .5, results[i]);
+      Assert::AreEqual(uint64_t(3), test.server->batches());
+    }
+
+    TEST_METHOD(requests_sent_before_shutdown_are_answered)
+    {
+      if (!mathlab::evaluation_server::is_supported())
+        return;
+      test_server test("mathlab_server_shutdown_test.sock");
+      mathlab::evaluation_client client(test.path);
+      const double first[] = { 1., 3. };
+      const double second[] = { 5. };
+      client.send(first, 2);
+      client.send(second, 1);
+      client.finish_sending();
+      double results[2];
+      Assert::AreEqual(size_t(2), client.receive(results, 2));
+      Assert::AreEqual(2., results[1]);
+      Assert::AreEqual(size_t(1), client.receive(results, 2));
+      Assert::AreEqual(3., results[0]);
+      // Server closes the connection after the last reply
+      Assert::ExpectException<std::system_error>([&]() { client.receive(results, 2); });
+    }
+
+    TEST_METHOD(load_reports_latency_quantiles)
+    {
+      if (!mathlab::evaluation_server::is_supported())
+        return;
+      test_server test("mathlab_server_load_test.sock");
+      const auto report = mathlab::run_load(test.path, 2, 50, 8);
+      Assert::AreEqual(uint64_t(100), report.requests);
+      Assert::AreEqual(uint64_t(800), report.values);
+      Assert::IsTrue(report.p50 > 0 && report.p50 <= report.p99 && report.p99 <= report.max);
+    }
+  };
+}
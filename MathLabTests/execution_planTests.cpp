@@ -0,0 +1,275 @@
+#include "CppUnitTest.h"
+#include "../MathLab/execution_plan.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  namespace {
+    using mathlab::block_kind;
+    using mathlab::optimization_level;
+    using mathlab::plan_operation;
+
+    const auto infinity = std::numeric_limits<double>::infinity();
+
+    std::vector<double> sample_values() {
+      std::vector<double> values = { 0., -0., infinity, -infinity, std::numeric_limits<double>::quiet_NaN(), 1e-310, -1e300 };
+      for (int i = -40; i <= 40; ++i)
+        values.push_back(i * 0.37);
+      return values;
+    }
+
+    bool same(double a, double b) {
+      if (std::isnan(a) && std::isnan(b))
+        return true;
+      return std::memcmp(&a, &b, sizeof(double)) == 0;
+    }
+
+    // Exact plan must return the same bits as a plan with one step per block, per value and in batch
+    void assert_exact(const std::vector<mathlab::block_description>& blocks) {
+      const mathlab::execution_plan reference(blocks, optimization_level::none);
+      const mathlab::execution_plan optimized(blocks, optimization_level::exact);
+      auto values = sample_values();
+      std::vector<double> expected(values.size());
+      std::vector<double> actual(values.size());
+      reference.eval_batch(values.data(), expected.data(), values.size());
+      optimized.eval_batch(values.data(), actual.data(), values.size());
+      for (size_t i = 0; i < values.size(); ++i) {
+        Assert::IsTrue(same(reference.eval(values[i]), optimized.eval(values[i])));
+        Assert::IsTrue(same(expected[i], actual[i]));
+      }
+    }
+  }
+
+  TEST_CLASS(execution_plan_tests)
+  {
+  public:
+    TEST_METHOD(none_keeps_one_step_per_block)
+    {
+      const mathlab::execution_plan plan({ { block_kind::addition, { 0. } }, { block_kind::multiplication, { 1. } } }, optimization_level::none);
+      Assert::AreEqual(size_t(2), plan.steps().size());
+    }
+
+    TEST_METHOD(exact_drops_identity_and_no_op_constants)
+    {
+      const std::vector<mathlab::block_description> blocks = {
+        { block_kind::identity, {} }, { block_kind::addition, { -0. } }, { block_kind::multiplication, { 1. } },
+        { block_kind::power, { 1. } }, { block_kind::limit, { -infinity, infinity } } };
+      const mathlab::execution_plan plan(blocks, optimization_level::exact);
+      Assert::IsTrue(plan.steps().empty());
+      assert_exact(blocks);
+    }
+
+    TEST_METHOD(exact_keeps_addition_of_positive_zero)
+    {
+      const mathlab::execution_plan plan({ { block_kind::addition, { 0. } } }, optimization_level::exact);
+      Assert::AreEqual(size_t(1), plan.steps().size());
+    }
+
+    TEST_METHOD(exact_merges_nested_limits)
+    {
+      const std::vector<mathlab::block_description> blocks = { { block_kind::limit, { 0., 10. } }, { block_kind::limit, { 2., 8. } } };
+      const mathlab::execution_plan plan(blocks, optimization_level::exact);
+      Assert::AreEqual(size_t(1), plan.steps().size());
+      Assert::AreEqual(2., plan.steps()[0].constants[0]);
+      Assert::AreEqual(8., plan.steps()[0].constants[1]);
+      assert_exact(blocks);
+      assert_exact({ { block_kind::limit, { -0., 10. } }, { block_kind::limit, { 0., 8. } } });
+      assert_exact({ { block_kind::limit, { 0., 10. } }, { block_kind::limit, { -5., -0. } } });
+    }
+
+    TEST_METHOD(exact_keeps_limits_that_do_not_overlap)
+    {
+      const std::vector<mathlab::block_description> blocks = { { block_kind::limit, { 0., 1. } }, { block_kind::limit, { 2., 8. } } };
+      const mathlab::execution_plan plan(blocks, optimization_level::exact);
+      Assert::AreEqual(size_t(2), plan.steps().size());
+      assert_exact(blocks);
+    }
+
+    TEST_METHOD(exact_folds_power_of_zero_and_following_blocks_into_constant)
+    {
+      const std::vector<mathlab::block_description> blocks = {
+        { block_kind::addition, { 3. } }, { block_kind::power, { 0. } }, { block_kind::addition, { 2. } }, { block_kind::condition, { 1. } } };
+      const mathlab::execution_plan plan(blocks, optimization_level::exact);
+      Assert::AreEqual(size_t(1), plan.steps().size());
+      Assert::IsTrue(plan.steps()[0].operation == plan_operation::constant);
+      Assert::AreEqual(1., plan.eval(123.));
+      assert_exact(blocks);
+    }
+
+    TEST_METHOD(relaxed_reduces_square_and_reciprocal)
+    {
+      const std::vector<mathlab::block_description> blocks = { { block_kind::power, { 2. } }, { block_kind::power, { -1. } } };
+      const mathlab::execution_plan exact(blocks, optimization_level::exact);
+      Assert::IsTrue(exact.steps()[0].operation == plan_operation::power);
+      Assert::IsTrue(exact.steps()[1].operation == plan_operation::power);
+      assert_exact(blocks);
+      const mathlab::execution_plan plan(blocks, optimization_level::relaxed);
+      Assert::IsTrue(plan.steps()[0].operation == plan_operation::square);
+      Assert::IsTrue(plan.steps()[1].operation == plan_operation::reciprocal);
+      Assert::AreEqual(.25, plan.eval(-2.));
+      const double input[] = { -2., 4. };
+      double output[2];
+      plan.eval_batch(input, output, 2);
+      Assert::AreEqual(.25, output[0]);
+      Assert::AreEqual(.0625, output[1]);
+    }
+
+    TEST_METHOD(exact_keeps_std_pow_for_square_and_reciprocal)
+    {
+      // std::pow is not the correctly rounded square of this value with glibc
+      const auto input = 7.76840624911418231591;
+      // Compilers replace std::pow with constant exponent 2 or -1 by multiplication or division
+      volatile double two = 2.;
+      volatile double minus_one = -1.;
+      const mathlab::execution_plan square({ { block_kind::power, { 2. } } }, optimization_level::exact);
+      const mathlab::execution_plan reciprocal({ { block_kind::power, { -1. } } }, optimization_level::exact);
+      double output = 0.;
+      square.eval_batch(&input, &output, 1);
+      Assert::AreEqual(std::pow(input, two), square.eval(input));
+      Assert::AreEqual(std::pow(input, two), output);
+      reciprocal.eval_batch(&input, &output, 1);
+      Assert::AreEqual(std::pow(input, minus_one), reciprocal.eval(input));
+      Assert::AreEqual(std::pow(input, minus_one), output);
+    }
+
+    TEST_METHOD(relaxed_folds_affine_runs)
+    {
+      const std::vector<mathlab::block_description> blocks = {
+        { block_kind::addition, { 3. } }, { block_kind::multiplication, { 2. } }, { block_kind::addition, { -1. } },
+        { block_kind::identity, {} }, { block_kind::limit, { 0., 10. } }, { block_kind::limit, { 2., 8. } } };
+      const mathlab::execution_plan plan(blocks, optimization_level::relaxed);
+      Assert::AreEqual(size_t(2), plan.steps().size());
+      Assert::IsTrue(plan.steps()[0].operation == plan_operation::multiply_add);
+      Assert::AreEqual(2., plan.steps()[0].constants[0]);
+      Assert::AreEqual(5., plan.steps()[0].constants[1]);
+      Assert::AreEqual(7., plan.eval(1.));
+      Assert::AreEqual(2., plan.eval(-10.));
+    }
+
+    TEST_METHOD(relaxed_reduces_integer_power)
+    {
+      const mathlab::execution_plan plan({ { block_kind::power, { 3. } } }, optimization_level::relaxed);
+      Assert::IsTrue(plan.steps()[0].operation == plan_operation::integer_power);
+      Assert::AreEqual(-8., plan.eval(-2.));
+    }
+
+    TEST_METHOD(exact_folds_steps_after_condition_into_table)
+    {
+      const std::vector<mathlab::block_description> blocks = {
+        { block_kind::addition, { 3. } }, { block_kind::condition, { 4. } }, { block_kind::multiplication, { 2.5 } },
+        { block_kind::addition, { 1. } }, { block_kind::multiplication, { -1. } }, { block_kind::condition, { .5 } }, { block_kind::addition, { .25 } } };
+      const mathlab::execution_plan plan(blocks, optimization_level::exact);
+      Assert::AreEqual(size_t(2), plan.steps().size());
+      const auto& table = plan.steps()[1];
+      Assert::IsTrue(table.operation == plan_operation::select);
+      Assert::AreEqual(1.25, table.constants[1]);
+      Assert::AreEqual(-.75, table.constants[2]);
+      Assert::AreEqual(-.75, table.constants[3]);
+      Assert::AreEqual(-.75, plan.range().lower);
+      Assert::AreEqual(1.25, plan.range().upper);
+      Assert::IsFalse(plan.range().nan);
+      assert_exact(blocks);
+    }
+
+    TEST_METHOD(exact_folds_power_into_table_like_std_pow)
+    {
+      // Batch power runs std::pow, so the folded table has the results of evaluation
+      const std::vector<mathlab::block_description> blocks = { { block_kind::condition, { 0. } }, { block_kind::addition, { 1.5 } }, { block_kind::power, { 3. } } };
+      const mathlab::execution_plan plan(blocks, optimization_level::exact);
+      Assert::AreEqual(size_t(1), plan.steps().size());
+      assert_exact(blocks);
+      const mathlab::execution_plan relaxed(blocks, optimization_level::relaxed);
+      Assert::AreEqual(size_t(1), relaxed.steps().size());
+    }
+
+    TEST_METHOD(exact_drops_limit_that_contains_range)
+    {
+      const std::vector<mathlab::block_description> blocks = {
+        { block_kind::condition, { 2. } }, { block_kind::limit, { -5., 5. } }, { block_kind::multiplication, { 3. } } };
+      const mathlab::execution_plan plan(blocks, optimization_level::exact);
+      Assert::AreEqual(size_t(1), plan.steps().size());
+      assert_exact(blocks);
+      // Input may be NaN, which passes through
+      const mathlab::execution_plan limited({ { block_kind::limit, { 0., 10. } }, { block_kind::addition, { 1. } }, { block_kind::limit, { -1., 12. } } }, optimization_level::exact);
+      Assert::AreEqual(size_t(2), limited.steps().size());
+      Assert::AreEqual(1., limited.range().lower);
+      Assert::AreEqual(11., limited.range().upper);
+      Assert::IsTrue(limited.range().nan);
+    }
+
+    TEST_METHOD(exact_replaces_step_with_constant_output)
+    {
+      // Condition is 1 for every value above -1 and for NaN
+      const std::vector<mathlab::block_description> blocks = {
+        { block_kind::addition, { 2. } }, { block_kind::limit, { 0., 10. } }, { block_kind::condition, { -1. } }, { block_kind::multiplication, { 4. } } };
+      const mathlab::execution_plan plan(blocks, optimization_level::exact);
+      Assert::AreEqual(size_t(1), plan.steps().size());
+      Assert::IsTrue(plan.steps()[0].operation == plan_operation::constant);
+      Assert::AreEqual(4., plan.eval(std::numeric_limits<double>::quiet_NaN()));
+      assert_exact(blocks);
+      // Limit above every value of condition
+      assert_exact({ { block_kind::condition, { 0. } }, { block_kind::limit, { 2., 3. } } });
+      Assert::AreEqual(size_t(1), mathlab::execution_plan({ { block_kind::condition, { 0. } }, { block_kind::limit, { 2., 3. } } }, optimization_level::exact).steps().size());
+    }
+
+    TEST_METHOD(exact_keeps_steps_that_output_zeros_of_both_signs)
+    {
+      const std::vector<mathlab::block_description> blocks = { { block_kind::limit, { -1., 1. } }, { block_kind::condition, { 5. } }, { block_kind::addition, { 1. } }, { block_kind::multiplication, { -0. } } };
+      const mathlab::execution_plan plan(blocks, optimization_level::exact);
+      Assert::IsTrue(plan.steps().back().operation != plan_operation::constant);
+      assert_exact(blocks);
+    }
+
+    TEST_METHOD(output_range_follows_monotonic_steps)
+    {
+      const auto range = mathlab::output_range({ plan_operation::multiply_add, { -2., 1. } }, { -1., 3., false });
+      Assert::AreEqual(-5., range.lower);
+      Assert::AreEqual(3., range.upper);
+      const auto squared = mathlab::output_range({ plan_operation::square, {} }, { -4., 3., true });
+      Assert::AreEqual(0., squared.lower);
+      Assert::AreEqual(16., squared.upper);
+      Assert::IsTrue(squared.nan);
+      Assert::IsTrue(mathlab::output_range({ plan_operation::multiply, { 0. } }, mathlab::value_range::all()).nan);
+      // Powers are bounded a little beyond the powers of the ends
+      const auto cubed = mathlab::output_range({ plan_operation::power, { 3. } }, { -2., 1e-3, false });
+      Assert::IsTrue(cubed.lower <= -8. && cubed.lower > -8.001 && cubed.upper >= 1e-9 && cubed.upper < 1.001e-9 && !cubed.nan);
+      const auto root = mathlab::output_range({ plan_operation::power, { .5 } }, { -1., 4., false });
+      Assert::IsTrue(root.lower == 0. && root.upper >= 2. && root.upper < 2.001 && root.nan);
+      const auto reciprocal = mathlab::output_range({ plan_operation::power, { -1. } }, { 0., 2., false });
+      Assert::IsTrue(reciprocal.lower == -std::numeric_limits<double>::infinity() && reciprocal.upper == std::numeric_limits<double>::infinity());
+    }
+
+    TEST_METHOD(eval_batch_matches_eval)
+    {
+      const mathlab::execution_plan plan({ { block_kind::addition, { 3. } }, { block_kind::condition, { 4. } } }, optimization_level::exact);
+      const double input[] = { 0., 1., 2. };
+      double output[3];
+      plan.eval_batch(input, output, 3);
+      for (size_t i = 0; i < 3; ++i)
+        Assert::AreEqual(plan.eval(input[i]), output[i]);
+    }
+
+    TEST_METHOD(power_batch_matches_eval_below_relaxed)
+    {
+      std::vector<double> input;
+      for (int i = 0; i < 1000; ++i)
+        input.push_back(i * .0123 - 3.);
+      std::vector<double> output(input.size());
+      for (auto level : { optimization_level::none, optimization_level::exact }) {
+        for (auto exponent : { .5, 3., 5., 16. }) {
+          const mathlab::execution_plan plan({ { block_kind::power, { exponent } } }, level);
+          plan.eval_batch(input.data(), output.data(), input.size());
+          for (size_t i = 0; i < input.size(); ++i) {
+            const auto expected = plan.eval(input[i]);
+            Assert::IsTrue(std::memcmp(&expected, &output[i], sizeof(double)) == 0 || (std::isnan(expected) && std::isnan(output[i])));
+          }
+        }
+      }
+    }
+  };
+}
@@ -44,5 +44,103 @@ namespace MathLabTests
       factory.register_block<mathlab::power>("dummy");
       Assert::ExpectException<std::invalid_argument>([&factory, &input]() { factory.create("dummy", input); });
     }
+
+    TEST_METHOD(create_from_text_parses_constants)
+    {
+      auto factory = mathlab::factory();
+      factory.register_block<mathlab::limit>("limit");
+      auto block = factory.create(std::string_view("limit"), std::string_view("  -1.5\t+2e1 ignored\r"));
+      Assert::AreEqual(20., block->eval(100.));
+      Assert::AreEqual(-1.5, block->eval(-100.));
+    }
+
+    TEST_METHOD(create_from_text_returns_nullptr_for_invalid_constants)
+    {
+      auto factory = mathlab::factory();
+      factory.register_block<mathlab::limit>("limit");
+      Assert::IsTrue(factory.create(std::string_view("limit"), std::string_view("1")) == nullptr);
+      Assert::IsTrue(factory.create(std::string_view("limit"), std::string_view("1 2x")) == nullptr);
+      Assert::IsTrue(factory.create(std::string_view("limit"), std::string_view("1 1e400")) == nullptr);
+      Assert::IsTrue(factory.create(std::string_view("limit"), std::string_view("+-1 2")) == nullptr);
+      Assert::IsTrue(factory.create(std::string_view("limits"), std::string_view("1 2")) == nullptr);
+      Assert::IsTrue(factory.create(std::string_view(""), std::string_view("1 2")) == nullptr);
+      Assert::IsTrue(mathlab::factory().create(std::string_view("limit"), std::string_view("1 2")) == nullptr);
+    }
+
+    TEST_METHOD(type_names_are_interned_in_order_of_registration)
+    {
+      auto factory = mathlab::factory();
+      factory.register_block<mathlab::addition>("add");
+      factory.register_block<mathlab::limit>("limit");
+      factory.register_block<mathlab::addition>("add");
+      Assert::AreEqual(0u, factory.find_type("add"));
+      Assert::AreEqual(1u, factory.find_type("limit"));
+      Assert::IsTrue(factory.find_type("limits") == mathlab::factory::no_type);
+      Assert::IsTrue(mathlab::factory().find_type("add") == mathlab::factory::no_type);
+      const auto& name = factory.type_name(1);
+      for (int i = 0; i < 10; ++i)
+        factory.register_block<mathlab::power>("power" + std::to_string(i));
+      Assert::AreEqual(std::string("limit"), name);
+      Assert::AreEqual(std::string("power9"), factory.type_name(factory.find_type("power9")));
+    }
+
+    TEST_METHOD(register_again_with_another_kind_throws)
+    {
+      auto factory = mathlab::factory();
+      factory.register_block<mathlab::addition>("add");
+      const auto block = factory.create_compact("add", "2");
+      Assert::ExpectException<std::invalid_argument>([&]() { factory.register_block<mathlab::multiplication>("add"); });
+      Assert::IsTrue(block->kind == factory.create_compact("add", "2")->kind);
+      Assert::AreEqual(3., factory.create("add", std::string_view("2"))->eval(1.));
+    }
+
+    TEST_METHOD(create_compact_parses_constants_like_create)
+    {
+      auto factory = mathlab::factory();
+      mathlab::register_all_blocks(factory);
+      const auto limit = factory.create_compact(std::string_view("limit"), std::string_view("  -1.5\t+2e1 ignored\r"));
+      Assert::IsTrue(limit.has_value());
+      Assert::IsTrue(limit->kind == mathlab::block_kind::limit);
+      Assert::AreEqual(factory.find_type("limit"), limit->type);
+      Assert::AreEqual(-1.5, limit->constants[0]);
+      Assert::AreEqual(20., limit->constants[1]);
+      const auto power = factory.create_compact(std::string_view("power"), std::string_view("3"));
+      Assert::AreEqual(3., power->describe().constants[0]);
+      Assert::AreEqual(0., power->describe().constants[1]);
+      Assert::IsFalse(factory.create_compact(std::string_view("limit"), std::string_view("1 2x")).has_value());
+      Assert::IsFalse(factory.create_compact(std::string_view("limits"), std::string_view("1 2")).has_value());
+      Assert::IsFalse(mathlab::factory().create_compact(std::string_view("limit"), std::string_view("1 2")).has_value());
+
+      // Constants of values that the type does not use are dropped
+      const double values[] = { 4., 5. };
+      const auto addition = factory.create_compact(factory.find_type("addition"), values);
+      Assert::IsTrue(addition.kind == mathlab::block_kind::addition);
+      Assert::AreEqual(0., addition.constants[1]);
+      Assert::AreEqual(24u, static_cast<unsigned>(sizeof(mathlab::compact_block)));
+    }
+
+    TEST_METHOD(create_from_text_finds_every_registered_name)
+    {
+      auto factory = mathlab::factory();
+      for (int i = 0; i < 100; ++i)
+        factory.register_block<mathlab::addition>("add" + std::to_string(i));
+      for (int i = 0; i < 100; ++i) {
+        const auto name = "add" + std::to_string(i);
+        Assert::AreEqual(1. + i, factory.create(name, std::to_string(i))->eval(1.));
+      }
+      Assert::IsTrue(factory.create(std::string_view("add100"), std::string_view("1")) == nullptr);
+      const auto copy = factory;
+      Assert::AreEqual(3., copy.create(std::string_view("add7"), std::string_view("2"))->eval(1.));
+    }
+
+    TEST_METHOD(index_of_many_names_is_built_in_bounded_time)
+    {
+      // Table grows when seeds run out instead of trying seeds until one fits
+      auto factory = mathlab::factory();
+      for (int i = 0; i < 1000; ++i)
+        factory.register_block<mathlab::identity>("identity" + std::to_string(i));
+      for (int i = 0; i < 1000; ++i)
+        Assert::AreEqual(static_cast<mathlab::factory::type_id>(i), factory.find_type("identity" + std::to_string(i)));
+    }
   };
 }
\ No newline at end of file
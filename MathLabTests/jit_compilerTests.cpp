@@ -0,0 +1,136 @@
+#include "CppUnitTest.h"
+#include "../MathLab/jit_compiler.h"
+#include "../MathLab/block_sequence.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  namespace {
+    using mathlab::block_kind;
+    using mathlab::optimization_level;
+    using mathlab::simd::instruction_set;
+
+    const auto infinity = std::numeric_limits<double>::infinity();
+
+    bool same(double a, double b) {
+      if (std::isnan(a) && std::isnan(b))
+        return true;
+      return std::memcmp(&a, &b, sizeof(double)) == 0;
+    }
+
+    // Native code must return the same bits as the plan, for every count up to two tiles
+    void assert_same_as_plan(const mathlab::execution_plan& plan, instruction_set set) {
+      const auto program = mathlab::jit_program::compile(plan, set);
+      if (program == nullptr)
+        return;
+      std::vector<double> values = { 0., -0., infinity, -infinity, std::numeric_limits<double>::quiet_NaN(), 1e-310, -1e300 };
+      for (int i = -3000; i < 3000; ++i)
+        values.push_back(i * 0.37);
+      std::vector<double> expected(values.size());
+      std::vector<double> actual(values.size());
+      plan.eval_batch(values.data(), expected.data(), values.size());
+      program->eval_batch(values.data(), actual.data(), values.size());
+      for (size_t i = 0; i < values.size(); ++i)
+        Assert::IsTrue(same(expected[i], actual[i]));
+      for (size_t count = 0; count < 9; ++count) {
+        program->eval_batch(values.data(), actual.data(), count);
+        for (size_t i = 0; i < count; ++i)
+          Assert::IsTrue(same(expected[i], actual[i]));
+      }
+    }
+
+    void assert_same_as_plan(const std::vector<mathlab::block_description>& blocks) {
+      for (auto level : { optimization_level::none, optimization_level::exact, optimization_level::relaxed }) {
+        const mathlab::execution_plan plan(blocks, level);
+        assert_same_as_plan(plan, instruction_set::sse2);
+        assert_same_as_plan(plan, instruction_set::avx2);
+      }
+    }
+  }
+
+  TEST_CLASS(jit_compiler_tests)
+  {
+  public:
+    TEST_METHOD(native_code_matches_plan_for_each_block)
+    {
+      assert_same_as_plan({ { block_kind::addition, { 2.5 } } });
+      assert_same_as_plan({ { block_kind::multiplication, { -3. } } });
+      assert_same_as_plan({ { block_kind::condition, { 1.11 } } });
+      assert_same_as_plan({ { block_kind::condition, { 0. } } });
+      assert_same_as_plan({ { block_kind::limit, { -0., 100. } } });
+      assert_same_as_plan({ { block_kind::limit, { 5., -5. } } });
+      assert_same_as_plan({ { block_kind::power, { 2. } } });
+      assert_same_as_plan({ { block_kind::power, { -1. } } });
+      assert_same_as_plan({ { block_kind::power, { 0.5 } } });
+      assert_same_as_plan({ { block_kind::power, { 0. } } });
+      assert_same_as_plan({ { block_kind::identity, {} } });
+    }
+
+    TEST_METHOD(native_code_matches_plan_for_mixed_sequence)
+    {
+      assert_same_as_plan({
+        { block_kind::addition, { 3. } }, { block_kind::multiplication, { 2. } }, { block_kind::power, { 3. } },
+        { block_kind::addition, { -1. } }, { block_kind::limit, { -50., 50. } }, { block_kind::power, { 1.5 } },
+        { block_kind::condition, { 4. } }, { block_kind::power, { -1. } } });
+    }
+
+    TEST_METHOD(native_code_matches_plan_for_table_after_condition)
+    {
+      assert_same_as_plan({
+        { block_kind::addition, { 3. } }, { block_kind::condition, { 4. } }, { block_kind::multiplication, { -2.5 } },
+        { block_kind::power, { -1. } }, { block_kind::addition, { 1. } } });
+      assert_same_as_plan({ { block_kind::condition, { 0. } }, { block_kind::addition, { 1. } }, { block_kind::power, { -1. } } });
+      const mathlab::execution_plan plan({ { block_kind::condition, { 1. } }, { block_kind::multiplication, { 0. } } }, optimization_level::exact);
+      Assert::IsTrue(plan.steps()[0].operation == mathlab::plan_operation::select);
+    }
+
+    TEST_METHOD(power_runs_between_native_loops)
+    {
+      const mathlab::execution_plan plan({ { block_kind::addition, { 1. } }, { block_kind::power, { 1.5 } }, { block_kind::addition, { 1. } } }, optimization_level::exact);
+      const auto program = mathlab::jit_program::compile(plan);
+      if (program == nullptr)
+        return;
+      Assert::AreEqual(size_t(2), program->native_steps());
+      const double input[] = { 3., 8. };
+      double output[2];
+      program->eval_batch(input, output, 2);
+      Assert::AreEqual(9., output[0]);
+      Assert::AreEqual(28., output[1]);
+    }
+
+    TEST_METHOD(scalar_instruction_set_is_not_compiled)
+    {
+      const mathlab::execution_plan plan({ { block_kind::addition, { 1. } } }, optimization_level::exact);
+      Assert::IsTrue(mathlab::jit_program::compile(plan, instruction_set::scalar) == nullptr);
+    }
+
+    TEST_METHOD(sequence_recompiles_after_changes)
+    {
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence sequence(factory);
+      sequence.set_jit(true);
+      std::istringstream blocks("addition 1\nmultiplication 10\n");
+      sequence.load_from(blocks);
+      double value = 2.;
+      sequence.eval_batch(&value, &value, 1);
+      Assert::AreEqual(30., value);
+      sequence.move_to_beginning(1);
+      value = 2.;
+      sequence.eval_batch(&value, &value, 1);
+      Assert::AreEqual(21., value);
+      sequence.remove_at(0);
+      value = 2.;
+      sequence.eval_batch(&value, &value, 1);
+      Assert::AreEqual(3., value);
+      sequence.set_jit(false);
+      Assert::IsTrue(sequence.jit() == nullptr);
+    }
+  };
+}
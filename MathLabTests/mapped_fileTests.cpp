@@ -0,0 +1,44 @@
+#include "CppUnitTest.h"
+#include "../MathLab/mapped_file.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  TEST_CLASS(mapped_file_tests)
+  {
+  public:
+    TEST_METHOD(maps_file_contents)
+    {
+      const auto path = std::filesystem::temp_directory_path() / "mathlab_mapped_file_test.txt";
+      std::ofstream(path, std::ios::binary) << "1 2 3\n";
+      {
+        mathlab::mapped_file file(path);
+        Assert::IsTrue(file.is_open());
+        Assert::AreEqual(std::string("1 2 3\n"), std::string(file.data(), file.size()));
+      }
+      std::filesystem::remove(path);
+    }
+
+    TEST_METHOD(maps_empty_file)
+    {
+      const auto path = std::filesystem::temp_directory_path() / "mathlab_mapped_file_empty.txt";
+      std::ofstream(path, std::ios::binary).close();
+      {
+        mathlab::mapped_file file(path);
+        Assert::IsTrue(file.is_open());
+        Assert::AreEqual(size_t(0), file.size());
+      }
+      std::filesystem::remove(path);
+    }
+
+    TEST_METHOD(missing_file_is_not_open)
+    {
+      mathlab::mapped_file file(std::filesystem::temp_directory_path() / "mathlab_mapped_file_missing.txt");
+      Assert::IsFalse(file.is_open());
+    }
+  };
+}
@@ -0,0 +1,209 @@
+#include "CppUnitTest.h"
+#include "../MathLab/parallel_evaluation.h"
+#include "../MathLab/binary_io.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  namespace {
+    struct test_sequence {
+      mathlab::factory factory;
+      mathlab::block_sequence sequence;
+
+      test_sequence() : sequence(factory) {
+        mathlab::register_all_blocks(factory);
+        std::istringstream blocks("addition 1\nmultiplication 0.5\n");
+        sequence.load_from(blocks);
+      }
+    };
+
+    std::string numbers(int count) {
+      std::ostringstream text;
+      for (int i = 0; i < count; ++i)
+        text << i << (i % 7 ? " " : "\r\n");
+      return text.str();
+    }
+
+    std::string expected_results(int count) {
+      std::ostringstream text;
+      for (int i = 0; i < count; ++i)
+        text << (i + 1) * 0.5 << '\n';
+      return text.str();
+    }
+  }
+
+  TEST_CLASS(parallel_evaluation_tests)
+  {
+  public:
+    TEST_METHOD(memory_results_keep_input_order)
+    {
+      test_sequence test;
+      const auto input = numbers(5000);
+      for (unsigned threads : { 1u, 3u }) {
+        std::ostringstream output;
+        mathlab::evaluate_text(test.sequence, input.data(), input.data() + input.size(), output, threads, 100);
+        Assert::AreEqual(expected_results(5000), output.str());
+      }
+    }
+
+    TEST_METHOD(stream_results_keep_input_order)
+    {
+      test_sequence test;
+      for (unsigned threads : { 1u, 3u }) {
+        std::istringstream input(numbers(5000));
+        std::ostringstream output;
+        mathlab::evaluate_text(test.sequence, input, output, threads, 100);
+        Assert::AreEqual(expected_results(5000), output.str());
+      }
+    }
+
+    TEST_METHOD(stream_chunk_grows_for_long_numbers)
+    {
+      test_sequence test;
+      std::istringstream input("1.0000000000000000000000000000000000000 3");
+      std::ostringstream output;
+      mathlab::evaluate_text(test.sequence, input, output, 2, 4);
+      Assert::AreEqual(std::string("1\n2\n"), output.str());
+    }
+
+    TEST_METHOD(invalid_number_throws_after_previous_results)
+    {
+      test_sequence test;
+      const auto input = numbers(1000) + " x " + numbers(1000);
+      std::ostringstream output;
+      Assert::ExpectException<std::invalid_argument>([&]()
+      {
+        mathlab::evaluate_text(test.sequence, input.data(), input.data() + input.size(), output, 4, 64);
+      });
+      Assert::AreEqual(size_t(0), output.str().find(expected_results(900)));
+    }
+
+    TEST_METHOD(binary_results_keep_input_order)
+    {
+      test_sequence test;
+      std::vector<double> values(5000);
+      for (size_t i = 0; i < values.size(); ++i)
+        values[i] = static_cast<double>(i);
+      std::stringstream binary;
+      mathlab::binary_writer writer(binary);
+      writer.write(values.data(), values.size());
+      writer.finish();
+      // Leading byte makes values in memory unaligned
+      const auto data = " " + binary.str();
+      for (unsigned threads : { 1u, 3u }) {
+        for (bool in_memory : { false, true }) {
+          std::stringstream output;
+          if (in_memory)
+            mathlab::evaluate_binary(test.sequence, data.data() + 1, data.data() + data.size(), output, threads, 100);
+          else
+            mathlab::evaluate_binary(test.sequence, binary, output, threads, 100);
+          binary.clear();
+          binary.seekg(0);
+          std::ostringstream text;
+          mathlab::binary_to_text(output, text);
+          Assert::AreEqual(expected_results(5000), text.str());
+        }
+      }
+    }
+
+    TEST_METHOD(float_evaluation_converts_input_and_writes_floats)
+    {
+      test_sequence test;
+      const std::vector<double> values = { 1., 2., .2 };
+      std::stringstream binary;
+      mathlab::binary_writer writer(binary);
+      writer.write(values.data(), values.size());
+      writer.finish();
+      std::stringstream output;
+      Assert::AreEqual(size_t(3), mathlab::evaluate_binary<float>(test.sequence, binary, output, 1));
+      const auto data = output.str();
+      const auto results = mathlab::parse_binary(data.data(), data.data() + data.size());
+      Assert::IsTrue(results.type == mathlab::precision::f32);
+      float read[3];
+      mathlab::binary_reader reader(output);
+      reader.read(read, 3);
+      Assert::AreEqual(.6f, read[2]);
+
+      const std::string text = "0.2 3\n";
+      std::ostringstream text_output;
+      mathlab::evaluate_text<float>(test.sequence, text.data(), text.data() + text.size(), text_output, 1);
+      Assert::AreEqual(std::string("0.6\n2\n"), text_output.str());
+    }
+
+    TEST_METHOD(sweep_results_keep_range_order)
+    {
+      test_sequence test;
+      const auto range = mathlab::make_sweep_range(0., 4999., 1.);
+      for (unsigned threads : { 1u, 3u }) {
+        std::ostringstream text;
+        Assert::AreEqual(size_t(5000), mathlab::evaluate_text(test.sequence, range, text, threads, 100));
+        Assert::AreEqual(expected_results(5000), text.str());
+
+        std::stringstream binary;
+        Assert::AreEqual(size_t(5000), mathlab::evaluate_binary(test.sequence, range, binary, threads, 100));
+        std::ostringstream binary_text;
+        mathlab::binary_to_text(binary, binary_text);
+        Assert::AreEqual(expected_results(5000), binary_text.str());
+      }
+      std::ostringstream text;
+      mathlab::evaluate_text<float>(test.sequence, mathlab::make_sweep_range(.2, -.2, -.2), text, 2, 2);
+      Assert::AreEqual(std::string("0.6\n0.5\n0.4\n"), text.str());
+    }
+
+    TEST_METHOD(summaries_merge_chunks_of_every_input)
+    {
+      test_sequence test;
+      const auto text = numbers(5000);
+      std::vector<double> values(5000);
+      for (size_t i = 0; i < values.size(); ++i)
+        values[i] = static_cast<double>(i);
+      std::stringstream binary;
+      mathlab::binary_writer writer(binary);
+      writer.write(values.data(), values.size());
+      writer.finish();
+      const auto data = binary.str();
+      for (unsigned threads : { 1u, 3u }) {
+        std::istringstream text_stream(text);
+        std::istringstream binary_stream(data);
+        for (const auto& summary : {
+          mathlab::summarize_text(test.sequence, text.data(), text.data() + text.size(), threads, 100),
+          mathlab::summarize_text(test.sequence, text_stream, threads, 100),
+          mathlab::summarize_binary(test.sequence, data.data(), data.data() + data.size(), threads, 100),
+          mathlab::summarize_binary(test.sequence, binary_stream, threads, 100),
+          mathlab::summarize_range(test.sequence, mathlab::make_sweep_range(0., 4999., 1.), threads, 100) }) {
+          Assert::AreEqual(uint64_t(5000), summary.count());
+          Assert::AreEqual(.5, summary.min());
+          Assert::AreEqual(2500., summary.max());
+          Assert::AreEqual(1250.25, summary.mean(), 1e-9);
+        }
+      }
+    }
+
+    TEST_METHOD(trie_results_have_column_per_sequence)
+    {
+      const mathlab::block_description add_one = { mathlab::block_kind::addition, { 1. } };
+      const mathlab::block_description halve = { mathlab::block_kind::multiplication, { .5 } };
+      const mathlab::sequence_trie trie({ { add_one, halve }, { add_one } }, mathlab::optimization_level::exact);
+      const std::string input = "1 2\n3";
+      for (unsigned threads : { 1u, 3u }) {
+        std::ostringstream output;
+        Assert::AreEqual(size_t(3), mathlab::evaluate_text(trie, input.data(), input.data() + input.size(), output, threads, 2));
+        Assert::AreEqual(std::string("1 2\n1.5 3\n2 4\n"), output.str());
+      }
+
+      std::istringstream text_input(input);
+      std::stringstream binary;
+      mathlab::text_to_binary(text_input, binary);
+      std::stringstream halved;
+      std::stringstream added;
+      Assert::AreEqual(size_t(3), mathlab::evaluate_binary(trie, binary, { &halved, &added }, 1, 2));
+      std::ostringstream text;
+      mathlab::binary_to_text(added, text);
+      Assert::AreEqual(std::string("2\n3\n4\n"), text.str());
+    }
+  };
+}
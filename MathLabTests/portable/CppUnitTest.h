@@ -0,0 +1,127 @@
+#pragma once
+// Subset of Microsoft CppUnitTestFramework used by MathLabTests, for builds outside Visual Studio
+// Test methods register themselves during static initialization and are run by test_main.cpp
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Microsoft {
+  namespace VisualStudio {
+    namespace CppUnitTestFramework {
+
+      // Thrown by failed assertion
+      struct assert_failure {
+        std::string message;
+      };
+
+      struct test_case {
+        std::string name;
+        std::function<void()> run;
+      };
+
+      inline std::vector<test_case>& test_cases() {
+        static std::vector<test_case> cases;
+        return cases;
+      }
+
+      // Base of TEST_CLASS, gives TEST_METHOD the type and the name of its class
+      template<typename TClass, typename TName>
+      struct test_class {
+        using test_class_type = TClass;
+        static const char* test_class_name() { return TName::value; }
+      };
+
+      struct test_registration {
+        test_registration(const char* class_name, const char* method_name, std::function<void()> run) {
+          test_cases().push_back({ std::string(class_name) + "::" + method_name, std::move(run) });
+        }
+      };
+
+      class Assert {
+      public:
+        template<typename T>
+        static void AreEqual(const T& expected, const T& actual, const wchar_t* message = nullptr) {
+          if (!(expected == actual))
+            fail("AreEqual failed. Expected <" + describe(expected) + "> Actual <" + describe(actual) + ">", message);
+        }
+
+        static void AreEqual(double expected, double actual, double tolerance, const wchar_t* message = nullptr) {
+          if (!(actual >= expected - tolerance && actual <= expected + tolerance))
+            fail("AreEqual failed. Expected <" + describe(expected) + "> Actual <" + describe(actual) + "> Tolerance <" + describe(tolerance) + ">", message);
+        }
+
+        static void IsTrue(bool condition, const wchar_t* message = nullptr) {
+          if (!condition)
+            fail("IsTrue failed", message);
+        }
+
+        static void IsFalse(bool condition, const wchar_t* message = nullptr) {
+          if (condition)
+            fail("IsFalse failed", message);
+        }
+
+        [[noreturn]] static void Fail(const wchar_t* message = nullptr) {
+          fail("Fail", message);
+        }
+
+        template<typename TException, typename TFunction>
+        static void ExpectException(TFunction function, const wchar_t* message = nullptr) {
+          try {
+            function();
+          }
+          catch (const TException&) {
+            return;
+          }
+          catch (...) {
+            fail("ExpectException failed. Other exception was thrown", message);
+          }
+          fail("ExpectException failed. No exception was thrown", message);
+        }
+
+      private:
+        template<typename T, typename = void>
+        struct is_printable : std::false_type {};
+        template<typename T>
+        struct is_printable<T, std::void_t<decltype(std::declval<std::ostream&>() << std::declval<const T&>())>> : std::true_type {};
+
+        template<typename T>
+        static std::string describe(const T& value) {
+          if constexpr (is_printable<T>::value) {
+            std::ostringstream text;
+            text << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+            return text.str();
+          }
+          else {
+            return "?";
+          }
+        }
+
+        [[noreturn]] static void fail(const std::string& description, const wchar_t* message) {
+          auto text = description;
+          if (message != nullptr) {
+            text += " - ";
+            for (; *message != 0; ++message)
+              text += static_cast<char>(*message);
+          }
+          throw assert_failure{ text };
+        }
+      };
+    }
+  }
+}
+
+#define TEST_CLASS(class_name) \
+  struct class_name##_test_class_name { static constexpr const char* value = #class_name; }; \
+  class class_name : public ::Microsoft::VisualStudio::CppUnitTestFramework::test_class<class_name, class_name##_test_class_name>
+
+#define TEST_METHOD(method_name) \
+  struct method_name##_registration : ::Microsoft::VisualStudio::CppUnitTestFramework::test_registration { \
+    method_name##_registration() : test_registration(test_class_name(), #method_name, []() { test_class_type test; test.method_name(); }) {} \
+  }; \
+  static inline method_name##_registration method_name##_registered{}; \
+  void method_name()
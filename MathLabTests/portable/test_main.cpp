@@ -0,0 +1,35 @@
+#include "CppUnitTest.h"
+#include <exception>
+#include <iostream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+// Runs all tests or tests whose class::method name contains one of the arguments
+int main(int argc, char* argv[]) {
+  size_t run = 0;
+  size_t failed = 0;
+  for (auto& test : test_cases()) {
+    bool selected = argc == 1;
+    for (int i = 1; i < argc && !selected; ++i)
+      selected = test.name.find(argv[i]) != std::string::npos;
+    if (!selected)
+      continue;
+    ++run;
+    try {
+      test.run();
+      continue;
+    }
+    catch (assert_failure& failure) {
+      std::cout << "FAILED " << test.name << ": " << failure.message << std::endl;
+    }
+    catch (std::exception& exception) {
+      std::cout << "FAILED " << test.name << ": unexpected exception " << exception.what() << std::endl;
+    }
+    catch (...) {
+      std::cout << "FAILED " << test.name << ": unexpected exception" << std::endl;
+    }
+    ++failed;
+  }
+  std::cout << run - failed << " of " << run << " tests passed" << std::endl;
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+#include "CppUnitTest.h"
+#include "../MathLab/prefix_cache.h"
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  TEST_CLASS(prefix_cache_tests)
+  {
+  public:
+    TEST_METHOD(checkpoints_are_before_the_last_block)
+    {
+      Assert::IsTrue(mathlab::prefix_cache::checkpoint_positions(1).empty());
+      Assert::IsTrue(std::vector<size_t>{ 1, 2 } == mathlab::prefix_cache::checkpoint_positions(3));
+      Assert::IsTrue(std::vector<size_t>{ 92, 96, 98, 99 } == mathlab::prefix_cache::checkpoint_positions(100));
+    }
+
+    TEST_METHOD(finds_checkpoint_with_largest_position)
+    {
+      mathlab::prefix_cache cache;
+      const double input[] = { 1., 2. };
+      const double after_one[] = { 2., 3. };
+      const double after_three[] = { 8., 9. };
+      Assert::IsTrue(cache.find(input, 2, 0).batch == nullptr);
+      const auto batch = cache.insert(input, 2);
+      cache.add_checkpoint(batch, 3, after_three, 0);
+      cache.add_checkpoint(batch, 1, after_one, 0);
+      const auto found = cache.find(input, 2, 0);
+      Assert::AreEqual(size_t(3), found.position);
+      Assert::AreEqual(8., (*found.values)[0]);
+      Assert::IsTrue(cache.find(after_one, 2, 0).batch == nullptr);
+      Assert::AreEqual(6 * sizeof(double), cache.used());
+
+      // Output after three blocks is stale after a change of the third block
+      const auto generation = cache.invalidate_from(2);
+      Assert::AreEqual(size_t(1), cache.find(input, 2, generation).position);
+      Assert::AreEqual(4 * sizeof(double), cache.used());
+      // Evaluation of blocks before the change neither resumes from nor adds checkpoints
+      Assert::IsTrue(cache.find(input, 2, 0).values == nullptr);
+      cache.add_checkpoint(batch, 3, after_three, 0);
+      Assert::AreEqual(4 * sizeof(double), cache.used());
+    }
+
+    TEST_METHOD(keeps_batches_within_budget_of_one_input)
+    {
+      mathlab::prefix_cache cache(3 * sizeof(double));
+      const double input[] = { 1., 2. };
+      cache.begin_input("first");
+      const auto batch = cache.insert(input, 2);
+      Assert::IsTrue(batch != nullptr);
+      cache.add_checkpoint(batch, 1, input, 0);
+      Assert::IsTrue(cache.find(input, 2, 0).values == nullptr);
+      Assert::IsTrue(cache.insert(input, 2) == nullptr);
+
+      cache.begin_input("first");
+      Assert::IsTrue(cache.find(input, 2, 0).batch != nullptr);
+      cache.begin_input("second");
+      Assert::IsTrue(cache.find(input, 2, 0).batch == nullptr);
+      Assert::AreEqual(size_t(0), cache.used());
+    }
+  };
+}
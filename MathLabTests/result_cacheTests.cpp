@@ -0,0 +1,108 @@
+#include "CppUnitTest.h"
+#include "../MathLab/result_cache.h"
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  namespace {
+    // Counts evaluated values to tell hits from misses
+    struct counting_square {
+      mutable size_t evaluated = 0;
+      void operator()(const double* input, double* output, size_t count) const {
+        evaluated += count;
+        for (size_t i = 0; i < count; ++i)
+          output[i] = input[i] * input[i];
+      }
+    };
+  }
+
+  TEST_CLASS(result_cache_tests)
+  {
+  public:
+    TEST_METHOD(table_is_keyed_by_bits)
+    {
+      mathlab::result_table table(100, 7.);
+      Assert::AreEqual(size_t(128), table.capacity());
+      Assert::AreEqual(7., *table.find(0.));
+      Assert::IsTrue(table.find(-0.) == nullptr);
+      table.insert(-0., 5.);
+      Assert::AreEqual(5., *table.find(-0.));
+      table.insert(std::nan(""), 1.);
+      Assert::AreEqual(1., *table.find(std::nan("")));
+    }
+
+    TEST_METHOD(repeated_inputs_are_evaluated_once)
+    {
+      mathlab::result_cache cache;
+      counting_square square;
+      std::vector<double> values;
+      for (int i = 0; i < 5000; ++i)
+        values.push_back(i % 10 - 4.5);
+      std::vector<double> results(values.size());
+      cache.eval_batch(values.data(), results.data(), values.size(), square);
+      for (size_t i = 0; i < values.size(); ++i)
+        Assert::AreEqual(values[i] * values[i], results[i]);
+      // Misses of a tile are evaluated together, so only the first tile and the result of zero are evaluated
+      Assert::AreEqual(mathlab::result_cache::tile_size + 1, square.evaluated);
+      Assert::AreEqual(uint64_t(5000), cache.hits() + cache.misses());
+      Assert::AreEqual(uint64_t(5000 - mathlab::result_cache::tile_size), cache.hits());
+    }
+
+    TEST_METHOD(input_and_output_may_share_buffer)
+    {
+      mathlab::result_cache cache;
+      std::vector<double> values = { 3., 2., 3., 0. };
+      cache.eval_batch(values.data(), values.data(), values.size(), counting_square());
+      Assert::AreEqual(9., values[0]);
+      Assert::AreEqual(4., values[1]);
+      Assert::AreEqual(9., values[2]);
+      Assert::AreEqual(0., values[3]);
+    }
+
+    TEST_METHOD(switches_off_at_low_hit_rate)
+    {
+      mathlab::result_cache cache;
+      std::vector<double> values(mathlab::result_cache::check_interval);
+      for (size_t i = 0; i < values.size(); ++i)
+        values[i] = static_cast<double>(i) + .5;
+      cache.eval_batch(values.data(), values.data(), values.size(), counting_square());
+      Assert::IsFalse(cache.active());
+    }
+
+    TEST_METHOD(new_cache_does_not_see_results_of_previous_one)
+    {
+      const double value = 3.;
+      double result = 0.;
+      mathlab::result_cache first;
+      first.eval_batch(&value, &result, 1, counting_square());
+      mathlab::result_cache second;
+      second.eval_batch(&value, &result, 1, [](const double* input, double* output, size_t count) {
+        for (size_t i = 0; i < count; ++i)
+          output[i] = -input[i];
+      });
+      Assert::AreEqual(-3., result);
+      Assert::AreEqual(uint64_t(0), second.hits());
+    }
+
+    TEST_METHOD(threads_have_own_tables)
+    {
+      mathlab::result_cache cache;
+      std::vector<std::thread> threads;
+      std::vector<double> results(4);
+      for (size_t t = 0; t < results.size(); ++t) {
+        threads.emplace_back([&cache, &results, t]() {
+          const double value = static_cast<double>(t);
+          cache.eval_batch(&value, &results[t], 1, counting_square());
+        });
+      }
+      for (auto& thread : threads)
+        thread.join();
+      for (size_t t = 0; t < results.size(); ++t)
+        Assert::AreEqual(static_cast<double>(t * t), results[t]);
+    }
+  };
+}
@@ -0,0 +1,135 @@
+#include "CppUnitTest.h"
+#include "../MathLab/result_summary.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  namespace {
+    mathlab::result_summary summary_of(const std::vector<double>& values) {
+      mathlab::result_summary summary;
+      summary.add(values.data(), values.size());
+      return summary;
+    }
+
+    // Exact quantile by the nearest rank, as estimated by the sketch
+    double exact_quantile(std::vector<double> values, double q) {
+      std::sort(values.begin(), values.end());
+      return values[static_cast<size_t>(q * (values.size() - 1) + .5)];
+    }
+  }
+
+  TEST_CLASS(result_summary_tests)
+  {
+  public:
+    TEST_METHOD(moments_and_range_of_values)
+    {
+      const auto summary = summary_of({ 2., 4., 4., 4., 5., 5., 7., 9. });
+      Assert::AreEqual(uint64_t(8), summary.count());
+      Assert::AreEqual(2., summary.min());
+      Assert::AreEqual(9., summary.max());
+      Assert::AreEqual(5., summary.mean());
+      Assert::AreEqual(4., summary.variance());
+      Assert::AreEqual(2., summary.quantile(0.));
+      Assert::AreEqual(9., summary.quantile(1.));
+    }
+
+    TEST_METHOD(empty_summary_has_no_statistics)
+    {
+      const auto summary = summary_of({ std::nan("") });
+      Assert::AreEqual(uint64_t(1), summary.count());
+      Assert::AreEqual(uint64_t(1), summary.nan_values());
+      Assert::IsTrue(std::isnan(summary.min()));
+      Assert::IsTrue(std::isnan(summary.mean()));
+      Assert::IsTrue(std::isnan(summary.quantile(.5)));
+      Assert::IsTrue(summary.histogram(10).empty());
+    }
+
+    TEST_METHOD(quantiles_are_within_relative_error)
+    {
+      std::vector<double> values;
+      for (int i = 0; i < 100000; ++i)
+        values.push_back(std::pow(-1., i) * std::exp((i % 997) * .03) + (i % 13 == 0 ? 0. : 1e-3 * i));
+      const auto summary = summary_of(values);
+      for (auto q : { .001, .1, .25, .5, .75, .9, .999 }) {
+        const auto expected = exact_quantile(values, q);
+        Assert::AreEqual(expected, summary.quantile(q), std::fabs(expected) * mathlab::result_summary::relative_error);
+      }
+    }
+
+    TEST_METHOD(merged_summaries_equal_summary_of_all_values)
+    {
+      std::vector<double> values;
+      for (int i = 0; i < 10000; ++i)
+        values.push_back(1e6 + std::sin(i) * (i % 5 == 0 ? -1e3 : 1.));
+      values[7] = std::numeric_limits<double>::infinity();
+      values[8] = std::nan("");
+      const auto whole = summary_of(values);
+      mathlab::result_summary merged;
+      for (size_t first = 0; first < values.size(); first += 777) {
+        mathlab::result_summary part;
+        part.add(values.data() + first, std::min<size_t>(777, values.size() - first));
+        merged.merge(part);
+      }
+      Assert::AreEqual(whole.count(), merged.count());
+      Assert::AreEqual(uint64_t(1), merged.nan_values());
+      Assert::AreEqual(whole.min(), merged.min());
+      Assert::AreEqual(std::numeric_limits<double>::infinity(), merged.max());
+      Assert::AreEqual(whole.mean(), merged.mean(), 1e-9);
+      Assert::AreEqual(whole.variance(), merged.variance(), whole.variance() * 1e-9);
+      for (auto q : { .1, .5, .9 })
+        Assert::AreEqual(whole.quantile(q), merged.quantile(q));
+    }
+
+    TEST_METHOD(histogram_bins_finite_values_between_smallest_and_largest)
+    {
+      std::vector<double> values;
+      for (int i = 0; i <= 100; ++i)
+        values.push_back(i);
+      values.push_back(-std::numeric_limits<double>::infinity());
+      const auto bins = summary_of(values).histogram(4);
+      Assert::AreEqual(size_t(4), bins.size());
+      Assert::AreEqual(0., bins[0].lower);
+      Assert::AreEqual(25., bins[1].lower);
+      Assert::AreEqual(100., bins[3].upper);
+      uint64_t total = 0;
+      for (const auto& bin : bins) {
+        total += bin.count;
+        // Values are binned by the middle of their bucket, which may cross the edge of a bin
+        Assert::AreEqual(25., static_cast<double>(bin.count), 2.);
+      }
+      Assert::AreEqual(uint64_t(101), total);
+      const auto single = summary_of({ 3., 3. }).histogram(4);
+      Assert::AreEqual(size_t(1), single.size());
+      Assert::AreEqual(uint64_t(2), single[0].count);
+    }
+
+    TEST_METHOD(dump_json_reports_quantiles_and_histogram)
+    {
+      const auto summary = summary_of({ 1., 2., 3., std::nan("") });
+      mathlab::summary_settings settings;
+      settings.quantiles = { .5 };
+      settings.histogram_bins = 2;
+      std::ostringstream json;
+      summary.dump_json(json, settings);
+      Assert::AreEqual(std::string("{\"values\": 4, \"nan_values\": 1, \"min\": 1, \"max\": 3, \"mean\": 2, \"variance\": 0.6666666666666666, "
+        "\"relative_error\": 0.00390625, \"quantiles\": [{\"q\": 0.5, \"value\": 2.0078125}], "
+        "\"histogram\": [{\"lower\": 1, \"upper\": 2, \"count\": 1}, {\"lower\": 2, \"upper\": 3, \"count\": 2}]}\n"), json.str());
+    }
+
+    TEST_METHOD(parses_quantiles)
+    {
+      const auto quantiles = mathlab::parse_quantiles("0,0.5,1");
+      Assert::AreEqual(size_t(3), quantiles.size());
+      Assert::AreEqual(.5, quantiles[1]);
+      for (auto text : { "", "0.5,", "1.5", "-0.1", "a", "0.5x" })
+        Assert::ExpectException<std::invalid_argument>([&]() { mathlab::parse_quantiles(text); });
+    }
+  };
+}
@@ -0,0 +1,124 @@
+#include "CppUnitTest.h"
+#include "../MathLab/sequence_snapshot.h"
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  namespace {
+    const char* const text = "limit -2 0.1\ncondition 0.5\npower 3\nidentity\naddition 1e-300\nmultiplication -0\naddition 2\n";
+
+    std::string dump_of(const mathlab::block_sequence& sequence) {
+      std::ostringstream dump;
+      sequence.dump(dump, false);
+      return dump.str();
+    }
+
+    std::string snapshot_of(const mathlab::block_sequence& sequence, const mathlab::snapshot_source& source) {
+      std::ostringstream snapshot;
+      mathlab::write_snapshot(snapshot, sequence, source);
+      return snapshot.str();
+    }
+  }
+
+  TEST_CLASS(sequence_snapshot_tests)
+  {
+  public:
+    TEST_METHOD(snapshot_restores_types_and_constants)
+    {
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence original(factory);
+      original.load_from(std::string_view(text));
+      const mathlab::snapshot_source source = { 100, 7 };
+      const auto snapshot = snapshot_of(original, source);
+      // Six type names are stored once with lengths and padding, every block has a fixed size record
+      Assert::AreEqual(mathlab::snapshot_header_size + 6 * 4 + 64 + 7 * mathlab::snapshot_block_size, snapshot.size());
+
+      mathlab::block_sequence loaded(factory);
+      Assert::IsTrue(mathlab::load_snapshot(loaded, factory, snapshot.data(), snapshot.size(), source));
+      Assert::AreEqual(dump_of(original), dump_of(loaded));
+      Assert::AreEqual(original.eval(.25), loaded.eval(.25));
+      Assert::IsTrue(std::signbit(loaded.describe()[5].constants[0]));
+    }
+
+    TEST_METHOD(stale_or_damaged_snapshot_is_rejected)
+    {
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence original(factory);
+      original.load_from(std::string_view(text));
+      const mathlab::snapshot_source source = { 100, 7 };
+      const auto snapshot = snapshot_of(original, source);
+
+      mathlab::block_sequence loaded(factory);
+      loaded.load_from(std::string_view("identity\n"));
+      Assert::IsFalse(mathlab::load_snapshot(loaded, factory, snapshot.data(), snapshot.size(), { 100, 8 }));
+      Assert::IsFalse(mathlab::load_snapshot(loaded, factory, snapshot.data(), snapshot.size() - 1, source));
+      auto other_version = snapshot;
+      other_version[4] = 2;
+      Assert::IsFalse(mathlab::load_snapshot(loaded, factory, other_version.data(), other_version.size(), source));
+
+      mathlab::factory without_limit;
+      without_limit.register_block<mathlab::identity>(mathlab::identity::type_name);
+      Assert::IsFalse(mathlab::load_snapshot(loaded, without_limit, snapshot.data(), snapshot.size(), source));
+      Assert::AreEqual(std::string("identity \n"), dump_of(loaded));
+    }
+
+    TEST_METHOD(snapshot_file_follows_text_file)
+    {
+      const auto path = std::filesystem::temp_directory_path() / "mathlab_snapshot_test.txt";
+      std::ofstream(path, std::ios::binary) << text;
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence sequence(factory);
+      Assert::IsFalse(mathlab::load_snapshot_file(sequence, factory, path));
+      const auto source = mathlab::source_of(path);
+      sequence.load_from(std::string_view(text));
+      Assert::IsTrue(mathlab::save_snapshot_file(sequence, path, *source));
+
+      mathlab::block_sequence loaded(factory);
+      Assert::IsTrue(mathlab::load_snapshot_file(loaded, factory, path));
+      Assert::AreEqual(dump_of(sequence), dump_of(loaded));
+
+      // A change of text makes the snapshot stale
+      std::ofstream(path, std::ios::binary | std::ios::app) << "addition 1\n";
+      Assert::IsFalse(mathlab::load_snapshot_file(loaded, factory, path));
+
+      // Blocks read before a change are stamped with the version they were read from
+      Assert::IsTrue(mathlab::save_snapshot_file(sequence, path, *source));
+      Assert::IsFalse(mathlab::load_snapshot_file(loaded, factory, path));
+      std::filesystem::remove(path);
+      std::filesystem::remove(mathlab::snapshot_path(path));
+    }
+
+    TEST_METHOD(dumped_text_loads_like_its_snapshot)
+    {
+      const auto path = std::filesystem::temp_directory_path() / "mathlab_snapshot_dump_test.txt";
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence sequence(factory);
+      sequence.load_from(std::string_view("addition 0.1234567891\nmultiplication 3.0000000000000004\nlimit -1e-7 123456789.5\n"));
+      std::ofstream(path, std::ios::binary) << dump_of(sequence);
+      Assert::IsTrue(mathlab::save_snapshot_file(sequence, path, *mathlab::source_of(path)));
+      mathlab::block_sequence from_snapshot(factory);
+      Assert::IsTrue(mathlab::load_snapshot_file(from_snapshot, factory, path));
+
+      std::filesystem::remove(mathlab::snapshot_path(path));
+      std::ifstream file(path, std::ios::binary);
+      mathlab::block_sequence from_text(factory);
+      Assert::AreEqual(std::string(), from_text.load_from(file));
+      for (auto input : { 0., .5, 1e8 }) {
+        Assert::AreEqual(sequence.eval(input), from_snapshot.eval(input));
+        Assert::AreEqual(sequence.eval(input), from_text.eval(input));
+      }
+      file.close();
+      std::filesystem::remove(path);
+    }
+  };
+}
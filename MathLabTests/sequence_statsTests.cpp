@@ -0,0 +1,72 @@
+#include "CppUnitTest.h"
+#include "../MathLab/sequence_stats.h"
+#include <cmath>
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  TEST_CLASS(sequence_stats_tests)
+  {
+  public:
+    TEST_METHOD(block_stats_track_range_and_nan)
+    {
+      mathlab::block_stats stats;
+      const double outputs[] = { 2., std::nan(""), -3., 7. };
+      stats.add_outputs(outputs, 4);
+      Assert::AreEqual(uint64_t(4), stats.values);
+      Assert::AreEqual(uint64_t(1), stats.nan_values);
+      Assert::AreEqual(-3., stats.min);
+      Assert::AreEqual(7., stats.max);
+
+      mathlab::block_stats other;
+      other.add_outputs(outputs, 1);
+      other.add_time(10, std::chrono::microseconds(1));
+      stats.merge(other);
+      Assert::AreEqual(uint64_t(5), stats.values);
+      Assert::AreEqual(100., stats.nanoseconds_per_value(), 1e-9);
+    }
+
+    TEST_METHOD(histogram_quantiles_are_bucket_bounds)
+    {
+      mathlab::latency_histogram histogram;
+      for (int i = 0; i < 99; ++i)
+        histogram.add(100.);
+      histogram.add(5000.);
+      Assert::AreEqual(uint64_t(100), histogram.count());
+      Assert::AreEqual(128., histogram.quantile(.5));
+      Assert::AreEqual(128., histogram.quantile(.99));
+      Assert::AreEqual(8192., histogram.quantile(1.));
+      Assert::AreEqual(149., histogram.mean(), 1e-9);
+    }
+
+    TEST_METHOD(samples_one_in_period)
+    {
+      mathlab::sequence_stats stats({ "identity" });
+      uint64_t sampled = 0;
+      for (uint64_t i = 0; i < 4 * mathlab::sequence_stats::sampling_period; ++i)
+        sampled += stats.sample();
+      Assert::AreEqual(uint64_t(4), sampled);
+    }
+
+    TEST_METHOD(json_has_all_blocks_and_null_for_empty_range)
+    {
+      mathlab::sequence_stats stats({ "addition 1", "limit \"a\"" });
+      std::vector<mathlab::block_stats> blocks(2);
+      const double output = 3.;
+      blocks[0].add_outputs(&output, 1);
+      stats.record_batch(blocks, 250.);
+      stats.record_file(100, 10, .5);
+
+      std::ostringstream json;
+      stats.dump_json(json);
+      const auto text = json.str();
+      Assert::IsTrue(text.find("\"name\": \"addition 1\", \"values\": 1") != std::string::npos);
+      Assert::IsTrue(text.find("\"name\": \"limit \\\"a\\\"\"") != std::string::npos);
+      Assert::IsTrue(text.find("\"min\": null") != std::string::npos);
+      Assert::IsTrue(text.find("\"batch_latency\": {\"count\": 1") != std::string::npos);
+      Assert::IsTrue(text.find("\"values_per_second\": 20") != std::string::npos);
+    }
+  };
+}
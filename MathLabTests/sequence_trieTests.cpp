@@ -0,0 +1,69 @@
+#include "CppUnitTest.h"
+#include "../MathLab/sequence_trie.h"
+#include "../MathLab/block_sequence.h"
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  namespace {
+    std::vector<mathlab::block_description> describe(const std::string& text) {
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence sequence(factory);
+      sequence.load_from(std::string_view(text));
+      return sequence.describe();
+    }
+  }
+
+  TEST_CLASS(sequence_trie_tests)
+  {
+  public:
+    TEST_METHOD(common_prefix_is_evaluated_once)
+    {
+      const auto prefix = std::string("addition 1\nmultiplication 3\npower 2\n");
+      const std::vector<std::vector<mathlab::block_description>> sequences = {
+        describe(prefix + "limit -5 50\n"),
+        describe(prefix + "limit -5 50\ncondition 20\n"),
+        describe(prefix + "addition -7\n"),
+        describe(prefix),
+        describe("addition 2\n"),
+        describe("") };
+      const mathlab::sequence_trie trie(sequences, mathlab::optimization_level::exact);
+      Assert::AreEqual(size_t(6), trie.sequence_count());
+      // Root, common prefix, limit, condition, addition -7 and addition 2
+      Assert::AreEqual(size_t(6), trie.node_count());
+      Assert::AreEqual(size_t(7), trie.block_count());
+
+      std::vector<double> values(mathlab::sequence_trie::tile_size + 9);
+      for (size_t i = 0; i < values.size(); ++i)
+        values[i] = static_cast<double>(i % 23) * .5 - 5.;
+      std::vector<std::vector<double>> results(sequences.size(), std::vector<double>(values.size()));
+      std::vector<double*> outputs;
+      for (auto& result : results)
+        outputs.push_back(result.data());
+      trie.eval_batch(values.data(), outputs.data(), values.size());
+      for (size_t s = 0; s < sequences.size(); ++s) {
+        const mathlab::execution_plan plan(sequences[s], mathlab::optimization_level::exact);
+        for (size_t i = 0; i < values.size(); ++i)
+          Assert::AreEqual(plan.eval(values[i]), results[s][i]);
+      }
+    }
+
+    TEST_METHOD(common_prefix_of_all_sequences_is_in_root)
+    {
+      const mathlab::sequence_trie trie({ describe("addition 1\naddition 2\n"), describe("addition 1\naddition 3\n") },
+        mathlab::optimization_level::none, true);
+      Assert::AreEqual(size_t(3), trie.node_count());
+      const double input = 1.;
+      double first;
+      double second;
+      double* outputs[] = { &first, &second };
+      trie.eval_batch(&input, outputs, 1);
+      Assert::AreEqual(4., first);
+      Assert::AreEqual(5., second);
+    }
+  };
+}
@@ -0,0 +1,182 @@
+#include "CppUnitTest.h"
+#include "../MathLab/simd_kernels.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  namespace {
+    using mathlab::simd::instruction_set;
+
+    const auto infinity = std::numeric_limits<double>::infinity();
+    const auto nan = std::numeric_limits<double>::quiet_NaN();
+
+    // Edge values followed by a ramp, 19 values so that every vector width leaves a remainder
+    std::vector<double> test_values() {
+      std::vector<double> values = { 0., -0., 1., -1., infinity, -infinity, nan, 2.5, -2.5, 1e300, -1e-310 };
+      for (int i = 0; i < 8; ++i)
+        values.push_back(i * 1.75 - 5.);
+      return values;
+    }
+
+    // Bitwise equality, any two NaNs are considered equal
+    bool same(double a, double b) {
+      if (std::isnan(a) && std::isnan(b))
+        return true;
+      return std::memcmp(&a, &b, sizeof(double)) == 0;
+    }
+
+    template<typename TKernel, typename ...TArgs>
+    void assert_same_as_scalar(TKernel mathlab::simd::kernel_table::*kernel, TArgs... constants) {
+      const auto input = test_values();
+      std::vector<double> expected(input.size());
+      (mathlab::simd::kernels(instruction_set::scalar).*kernel)(input.data(), expected.data(), input.size(), constants...);
+      for (auto set : { instruction_set::sse2, instruction_set::avx2, instruction_set::avx512 }) {
+        if (!mathlab::simd::is_supported(set))
+          continue;
+        auto output = input;
+        (mathlab::simd::kernels(set).*kernel)(output.data(), output.data(), output.size(), constants...);
+        for (size_t i = 0; i < input.size(); ++i)
+          Assert::IsTrue(same(expected[i], output[i]));
+      }
+    }
+  }
+
+  TEST_CLASS(simd_kernels_tests)
+  {
+  public:
+    TEST_METHOD(scalar_is_always_supported)
+    {
+      Assert::IsTrue(mathlab::simd::is_supported(instruction_set::scalar));
+      Assert::IsTrue(mathlab::simd::is_supported(mathlab::simd::kernels().set));
+    }
+
+    TEST_METHOD(add_matches_scalar)
+    {
+      assert_same_as_scalar(&mathlab::simd::kernel_table::add, 3.5);
+    }
+
+    TEST_METHOD(multiply_matches_scalar)
+    {
+      assert_same_as_scalar(&mathlab::simd::kernel_table::multiply, -2.);
+    }
+
+    TEST_METHOD(multiply_add_matches_scalar)
+    {
+      assert_same_as_scalar(&mathlab::simd::kernel_table::multiply_add, 3., -0.1);
+    }
+
+    TEST_METHOD(condition_matches_scalar)
+    {
+      assert_same_as_scalar(&mathlab::simd::kernel_table::condition, -1.);
+      assert_same_as_scalar(&mathlab::simd::kernel_table::condition, 0.);
+    }
+
+    TEST_METHOD(select_matches_scalar)
+    {
+      assert_same_as_scalar(&mathlab::simd::kernel_table::select, 0., -2.5, 7., nan);
+      assert_same_as_scalar(&mathlab::simd::kernel_table::select, 1., -0., 0., infinity);
+    }
+
+    TEST_METHOD(limit_matches_scalar)
+    {
+      assert_same_as_scalar(&mathlab::simd::kernel_table::limit, -1., 2.);
+      assert_same_as_scalar(&mathlab::simd::kernel_table::limit, 0., 0.);
+      assert_same_as_scalar(&mathlab::simd::kernel_table::limit, 5., -5.);
+    }
+
+    TEST_METHOD(power_matches_scalar_for_exact_exponents)
+    {
+      for (auto exponent : { 0., 1., 2., -1., 1.5, -3. })
+        assert_same_as_scalar(&mathlab::simd::kernel_table::power, exponent);
+    }
+
+    TEST_METHOD(power_matches_std_pow_on_every_table)
+    {
+      const auto input = test_values();
+      std::vector<float> float_input;
+      for (auto value : input)
+        float_input.push_back(static_cast<float>(value));
+      for (auto set : { instruction_set::scalar, instruction_set::sse2, instruction_set::avx2, instruction_set::avx512 }) {
+        if (!mathlab::simd::is_supported(set))
+          continue;
+        for (auto exponent : { .5, 3., 5., 16. }) {
+          std::vector<double> output(input.size());
+          mathlab::simd::kernels(set).power(input.data(), output.data(), input.size(), exponent);
+          for (size_t i = 0; i < input.size(); ++i)
+            Assert::IsTrue(same(std::pow(input[i], exponent), output[i]));
+          std::vector<float> float_output(input.size());
+          const auto float_exponent = static_cast<float>(exponent);
+          mathlab::simd::float_kernels(set).power(float_input.data(), float_output.data(), input.size(), float_exponent);
+          for (size_t i = 0; i < input.size(); ++i)
+            Assert::IsTrue(same(std::pow(float_input[i], float_exponent), float_output[i]));
+        }
+      }
+    }
+
+    TEST_METHOD(integer_power_matches_scalar)
+    {
+      for (auto exponent : { 1u, 3u, 7u, 16u })
+        assert_same_as_scalar(&mathlab::simd::kernel_table::integer_power, exponent);
+    }
+
+    TEST_METHOD(power_square_root_handles_special_values)
+    {
+      const double input[] = { 4., -0., -infinity, infinity, -4. };
+      double output[5];
+      mathlab::simd::kernels().power(input, output, 5, .5);
+      Assert::AreEqual(2., output[0]);
+      Assert::IsFalse(std::signbit(output[1]));
+      Assert::AreEqual(infinity, output[2]);
+      Assert::AreEqual(infinity, output[3]);
+      Assert::IsTrue(std::isnan(output[4]));
+    }
+
+    TEST_METHOD(power_integer_exponent_is_close_to_pow)
+    {
+      const double input[] = { 1.1, -2.3, 0.7, 3. };
+      double output[4];
+      mathlab::simd::kernels().integer_power(input, output, 4, 7u);
+      for (size_t i = 0; i < 4; ++i)
+        Assert::AreEqual(std::pow(input[i], 7.), output[i], std::fabs(std::pow(input[i], 7.)) * 1e-15);
+    }
+
+    TEST_METHOD(float_kernels_match_scalar)
+    {
+      std::vector<float> input;
+      for (auto value : test_values())
+        input.push_back(static_cast<float>(value));
+      const auto& scalar = mathlab::simd::float_kernels(instruction_set::scalar);
+      for (auto set : { instruction_set::sse2, instruction_set::avx2, instruction_set::avx512 }) {
+        if (!mathlab::simd::is_supported(set))
+          continue;
+        const auto& vector = mathlab::simd::float_kernels(set);
+        Assert::IsTrue(vector.set == set);
+        std::vector<float> expected(input.size());
+        std::vector<float> output(input.size());
+        const auto assert_same = [&]() {
+          for (size_t i = 0; i < input.size(); ++i)
+            Assert::IsTrue(same(expected[i], output[i]));
+        };
+        scalar.multiply_add(input.data(), expected.data(), input.size(), 1.5f, -.25f);
+        vector.multiply_add(input.data(), output.data(), input.size(), 1.5f, -.25f);
+        assert_same();
+        for (auto exponent : { 2.f, .5f, 7.f, -1.f }) {
+          scalar.power(input.data(), expected.data(), input.size(), exponent);
+          vector.power(input.data(), output.data(), input.size(), exponent);
+          assert_same();
+        }
+        scalar.select(input.data(), expected.data(), input.size(), 1.f, -1.f, 0.f, 1.f);
+        vector.select(input.data(), output.data(), input.size(), 1.f, -1.f, 0.f, 1.f);
+        assert_same();
+        scalar.limit(input.data(), expected.data(), input.size(), -2.f, 3.f);
+        vector.limit(input.data(), output.data(), input.size(), -2.f, 3.f);
+        assert_same();
+      }
+    }
+  };
+}
@@ -0,0 +1,101 @@
+#include "CppUnitTest.h"
+#include "../MathLab/static_sequence.h"
+#include "../MathLab/block_sequence.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  using test_sequence = mathlab::static_sequence<mathlab::addition, mathlab::multiplication, mathlab::identity, mathlab::limit, mathlab::power>;
+
+  TEST_CLASS(static_sequence_tests)
+  {
+  public:
+    TEST_METHOD(eval_applies_blocks_in_order)
+    {
+      const test_sequence sequence({ 100. }, { 2. }, {}, { 0., 300. }, { .5 });
+      Assert::AreEqual(10., sequence.eval(-50.));
+      Assert::AreEqual(0., sequence.eval(-200.));
+    }
+
+    TEST_METHOD(eval_batch_matches_eval)
+    {
+      const test_sequence sequence({ 1. }, { 3. }, {}, { -5., 5. }, { 2. });
+      const double input[] = { -3., 0., 1., 7. };
+      double output[4];
+      sequence.eval_batch(input, output, 4);
+      for (size_t i = 0; i < 4; ++i)
+        Assert::AreEqual(sequence.eval(input[i]), output[i]);
+    }
+
+    TEST_METHOD(dump_matches_block_sequence)
+    {
+      const test_sequence sequence({ 100. }, { 2. }, {}, { 1., 300.5 }, { 3. });
+      std::ostringstream static_output;
+      sequence.dump(static_output);
+
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence dynamic(factory);
+      std::istringstream input(static_output.str());
+      Assert::IsTrue(dynamic.load_from(input).empty());
+      std::ostringstream dynamic_output;
+      dynamic.dump(dynamic_output, false);
+      Assert::AreEqual(dynamic_output.str(), static_output.str());
+      Assert::AreEqual(dynamic.eval(7.), sequence.eval(7.));
+    }
+
+    TEST_METHOD(load_reads_block_sequence_dump)
+    {
+      std::istringstream input("addition 1 \n\nmultiplication 2 \nidentity \nlimit 0 10 \npower 2 \n");
+      test_sequence sequence;
+      sequence.load_from(input);
+      Assert::AreEqual(2., std::get<0>(sequence.constants<1>()));
+      Assert::AreEqual(64., sequence.eval(3.));
+    }
+
+    TEST_METHOD(load_throws_on_unexpected_block_type)
+    {
+      Assert::ExpectException<std::invalid_argument>([]()
+      {
+        std::istringstream input("multiplication 2\n");
+        test_sequence sequence;
+        sequence.load_from(input);
+      });
+    }
+
+    TEST_METHOD(load_throws_on_missing_constants)
+    {
+      Assert::ExpectException<std::invalid_argument>([]()
+      {
+        std::istringstream input("addition 1\nmultiplication\n");
+        test_sequence sequence;
+        sequence.load_from(input);
+      });
+    }
+
+    TEST_METHOD(load_rejects_malformed_constants_and_extra_blocks)
+    {
+      const test_sequence original({ 1. }, { 2. }, {}, { 0., 10. }, { 2. });
+      // Constants are parsed whole like block_sequence does
+      const std::string_view malformed = "addition 1x\nmultiplication 2\nidentity\nlimit 0 10\npower 2\n";
+      mathlab::factory factory;
+      mathlab::register_all_blocks(factory);
+      mathlab::block_sequence dynamic(factory);
+      Assert::AreEqual(std::string("addition 1x\n"), dynamic.load_from(malformed));
+      auto sequence = original;
+      Assert::ExpectException<std::invalid_argument>([&]() { sequence.load_from(malformed); });
+      Assert::AreEqual(original.eval(3.), sequence.eval(3.));
+
+      std::string message;
+      try {
+        sequence.load_from(std::string_view("addition 1\nmultiplication 2\nidentity\nlimit 0 10\npower 2\naddition 5\n"));
+      }
+      catch (std::invalid_argument& error) {
+        message = error.what();
+      }
+      Assert::AreEqual(std::string("Invalid lines:\naddition 5\n"), message);
+      Assert::AreEqual(original.eval(3.), sequence.eval(3.));
+    }
+  };
+}
@@ -0,0 +1,69 @@
+#include "CppUnitTest.h"
+#include "../MathLab/thread_pool.h"
+#include <atomic>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  TEST_CLASS(thread_pool_tests)
+  {
+  public:
+    TEST_METHOD(submit_returns_result)
+    {
+      mathlab::thread_pool pool(3);
+      auto first = pool.submit([]() { return 1; });
+      auto second = pool.submit([]() { return 2; });
+      Assert::AreEqual(3, first.get() + second.get());
+    }
+
+    TEST_METHOD(destructor_runs_queued_tasks)
+    {
+      std::atomic<int> done(0);
+      {
+        mathlab::thread_pool pool(2);
+        for (int i = 0; i < 100; ++i)
+          pool.submit([&done]() { ++done; });
+      }
+      Assert::AreEqual(100, done.load());
+    }
+
+    TEST_METHOD(run_ordered_consumes_in_order)
+    {
+      for (unsigned threads : { 1u, 4u }) {
+        int next = 0;
+        std::vector<int> consumed;
+        mathlab::run_ordered(threads,
+          [&]() { return next < 1000 ? std::optional<int>(next++) : std::nullopt; },
+          [](int value) { return value * 2; },
+          [&](int value) { consumed.push_back(value); });
+        Assert::AreEqual(size_t(1000), consumed.size());
+        for (int i = 0; i < 1000; ++i)
+          Assert::AreEqual(i * 2, consumed[i]);
+      }
+    }
+
+    TEST_METHOD(run_ordered_rethrows_after_previous_results)
+    {
+      int next = 0;
+      std::vector<int> consumed;
+      try {
+        mathlab::run_ordered(4,
+          [&]() { return next < 100 ? std::optional<int>(next++) : std::nullopt; },
+          [](int value) {
+            if (value == 50)
+              throw std::invalid_argument("fifty");
+            return value;
+          },
+          [&](int value) { consumed.push_back(value); });
+        Assert::Fail();
+      }
+      catch (std::invalid_argument&) {
+      }
+      Assert::AreEqual(size_t(50), consumed.size());
+    }
+  };
+}
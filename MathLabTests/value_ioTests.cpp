@@ -0,0 +1,173 @@
+#include "CppUnitTest.h"
+#include "../MathLab/value_io.h"
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MathLabTests
+{
+  namespace {
+    std::vector<double> read_all(mathlab::text_reader& reader, size_t capacity) {
+      std::vector<double> values;
+      std::vector<double> chunk(capacity);
+      while (auto count = reader.read(chunk.data(), chunk.size()))
+        values.insert(values.end(), chunk.begin(), chunk.begin() + count);
+      return values;
+    }
+  }
+
+  TEST_CLASS(value_io_tests)
+  {
+  public:
+    TEST_METHOD(parse_text_reads_whitespace_separated_numbers)
+    {
+      const std::string text = " 1.5\n-2\t+3e2\r\n4 ";
+      double values[4];
+      const auto result = mathlab::parse_text(text.data(), text.data() + text.size(), true, values, 4);
+      Assert::AreEqual(size_t(4), result.count);
+      Assert::AreEqual(1.5, values[0]);
+      Assert::AreEqual(-2., values[1]);
+      Assert::AreEqual(300., values[2]);
+      Assert::AreEqual(4., values[3]);
+    }
+
+    TEST_METHOD(parse_text_leaves_number_at_end_of_chunk)
+    {
+      const std::string text = "1 23";
+      double values[2];
+      const auto result = mathlab::parse_text(text.data(), text.data() + text.size(), false, values, 2);
+      Assert::AreEqual(size_t(1), result.count);
+      Assert::AreEqual(std::string("23"), std::string(result.next, text.data() + text.size()));
+    }
+
+    TEST_METHOD(parse_text_throws_on_invalid_number)
+    {
+      Assert::ExpectException<std::invalid_argument>([]()
+      {
+        const std::string text = "1 x2 3";
+        double values[3];
+        mathlab::parse_text(text.data(), text.data() + text.size(), true, values, 3);
+      });
+      Assert::ExpectException<std::invalid_argument>([]()
+      {
+        const std::string text = "+-1";
+        double values[1];
+        mathlab::parse_text(text.data(), text.data() + text.size(), true, values, 1);
+      });
+    }
+
+    TEST_METHOD(parse_text_saturates_out_of_range_numbers)
+    {
+      const std::string text = "1e400 -1e400 1e-400";
+      double values[3];
+      mathlab::parse_text(text.data(), text.data() + text.size(), true, values, 3);
+      Assert::AreEqual(std::numeric_limits<double>::infinity(), values[0]);
+      Assert::AreEqual(-std::numeric_limits<double>::infinity(), values[1]);
+      Assert::AreEqual(0., values[2]);
+    }
+
+    TEST_METHOD(sweep_range_includes_stop_within_rounding_error)
+    {
+      const auto range = mathlab::make_sweep_range(0., .3, .1);
+      Assert::AreEqual(size_t(4), range.count);
+      Assert::AreEqual(size_t(1), mathlab::make_sweep_range(2., 2., -1.).count);
+      Assert::AreEqual(size_t(3), mathlab::make_sweep_range(1., -1.5, -1.).count);
+      Assert::AreEqual(size_t(1000001), mathlab::make_sweep_range(-1., 1., 2e-6).count);
+      double values[4];
+      mathlab::fill_range(range, 1, values, 3);
+      Assert::AreEqual(.1, values[0]);
+      Assert::AreEqual(.2, values[1]);
+      Assert::AreEqual(.3, values[2], 1e-15);
+      // Values far from start are computed from their index, not accumulated in float
+      float far[1];
+      mathlab::fill_range(mathlab::make_sweep_range(0., 1e9, 1.), 100000001, far, 1);
+      Assert::AreEqual(1e8f, far[0]);
+
+      for (auto step : { 0., -.1, std::numeric_limits<double>::infinity(), std::nan("") })
+        Assert::ExpectException<std::invalid_argument>([step]() { mathlab::make_sweep_range(0., 1., step); });
+      Assert::ExpectException<std::invalid_argument>([]() { mathlab::make_sweep_range(0., 1e300, 1e-300); });
+    }
+
+    TEST_METHOD(reader_joins_numbers_split_between_chunks)
+    {
+      std::ostringstream text;
+      for (int i = 0; i < 1000; ++i)
+        text << i * 1.25 << (i % 3 ? ' ' : '\n');
+      std::istringstream input(text.str());
+      mathlab::text_reader reader(input, 16);
+      const auto values = read_all(reader, 13);
+      Assert::AreEqual(size_t(1000), values.size());
+      for (int i = 0; i < 1000; ++i)
+        Assert::AreEqual(i * 1.25, values[i]);
+    }
+
+    TEST_METHOD(reader_reads_memory)
+    {
+      const std::string text = "1\n2\n3";
+      mathlab::text_reader reader(text.data(), text.data() + text.size());
+      const auto values = read_all(reader, 2);
+      Assert::AreEqual(size_t(3), values.size());
+      Assert::AreEqual(3., values[2]);
+    }
+
+    TEST_METHOD(reader_throws_on_number_longer_than_buffer)
+    {
+      Assert::ExpectException<std::invalid_argument>([]()
+      {
+        std::istringstream input("1 123456789");
+        mathlab::text_reader reader(input, 4);
+        read_all(reader, 4);
+      });
+    }
+
+    TEST_METHOD(writer_output_round_trips)
+    {
+      const double values[] = { 0.1, 1. / 3., -2.5e-300, 123456789012345678., 3., -0. };
+      std::ostringstream output;
+      {
+        mathlab::text_writer writer(output, 40);
+        writer.write(values, 6);
+      }
+      Assert::AreEqual(std::string("0.1\n0.3333333333333333\n-2.5e-300\n123456789012345680\n3\n-0\n"), output.str());
+      const auto text = output.str();
+      mathlab::text_reader reader(text.data(), text.data() + text.size());
+      const auto parsed = read_all(reader, 6);
+      for (size_t i = 0; i < 6; ++i)
+        Assert::AreEqual(values[i], parsed[i]);
+    }
+
+    TEST_METHOD(float_values_are_parsed_and_written_in_their_precision)
+    {
+      const std::string text = "0.1 16777217 1e39\n";
+      float floats[3];
+      mathlab::parse_text(text.data(), text.data() + text.size(), true, floats, 3);
+      Assert::AreEqual(0.1f, floats[0]);
+      Assert::AreEqual(16777216.f, floats[1]);
+      Assert::AreEqual(std::numeric_limits<float>::infinity(), floats[2]);
+      long double long_double;
+      mathlab::parse_text(text.data(), text.data() + 4, true, &long_double, 1);
+      Assert::IsTrue(long_double == 0.1L);
+      char formatted[mathlab::max_formatted_size];
+      const auto end = mathlab::format_value(floats[0], formatted);
+      Assert::AreEqual(std::string("0.1\n"), std::string(formatted, end));
+    }
+
+    TEST_METHOD(writer_output_of_special_values_is_readable)
+    {
+      const double values[] = { std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN() };
+      std::ostringstream output;
+      mathlab::text_writer writer(output);
+      writer.write(values, 2);
+      writer.flush();
+      const auto text = output.str();
+      mathlab::text_reader reader(text.data(), text.data() + text.size());
+      const auto parsed = read_all(reader, 2);
+      Assert::AreEqual(values[0], parsed[0]);
+      Assert::IsTrue(std::isnan(parsed[1]));
+    }
+  };
+}